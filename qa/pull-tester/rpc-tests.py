@@ -128,6 +128,9 @@ testScripts = [
     'invalidtxrequest.py', # NOTE: needs dash_hash to pass
     'abandonconflict.py',
     'p2p-versionbits-warning.py',
+    'stratum.py',
+    'getwork.py',
+    'generate.py',
 ]
 if ENABLE_ZMQ:
     testScripts.append('zmq_test.py')
@@ -0,0 +1,40 @@
+#!/usr/bin/env python2
+# Copyright (c) 2017 Energi Development Team
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#
+# Test the maxtries and threads arguments of generate
+#
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import *
+
+class GenerateTest(BitcoinTestFramework):
+
+    def setup_chain(self):
+        print("Initializing test directory "+self.options.tmpdir)
+        initialize_chain_clean(self.options.tmpdir, 1)
+
+    def setup_network(self, split=False):
+        self.nodes = start_nodes(1, self.options.tmpdir)
+        self.is_network_split = False
+
+    def run_test(self):
+        node = self.nodes[0]
+
+        assert_equal(len(node.generate(10)), 10)
+        assert_equal(len(node.generate(10, 1000000, 4)), 10)
+        assert_equal(len(node.generate(10, 1000000, 0)), 10)
+        assert_equal(node.getblockcount(), 30)
+
+        # no nonce is tried, so no block can be found
+        assert_equal(node.generate(1, 0), [])
+        assert_equal(node.generate(1, 0, 4), [])
+        assert_equal(node.getblockcount(), 30)
+
+        assert_raises(JSONRPCException, node.generate, 1, -1)
+        assert_raises(JSONRPCException, node.generate, 1, 1000, -1)
+
+if __name__ == '__main__':
+    GenerateTest().main()
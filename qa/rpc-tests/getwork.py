@@ -0,0 +1,66 @@
+#!/usr/bin/env python2
+# Copyright (c) 2017 Energi Development Team
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#
+# Test getwork and submitwork
+#
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import *
+from test_framework import egihash
+
+class GetWorkTest(BitcoinTestFramework):
+
+    def setup_network(self, split=False):
+        self.nodes = start_nodes(1, self.options.tmpdir)
+        self.is_network_split = False
+
+    def run_test(self):
+        node = self.nodes[0]
+
+        work = node.getwork()
+        assert_is_hash_string(work['headerhash'])
+        assert_is_hash_string(work['seedhash'])
+        assert_equal(work['target'], node.getblocktemplate()['target'])
+        assert_equal(work['height'], 201)
+        assert_equal(work['epoch'], 0)
+        assert(work['datasetsize'] > 0)
+
+        print "Work is cached until the tip changes..."
+        assert_equal(node.getwork(), work)
+        node.generate(1)
+        new_work = node.getwork()
+        assert(new_work['headerhash'] != work['headerhash'])
+        assert_equal(new_work['height'], 202)
+
+        print "Work for another address is a new block..."
+        address_work = node.getwork(node.getnewaddress())
+        assert(address_work['headerhash'] != new_work['headerhash'])
+        assert_raises(JSONRPCException, node.getwork, 'notanaddress')
+
+        print "Invalid work is rejected..."
+        nonce = '0x0000000000000000'
+        assert_equal(node.submitwork(nonce, work['headerhash'], '00' * 32), 'unknown-work')
+        assert_equal(node.submitwork(nonce, '11' * 32, '00' * 32), 'unknown-work')
+        assert_equal(node.submitwork(nonce, address_work['headerhash'], '00' * 32), 'bad-mixhash')
+        assert_raises(JSONRPCException, node.submitwork, '0xnotanonce', address_work['headerhash'], '00' * 32)
+        assert_raises(JSONRPCException, node.submitwork, nonce, 'nothex', '00' * 32)
+        assert_equal(node.getblockcount(), 202)
+
+        print "Valid work is accepted..."
+        # headerhash and seedhash are the raw egihash bytes, the target a big endian number
+        work = address_work
+        assert_equal(work['datasetsize'], egihash.get_full_size(work['epoch']))
+        solution = egihash.mine(work['headerhash'], work['seedhash'], work['target'], work['epoch'])
+        assert(solution is not None)
+        nonce, mixhash = solution
+        assert_equal(node.submitwork('0x%016x' % nonce, work['headerhash'], mixhash), None)
+        assert_equal(node.getblockcount(), 203)
+        # the work is still known until getwork sees the new tip, but can no longer become a block
+        assert_equal(node.submitwork('0x%016x' % nonce, work['headerhash'], mixhash), 'stale-prevblk')
+        assert_equal(node.getwork()['height'], 204)
+
+if __name__ == '__main__':
+    GetWorkTest().main()
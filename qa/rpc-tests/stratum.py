@@ -0,0 +1,126 @@
+#!/usr/bin/env python2
+# Copyright (c) 2017 Energi Development Team
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#
+# Test the Stratum server with a minimal local client
+#
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import *
+from test_framework import egihash
+
+import json
+import socket
+
+def stratum_port(n):
+    return 13000 + n + os.getpid()%999
+
+class StratumClient(object):
+    '''Newline delimited JSON-RPC client, collects jobs pushed by the server'''
+
+    def __init__(self, port, timeout=30):
+        self.sock = socket.create_connection(('127.0.0.1', port), timeout)
+        self.buf = b''
+        self.next_id = 1
+        self.jobs = []
+
+    def read_message(self):
+        while b'\n' not in self.buf:
+            data = self.sock.recv(4096)
+            if not data:
+                raise AssertionError('Stratum server closed the connection')
+            self.buf += data
+        line, self.buf = self.buf.split(b'\n', 1)
+        return json.loads(line.decode('utf-8'))
+
+    def request(self, method, params=[]):
+        request_id = self.next_id
+        self.next_id += 1
+        self.sock.sendall(json.dumps({'id': request_id, 'method': method, 'params': params}).encode('utf-8') + b'\n')
+        while True:
+            message = self.read_message()
+            if message['id'] == request_id:
+                return message
+            assert_equal(message['id'], 0)
+            self.jobs.append(message['result'])
+
+    def wait_for_job(self):
+        while not self.jobs:
+            message = self.read_message()
+            assert_equal(message['id'], 0)
+            self.jobs.append(message['result'])
+        return self.jobs.pop(0)
+
+class StratumTest(BitcoinTestFramework):
+
+    def setup_network(self, split=False):
+        self.nodes = start_nodes(1, self.options.tmpdir, [['-stratumport=%d' % stratum_port(0), '-debug=stratum']])
+        self.is_network_split = False
+
+    def get_work(self, client):
+        # the first job is created once the node has left initial block download
+        for i in range(100):
+            reply = client.request('eth_getWork')
+            if reply['error'] is None:
+                return reply['result']
+            time.sleep(0.1)
+        raise AssertionError('No Stratum job was created')
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.generate(1)
+
+        client = StratumClient(stratum_port(0))
+        assert_equal(client.request('eth_submitLogin', ['miner'])['result'], True)
+        job = self.get_work(client)
+        client.jobs = []
+
+        # [header hash, seedhash, target, epoch]
+        assert_equal(len(job), 4)
+        assert_is_hash_string(job[0][2:])
+        assert_is_hash_string(job[1][2:])
+        assert_equal(job[2], '0x' + node.getblocktemplate()['target'])
+        assert_equal(job[3], '0x0')
+
+        print "New blocks push a job immediately..."
+        node.generate(1)
+        pushed = client.wait_for_job()
+        assert(pushed[0] != job[0])
+        assert_equal(client.request('eth_getWork')['result'], pushed)
+        job = pushed
+
+        print "New mempool transactions push a job..."
+        node.sendtoaddress(node.getnewaddress(), 1)
+        pushed = client.wait_for_job()
+        assert(pushed[0] != job[0])
+        job = pushed
+
+        print "Invalid work is rejected..."
+        nonce = '0x0000000000000000'
+        assert_equal(client.request('eth_submitWork', [nonce, job[0], '0x' + '00' * 32])['result'], False)
+        assert_equal(client.request('eth_submitWork', [nonce, '0x' + '11' * 32, '0x' + '00' * 32])['result'], False)
+        assert_equal(client.request('eth_submitWork', ['0xnotanonce', job[0], '0x' + '00' * 32])['error']['code'], -8)
+        assert_equal(client.request('eth_submitWork', [nonce])['error']['code'], -8)
+        assert_equal(node.getblockcount(), 202)
+
+        print "Valid work is accepted..."
+        # the regtest target accepts about half of all nonces
+        solution = egihash.mine(job[0], job[1], job[2], int(job[3], 16))
+        assert(solution is not None)
+        nonce, mixhash = solution
+        assert_equal(client.request('eth_submitWork', ['0x%016x' % nonce, job[0], '0x' + mixhash])['result'], True)
+        assert_equal(node.getblockcount(), 203)
+        assert_equal(node.getrawmempool(), [])
+        pushed = client.wait_for_job()
+        assert(pushed[0] != job[0])
+        # the job of the found block is gone
+        assert_equal(client.request('eth_submitWork', ['0x%016x' % nonce, job[0], '0x' + mixhash])['result'], False)
+
+        print "Other requests..."
+        assert_equal(client.request('eth_submitHashrate', ['0x0', '0x' + '00' * 32])['result'], True)
+        assert_equal(client.request('mining.unknown')['error']['code'], -32601)
+
+if __name__ == '__main__':
+    StratumTest().main()
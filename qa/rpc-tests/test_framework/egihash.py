@@ -0,0 +1,167 @@
+#!/usr/bin/env python2
+# Copyright (c) 2017 Energi Development Team
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#
+# Pure python egihash light client, slow but good enough to mine regtest blocks
+#
+
+import struct
+
+# egihash constants, see src/crypto/egihash.h
+WORD_BYTES = 4
+HASH_BYTES = 64
+MIX_BYTES = 128
+HASH_WORDS = HASH_BYTES // WORD_BYTES
+MIX_WORDS = MIX_BYTES // WORD_BYTES
+DATASET_PARENTS = 256
+CACHE_ROUNDS = 3
+ACCESSES = 64
+FNV_PRIME = 0x01000193
+
+# egihash sizing of regtest, see CRegTestParams
+REGTEST_SIZING = {
+    'epoch_length': 7200,
+    'cache_bytes_init': 1 << 16,
+    'cache_bytes_growth': 1 << 10,
+    'dataset_bytes_init': 1 << 22,
+    'dataset_bytes_growth': 1 << 16,
+}
+
+# Keccak-f[1600] with the original Keccak padding used by egihash, not SHA-3
+KECCAK_ROUND_CONSTANTS = [
+    0x0000000000000001, 0x0000000000008082, 0x800000000000808A, 0x8000000080008000,
+    0x000000000000808B, 0x0000000080000001, 0x8000000080008081, 0x8000000000008009,
+    0x000000000000008A, 0x0000000000000088, 0x0000000080008009, 0x000000008000000A,
+    0x000000008000808B, 0x800000000000008B, 0x8000000000008089, 0x8000000000008003,
+    0x8000000000008002, 0x8000000000000080, 0x000000000000800A, 0x800000008000000A,
+    0x8000000080008081, 0x8000000000008080, 0x0000000080000001, 0x8000000080008008,
+]
+KECCAK_ROTATIONS = [
+    [0, 36, 3, 41, 18],
+    [1, 44, 10, 45, 2],
+    [62, 6, 43, 15, 61],
+    [28, 55, 25, 21, 56],
+    [27, 20, 39, 8, 14],
+]
+MASK64 = (1 << 64) - 1
+
+def rol64(x, n):
+    return ((x << n) | (x >> (64 - n))) & MASK64 if n else x
+
+def keccak_f(a):
+    for rc in KECCAK_ROUND_CONSTANTS:
+        c = [a[x][0] ^ a[x][1] ^ a[x][2] ^ a[x][3] ^ a[x][4] for x in range(5)]
+        d = [c[(x - 1) % 5] ^ rol64(c[(x + 1) % 5], 1) for x in range(5)]
+        a = [[a[x][y] ^ d[x] for y in range(5)] for x in range(5)]
+        b = [[0] * 5 for x in range(5)]
+        for x in range(5):
+            for y in range(5):
+                b[y][(2 * x + 3 * y) % 5] = rol64(a[x][y], KECCAK_ROTATIONS[x][y])
+        a = [[b[x][y] ^ (~b[(x + 1) % 5][y] & b[(x + 2) % 5][y]) for y in range(5)] for x in range(5)]
+        a[0][0] ^= rc
+    return a
+
+def keccak(data, digest_bytes):
+    rate = 200 - 2 * digest_bytes
+    padded = bytearray(data) + b'\x01' + b'\x00' * ((-len(data) - 1) % rate)
+    padded[-1] |= 0x80
+    a = [[0] * 5 for x in range(5)]
+    for offset in range(0, len(padded), rate):
+        lanes = struct.unpack('<%dQ' % (rate // 8), bytes(padded[offset:offset + rate]))
+        for i, lane in enumerate(lanes):
+            a[i % 5][i // 5] ^= lane
+        a = keccak_f(a)
+    out = struct.pack('<25Q', *[a[i % 5][i // 5] for i in range(25)])
+    return out[:digest_bytes]
+
+def keccak256(data):
+    return keccak(data, 32)
+
+def keccak512(data):
+    return keccak(data, 64)
+
+def fnv(v1, v2):
+    return ((v1 * FNV_PRIME) ^ v2) & 0xffffffff
+
+def words(data):
+    return list(struct.unpack('<%dI' % (len(data) // WORD_BYTES), data))
+
+def serialize(ws):
+    return struct.pack('<%dI' % len(ws), *ws)
+
+def is_prime(x):
+    i = 2
+    while i * i <= x:
+        if x % i == 0:
+            return False
+        i += 1
+    return True
+
+def get_cache_size(epoch, sizing=REGTEST_SIZING):
+    size = sizing['cache_bytes_init'] + sizing['cache_bytes_growth'] * epoch - HASH_BYTES
+    while not is_prime(size // HASH_BYTES):
+        size -= 2 * HASH_BYTES
+    return size
+
+def get_full_size(epoch, sizing=REGTEST_SIZING):
+    size = sizing['dataset_bytes_init'] + sizing['dataset_bytes_growth'] * epoch - MIX_BYTES
+    while not is_prime(size // MIX_BYTES):
+        size -= 2 * MIX_BYTES
+    return size
+
+def make_cache(cache_size, seedhash):
+    '''Generate the light cache of an epoch from its seedhash (raw bytes)'''
+    n = cache_size // HASH_BYTES
+    items = [keccak512(seedhash)]
+    for i in range(1, n):
+        items.append(keccak512(items[-1]))
+    cache = [words(item) for item in items]
+    for r in range(CACHE_ROUNDS):
+        for j in range(n):
+            v = cache[cache[j][0] % n]
+            u = [a ^ b for a, b in zip(cache[(j - 1 + n) % n], v)]
+            cache[j] = words(keccak512(serialize(u)))
+    return cache
+
+def calc_dataset_item(cache, i):
+    n = len(cache)
+    mix = list(cache[i % n])
+    mix[0] ^= i
+    mix = words(keccak512(serialize(mix)))
+    for j in range(DATASET_PARENTS):
+        parent = cache[fnv(i ^ j, mix[j % HASH_WORDS]) % n]
+        mix = [fnv(a, b) for a, b in zip(mix, parent)]
+    return words(keccak512(serialize(mix)))
+
+def hashimoto_light(full_size, cache, header_hash, nonce):
+    '''Return (value, mixhash) as raw bytes for a header hash (raw bytes) and a nonce'''
+    s = words(keccak512(header_hash + struct.pack('<Q', nonce)))
+    mix = s * (MIX_WORDS // HASH_WORDS)
+    mixnodes = MIX_BYTES // HASH_BYTES
+    pages = full_size // MIX_BYTES
+    for i in range(ACCESSES):
+        p = fnv(i ^ s[0], mix[i % MIX_WORDS]) % pages
+        page = []
+        for j in range(mixnodes):
+            page += calc_dataset_item(cache, p * mixnodes + j)
+        mix = [fnv(a, b) for a, b in zip(mix, page)]
+    cmix = [fnv(fnv(fnv(mix[i], mix[i + 1]), mix[i + 2]), mix[i + 3]) for i in range(0, MIX_WORDS, 4)]
+    return keccak256(serialize(s + cmix)), serialize(cmix)
+
+def mine(header_hash, seedhash, target, epoch, sizing=REGTEST_SIZING, max_tries=64):
+    '''Find a nonce whose egihash meets target, all hashes as hex strings as handed out by getwork and Stratum.
+    Returns (nonce, mixhash hex) or None'''
+    def unhex(h):
+        return (h[2:] if h.startswith('0x') else h).decode('hex')
+    header = unhex(header_hash)
+    cache = make_cache(get_cache_size(epoch, sizing), unhex(seedhash))
+    full_size = get_full_size(epoch, sizing)
+    # egihash values are big endian, as are the targets
+    target = int(unhex(target).encode('hex'), 16)
+    for nonce in range(max_tries):
+        value, mixhash = hashimoto_light(full_size, cache, header, nonce)
+        if int(value.encode('hex'), 16) <= target:
+            return nonce, mixhash.encode('hex')
+    return None
@@ -181,6 +181,10 @@ def wait_for_bitcoind_start(process, url, i):
                 raise # unkown JSON RPC exception
         time.sleep(0.25)
 
+def dag_dir():
+    '''Egihash light caches are shared by all nodes and tests, so each epoch's cache is only generated once'''
+    return os.path.abspath(os.path.join("cache", "dag"))
+
 def initialize_chain(test_dir):
     """
     Create (or copy from cache) a 200-block-long chain and
@@ -200,7 +204,7 @@ def initialize_chain(test_dir):
         # Create cache directories, run energids:
         for i in range(4):
             datadir=initialize_datadir("cache", i)
-            args = [ os.getenv("EGID", "energid"), "-server", "-keypool=1", "-datadir="+datadir, "-discover=0" ]
+            args = [ os.getenv("EGID", "energid"), "-server", "-keypool=1", "-datadir="+datadir, "-discover=0", "-dagdir="+dag_dir() ]
             if i > 0:
                 args.append("-connect=127.0.0.1:"+str(p2p_port(0)))
             bitcoind_processes[i] = subprocess.Popen(args)
@@ -286,7 +290,7 @@ def start_node(i, dirname, extra_args=None, rpchost=None, timewait=None, binary=
     if binary is None:
         binary = os.getenv("EGID", "energid")
     # RPC tests still depend on free transactions
-    args = [ binary, "-datadir="+datadir, "-server", "-keypool=1", "-discover=0", "-rest", "-blockprioritysize=50000", "-mocktime="+str(get_mocktime()) ]
+    args = [ binary, "-datadir="+datadir, "-server", "-keypool=1", "-discover=0", "-rest", "-blockprioritysize=50000", "-mocktime="+str(get_mocktime()), "-dagdir="+dag_dir() ]
     if extra_args is not None: args.extend(extra_args)
     bitcoind_processes[i] = subprocess.Popen(args)
     if os.getenv("PYTHON_DEBUG", ""):
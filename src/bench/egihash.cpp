@@ -0,0 +1,58 @@
+// Copyright (c) 2017 Energi Development Team
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "crypto/egihash.h"
+
+#include <cstring>
+
+// Random dependent reads of DAG pages, as done by hashimoto, from a buffer the size of
+// the epoch 0 DAG allocated with a page mode. Compare the modes to see the TLB effect.
+static void DAGAccess(benchmark::State& state, egihash::dag_page_mode pages)
+{
+    using namespace egihash;
+
+    dag_t::set_memory_policy(pages);
+    size_t const nSize = dag_t::get_full_size(0);
+    std::shared_ptr<void> const memory = allocate_dag_memory(nSize);
+    dag_t::set_memory_policy(dag_pages_default);
+
+    // fault in every page before measuring
+    uint32_t* const words = static_cast<uint32_t*>(memory.get());
+    size_t const nWords = nSize / sizeof(uint32_t);
+    for (size_t i = 0; i < nWords; i++)
+        words[i] = static_cast<uint32_t>(i * 0x01000193u);
+
+    uint32_t const nPages = nSize / constants::MIX_BYTES;
+    uint32_t const nPageWords = constants::MIX_BYTES / sizeof(uint32_t);
+    uint32_t x = 0x811c9dc5u;
+    while (state.KeepRunning()) {
+        for (uint32_t i = 0; i < constants::ACCESSES; i++) {
+            uint32_t const* const page = words + static_cast<size_t>((x ^ i) % nPages) * nPageWords;
+            for (uint32_t j = 0; j < nPageWords; j++)
+                x = (x * 0x01000193u) ^ page[j];
+        }
+    }
+    volatile uint32_t sink = x;
+    (void)sink;
+}
+
+static void DAGAccessRegularPages(benchmark::State& state)
+{
+    DAGAccess(state, egihash::dag_pages_default);
+}
+
+static void DAGAccessTransparentHugePages(benchmark::State& state)
+{
+    DAGAccess(state, egihash::dag_pages_transparent);
+}
+
+static void DAGAccessReservedHugePages(benchmark::State& state)
+{
+    DAGAccess(state, egihash::dag_pages_huge);
+}
+
+BENCHMARK(DAGAccessRegularPages);
+BENCHMARK(DAGAccessTransparentHugePages);
+BENCHMARK(DAGAccessReservedHugePages);
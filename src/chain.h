@@ -90,6 +90,9 @@ enum BlockStatus {
     BLOCK_FAILED_VALID       =   32, //! stage after last reached validness failed
     BLOCK_FAILED_CHILD       =   64, //! descends from failed block
     BLOCK_FAILED_MASK        =   BLOCK_FAILED_VALID | BLOCK_FAILED_CHILD,
+
+    //! egihash proof-of-work of the header was verified. It is bound to the block hash, which commits to hashMix and nNonce.
+    BLOCK_POW_VERIFIED       =  128,
 };
 
 /** The block chain is a tree shaped structure starting with the
@@ -6,6 +6,7 @@
 
 #include "chainparams.h"
 #include "consensus/merkle.h"
+#include "crypto/egihash.h"
 
 #include "tinyformat.h"
 #include "util.h"
@@ -59,6 +60,34 @@ static CBlock CreateGenesisBlock(uint32_t nTime, uint64_t nNonce, uint32_t nBits
     return CreateGenesisBlock(pszTimestamp, genesisOutputScript, nTime, nNonce, nBits, nVersion, genesisReward);
 }
 
+/** The egihash sizing of a network, see egihash::set_sizing() */
+static egihash::sizing_t EgihashSizing(const Consensus::Params& params)
+{
+    return egihash::sizing_t(params.nEgihashEpochLength, params.nEgihashCacheBytesInit, params.nEgihashCacheBytesGrowth,
+                             params.nEgihashDatasetBytesInit, params.nEgihashDatasetBytesGrowth);
+}
+
+/**
+ * Selects the egihash sizing of a network while its genesis block is checked, and restores the previous sizing
+ * afterwards, so constructing the parameters of all networks leaves the sizing alone until SelectParams()
+ */
+class CEgihashSizingScope
+{
+public:
+    explicit CEgihashSizingScope(const Consensus::Params& params) : previous(egihash::get_sizing())
+    {
+        egihash::set_sizing(EgihashSizing(params));
+    }
+
+    ~CEgihashSizingScope()
+    {
+        egihash::set_sizing(previous);
+    }
+
+private:
+    const egihash::sizing_t previous;
+};
+
 bool GenesisCheckProofOfWork(uint256 hash, unsigned int nBits, const Consensus::Params& params)
 {
     bool fNegative;
@@ -244,6 +273,11 @@ public:
         consensus.nPowTargetSpacing = 60; // Energi: 1 minute
         consensus.fPowAllowMinDifficultyBlocks = false;
         consensus.fPowNoRetargeting = false;
+        consensus.nEgihashEpochLength = egihash::constants::EPOCH_LENGTH;
+        consensus.nEgihashCacheBytesInit = egihash::constants::CACHE_BYTES_INIT;
+        consensus.nEgihashCacheBytesGrowth = egihash::constants::CACHE_BYTES_GROWTH;
+        consensus.nEgihashDatasetBytesInit = egihash::constants::DATASET_BYTES_INIT;
+        consensus.nEgihashDatasetBytesGrowth = egihash::constants::DATASET_BYTES_GROWTH;
         consensus.nRuleChangeActivationThreshold = 1916; // 95% of 2016
         consensus.nMinerConfirmationWindow = 2016; // nPowTargetTimespan / nPowTargetSpacing
         consensus.vDeployments[Consensus::DEPLOYMENT_TESTDUMMY].bit = 28;
@@ -283,6 +317,8 @@ public:
         nDelayGetHeadersTime = 24 * 60 * 60;
         nPruneAfterHeight = 100000;
 
+        // the genesis proof of work is computed with the egihash sizing of this network
+        CEgihashSizingScope sizingScope(consensus);
         genesis = CreateGenesisBlock(1523716938, 34766776, 0x1e0ffff0, 1, consensus.nBlockSubsidyBackbone + consensus.nBlockSubsidyMiners);
         bool const valid_genesis_pow = GenesisCheckProofOfWork(genesis.GetPOWHash(), genesis.nBits, consensus);
         consensus.hashGenesisBlock = genesis.GetHash();
@@ -400,6 +436,11 @@ public:
         consensus.nPowTargetSpacing = 60; // in seconds Energi: 1 minute
         consensus.fPowAllowMinDifficultyBlocks = true;
         consensus.fPowNoRetargeting = false;
+        consensus.nEgihashEpochLength = egihash::constants::EPOCH_LENGTH;
+        consensus.nEgihashCacheBytesInit = egihash::constants::CACHE_BYTES_INIT;
+        consensus.nEgihashCacheBytesGrowth = egihash::constants::CACHE_BYTES_GROWTH;
+        consensus.nEgihashDatasetBytesInit = egihash::constants::DATASET_BYTES_INIT;
+        consensus.nEgihashDatasetBytesGrowth = egihash::constants::DATASET_BYTES_GROWTH;
         consensus.nRuleChangeActivationThreshold = 1512; // 75% for testchains
         consensus.nMinerConfirmationWindow = 2016; // nPowTargetTimespan / nPowTargetSpacing
         consensus.vDeployments[Consensus::DEPLOYMENT_TESTDUMMY].bit = 28;
@@ -421,6 +462,8 @@ public:
         nDelayGetHeadersTime = 24 * 60 * 60;
         nPruneAfterHeight = 1000;
 
+        // the genesis proof of work is computed with the egihash sizing of this network
+        CEgihashSizingScope sizingScope(consensus);
         genesis = CreateGenesisBlock(1524344801, 16880322, 0x207fffff, 1, consensus.nBlockSubsidyBackbone + consensus.nBlockSubsidyMiners);
         bool const valid_genesis_pow = GenesisCheckProofOfWork(genesis.GetPOWHash(), genesis.nBits, consensus);
         consensus.hashGenesisBlock = genesis.GetHash();
@@ -538,6 +581,11 @@ public:
         consensus.nPowTargetSpacing = 60; // in seconds Energi: 1 minute
         consensus.fPowAllowMinDifficultyBlocks = true;
         consensus.fPowNoRetargeting = false;
+        consensus.nEgihashEpochLength = egihash::constants::EPOCH_LENGTH;
+        consensus.nEgihashCacheBytesInit = egihash::constants::CACHE_BYTES_INIT;
+        consensus.nEgihashCacheBytesGrowth = egihash::constants::CACHE_BYTES_GROWTH;
+        consensus.nEgihashDatasetBytesInit = egihash::constants::DATASET_BYTES_INIT;
+        consensus.nEgihashDatasetBytesGrowth = egihash::constants::DATASET_BYTES_GROWTH;
         consensus.nRuleChangeActivationThreshold = 1512; // 75% for testchains
         consensus.nMinerConfirmationWindow = 2016; // nPowTargetTimespan / nPowTargetSpacing
         consensus.vDeployments[Consensus::DEPLOYMENT_TESTDUMMY].bit = 28;
@@ -559,6 +607,8 @@ public:
         nDelayGetHeadersTime = 24 * 60 * 60;
         nPruneAfterHeight = 1000;
 
+        // the genesis proof of work is computed with the egihash sizing of this network
+        CEgihashSizingScope sizingScope(consensus);
         genesis = CreateGenesisBlock(1523717174, 48131894, 0x1e0ffff0, 1, consensus.nBlockSubsidyBackbone + consensus.nBlockSubsidyMiners);
         bool const valid_genesis_pow = GenesisCheckProofOfWork(genesis.GetPOWHash(), genesis.nBits, consensus);
         consensus.hashGenesisBlock = genesis.GetHash();
@@ -672,6 +722,12 @@ public:
         consensus.nPowTargetSpacing = 60; // Energi: 1 minute
         consensus.fPowAllowMinDifficultyBlocks = true;
         consensus.fPowNoRetargeting = true;
+        // a 64 KiB cache and a 4 MiB DAG, so full DAG code paths run in seconds in tests
+        consensus.nEgihashEpochLength = egihash::constants::EPOCH_LENGTH;
+        consensus.nEgihashCacheBytesInit = 1 << 16;
+        consensus.nEgihashCacheBytesGrowth = 1 << 10;
+        consensus.nEgihashDatasetBytesInit = 1 << 22;
+        consensus.nEgihashDatasetBytesGrowth = 1 << 16;
         consensus.nRuleChangeActivationThreshold = 108; // 75% for testchains
         consensus.nMinerConfirmationWindow = 144; // Faster than normal for regtest (144 instead of 2016)
         consensus.vDeployments[Consensus::DEPLOYMENT_TESTDUMMY].bit = 28;
@@ -699,11 +755,13 @@ public:
         nDefaultPort = 39797;
         nPruneAfterHeight = 1000;
 
-        genesis = CreateGenesisBlock(1524279488, 12, 0x207fffff, 1, consensus.nBlockSubsidyBackbone + consensus.nBlockSubsidyMiners);
+        // the genesis proof of work is computed with the egihash sizing of this network
+        CEgihashSizingScope sizingScope(consensus);
+        genesis = CreateGenesisBlock(1524279488, 1, 0x207fffff, 1, consensus.nBlockSubsidyBackbone + consensus.nBlockSubsidyMiners);
         bool const valid_genesis_pow = GenesisCheckProofOfWork(genesis.GetPOWHash(), genesis.nBits, consensus);
         consensus.hashGenesisBlock = genesis.GetHash();
 
-        uint256 expectedGenesisHash = uint256S("0x378abe3d42888769177494063edd42e6c3925e938ff8f73c71a6b6ad5b293ea7");
+        uint256 expectedGenesisHash = uint256S("0x1021bd82f4fee9ad8b3e2f06db1df6a8aa8ee981149e151fcec34f087c2aa829");
         uint256 expectedGenesisMerkleRoot = uint256S("0x34e077f3b96691e4f1aea04061ead361fc4f5b45250513199f46f352b7e4669e");
 
         #ifdef ENERGI_MINE_NEW_GENESIS_BLOCK
@@ -779,4 +837,5 @@ void SelectParams(const std::string& network)
 {
     SelectBaseParams(network);
     pCurrentParams = &Params(network);
+    egihash::set_sizing(EgihashSizing(pCurrentParams->GetConsensus()));
 }
@@ -121,8 +121,9 @@ const CChainParams &Params();
 CChainParams& Params(const std::string& chain);
 
 /**
- * Sets the params returned by Params() to those for the given BIP70 chain name.
+ * Sets the params returned by Params() to those for the given BIP70 chain name, and selects its egihash sizing.
  * @throws std::runtime_error when the chain is not supported.
+ * @throws egihash::hash_exception when the egihash sizing was locked by the node and the chain has another sizing.
  */
 void SelectParams(const std::string& chain);
 
@@ -73,6 +73,12 @@ struct Params {
     int64_t nPowTargetSpacing;
     int64_t nPowTargetTimespan;
     int64_t DifficultyAdjustmentInterval() const { return nPowTargetTimespan / nPowTargetSpacing; }
+    /** Egihash epoch length and cache and DAG sizing, see egihash::sizing_t */
+    uint64_t nEgihashEpochLength;
+    uint64_t nEgihashCacheBytesInit;
+    uint64_t nEgihashCacheBytesGrowth;
+    uint64_t nEgihashDatasetBytesInit;
+    uint64_t nEgihashDatasetBytesGrowth;
     uint256 nMinimumChainWork;
     uint256 defaultAssumeValid;
 
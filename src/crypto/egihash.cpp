@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "egihash.h"
+#include "egihash_fnv.h"
 extern "C"
 {
 #include "keccak-tiny.h"
@@ -11,17 +12,34 @@ extern "C"
 #include <stdint.h>
 #include <algorithm>
 #include <atomic>
+#include <chrono>
+#include <cerrno>
 #include <cmath>
+#include <condition_variable>
+#include <cstdio>
 #include <cstring>
+#include <exception>
 #include <fstream>
 #include <iomanip>
 #include <limits>
 #include <map>
 #include <mutex>
+#include <set>
 #include <string>
 #include <sstream>
+#include <thread>
 #include <iostream> // TODO: remove me (debugging)
 
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
 namespace
 {
 	using namespace egihash;
@@ -82,14 +100,14 @@ namespace
 			read(&dag_end, sizeof(dag_end));
 
 			// validate size of cache
-			cache_t::size_type cache_size = cache_t::get_cache_size((epoch * constants::EPOCH_LENGTH) + 1);
+			cache_t::size_type cache_size = cache_t::get_cache_size((epoch * get_sizing().epoch_length) + 1);
 			if ((cache_end <= cache_begin) || (cache_size != (cache_end - cache_begin)))
 			{
 				throw hash_exception("DAG cache is corrupt");
 			}
 
 			// validate size of DAG
-			uint64_t const size = dag_t::get_full_size((epoch * constants::EPOCH_LENGTH) + 1); // get the correct dag size
+			uint64_t const size = dag_t::get_full_size((epoch * get_sizing().epoch_length) + 1); // get the correct dag size
 			if ((dag_end <= dag_begin) || (size != (dag_end - dag_begin)))
 			{
 				throw hash_exception("DAG is corrupt");
@@ -101,6 +119,94 @@ namespace
 	static_assert(dag_file_header_t::magic_size == 12, "Magic size invalid.");
 	static_assert(sizeof(dag_file_header_t) == 64, "Dag header size invalid.");
 
+	/** \brief cache_file_header_t is the header of a cache file, it is followed by the cache items.
+	*
+	*	The header is zero padded to constants::CACHE_FILE_HEADER_SIZE bytes, so the items of a memory mapped cache are aligned.
+	*/
+	struct cache_file_header_t
+	{
+		static constexpr size_t magic_size = sizeof(constants::CACHE_MAGIC_BYTES);
+		static constexpr size_t fields_size = magic_size + (3 * sizeof(uint32_t)) + (2 * sizeof(uint64_t)) + (2 * h256_t::hash_size);
+		using write_function_type = ::std::function<void(void const * src, ::std::size_t count)>;
+
+		char magic[magic_size];
+		uint32_t major_version;
+		uint32_t revision;
+		uint32_t minor_version;
+		uint64_t epoch;
+		uint64_t size;
+		h256_t seedhash;
+		h256_t checksum;	// Keccak-256 of the cache items
+
+		cache_file_header_t(uint64_t epoch, uint64_t size, h256_t const & seedhash, h256_t const & checksum)
+		: magic{0}
+		, major_version(constants::MAJOR_VERSION)
+		, revision(constants::REVISION)
+		, minor_version(constants::MINOR_VERSION)
+		, epoch(epoch)
+		, size(size)
+		, seedhash(seedhash)
+		, checksum(checksum)
+		{
+			::std::memcpy(magic, constants::CACHE_MAGIC_BYTES, magic_size);
+		}
+
+		explicit cache_file_header_t(read_function_type read)
+		: magic{0}
+		, major_version(0)
+		, revision(0)
+		, minor_version(0)
+		, epoch(0)
+		, size(0)
+		{
+			read(magic, magic_size);
+			if (::std::memcmp(magic, constants::CACHE_MAGIC_BYTES, magic_size) != 0)
+			{
+				throw hash_exception("Not a cache file");
+			}
+
+			read(&major_version, sizeof(major_version));
+			read(&revision, sizeof(revision));
+			read(&minor_version, sizeof(minor_version));
+			if ((major_version != constants::MAJOR_VERSION) || (revision != constants::REVISION))
+			{
+				throw hash_exception("Cache version is invalid");
+			}
+
+			read(&epoch, sizeof(epoch));
+			read(&size, sizeof(size));
+			read(&seedhash.b[0], h256_t::hash_size);
+			read(&checksum.b[0], h256_t::hash_size);
+
+			uint8_t padding[constants::CACHE_FILE_HEADER_SIZE - fields_size];
+			read(padding, sizeof(padding));
+
+			uint64_t const block_number = epoch * get_sizing().epoch_length;
+			if ((size != cache_t::get_cache_size(block_number)) || !(seedhash == cache_t::get_seedhash(block_number)))
+			{
+				throw hash_exception("Cache is corrupt");
+			}
+		}
+
+		void write(write_function_type write) const
+		{
+			write(magic, magic_size);
+			write(&major_version, sizeof(major_version));
+			write(&revision, sizeof(revision));
+			write(&minor_version, sizeof(minor_version));
+			write(&epoch, sizeof(epoch));
+			write(&size, sizeof(size));
+			write(&seedhash.b[0], h256_t::hash_size);
+			write(&checksum.b[0], h256_t::hash_size);
+
+			uint8_t const padding[constants::CACHE_FILE_HEADER_SIZE - fields_size] = {0};
+			write(padding, sizeof(padding));
+		}
+	};
+
+	static_assert(cache_file_header_t::fields_size <= constants::CACHE_FILE_HEADER_SIZE, "Cache header size invalid.");
+	static_assert((constants::CACHE_FILE_HEADER_SIZE % constants::DATA_ALIGNMENT) == 0, "Cache items must be aligned.");
+
 	inline uint32_t decode_int(uint8_t const * data, uint8_t const * dataEnd) noexcept
 	{
 		if (!data || (dataEnd < (data + 3)))
@@ -163,239 +269,984 @@ namespace
 		return ((v1 * FNV_PRIME) ^ v2) % FNV_MODULUS;
 	}
 
-	template <size_t HashSize, int (*HashFunction)(uint8_t *, size_t, uint8_t const * in, size_t)>
-	struct sha3_base
+	/** \brief item_buffer_t owns the single contiguous, aligned block of memory which stores a cache or a DAG.
+	*
+	*	Storing all items in one block avoids per-item allocations and keeps neighbouring items adjacent in memory.
+	*	The block is either allocated by the buffer itself or adopted from elsewhere (e.g. a file mapping) together with a function to release it.
+	*/
+	class item_buffer_t
 	{
-		using deserialized_hash_t = ::std::vector<node>;
+	public:
 		using size_type = ::std::size_t;
+		using release_function_type = ::std::function<void ()>;
 
-		static constexpr size_type hash_size = HashSize;
-		static constexpr size_type data_size = HashSize / sizeof(node);
-		deserialized_hash_t data;
-
-		sha3_base(sha3_base const &) = default;
-		sha3_base(sha3_base &&) = default;
-		sha3_base & operator=(sha3_base const &) = default;
-		sha3_base & operator=(sha3_base &&) = default;
-		~sha3_base() = default;
+		item_buffer_t() noexcept
+		: items(nullptr)
+		, item_count(0)
+		, release_function()
+		{
+		}
 
-		sha3_base()
-		:data(data_size)
+		explicit item_buffer_t(size_type count)
+		: item_buffer_t()
 		{
+			size_type const bytes = (count * constants::HASH_BYTES) + constants::DATA_ALIGNMENT;
+			void * const allocation = ::operator new(bytes);
+			uintptr_t const address = reinterpret_cast<uintptr_t>(allocation);
+			uintptr_t const aligned = (address + constants::DATA_ALIGNMENT - 1) & ~static_cast<uintptr_t>(constants::DATA_ALIGNMENT - 1);
+			items = reinterpret_cast<node *>(aligned);
+			item_count = count;
+			release_function = [allocation]() { ::operator delete(allocation); };
+		}
 
+		/** \brief Allocate count items with allocate_dag_memory(), i.e. following the DAG memory policy.
+		*/
+		static item_buffer_t dag_items(size_type count)
+		{
+			::std::shared_ptr<void> const memory = allocate_dag_memory(count * constants::HASH_BYTES);
+			return item_buffer_t(reinterpret_cast<node *>(memory.get()), count, [memory]() {});
 		}
 
-		sha3_base(::std::string const & input)
-		:sha3_base()
+		item_buffer_t(node * first, size_type count, release_function_type release)
+		: items(first)
+		, item_count(count)
+		, release_function(release)
 		{
-			compute_hash(input.c_str(), input.size());
 		}
 
-		sha3_base(void const * input, size_type const input_size)
-		:sha3_base()
+		item_buffer_t(item_buffer_t const &) = delete;
+		item_buffer_t & operator=(item_buffer_t const &) = delete;
+
+		item_buffer_t(item_buffer_t && rhs) noexcept
+		: item_buffer_t()
 		{
-			compute_hash(input, input_size);
+			swap(rhs);
 		}
 
-		inline void compute_hash(void const * input, size_type const input_size)
+		item_buffer_t & operator=(item_buffer_t && rhs) noexcept
 		{
-			if (HashFunction(reinterpret_cast<uint8_t*>(data.data()), hash_size, reinterpret_cast<uint8_t const *>(input), input_size) != 0)
+			if (this != &rhs)
 			{
-				throw hash_exception("Unable to compute hash"); // TODO: better message?
+				release();
+				swap(rhs);
 			}
+			return *this;
 		}
 
-		inline deserialized_hash_t deserialize() const
+		~item_buffer_t()
 		{
-			return data;
+			release();
 		}
 
-		inline static ::std::string serialize(deserialized_hash_t const & h)
+		node * operator[](size_type index) noexcept
 		{
-			return std::string(reinterpret_cast<const char*>(h.data()), h.size() * sizeof(node));
+			return items + (index * constants::HASH_WORDS);
 		}
 
-		operator ::std::string() const
+		node const * operator[](size_type index) const noexcept
 		{
-			// TODO: fast hex conversion
-			::std::stringstream ss;
-			ss << ::std::hex;
-			uint8_t const * iEnd = reinterpret_cast<uint8_t const *>(&data.back());
-			for (uint8_t const * i = reinterpret_cast<uint8_t const *>(data.data()); i != iEnd; i++)
+			return items + (index * constants::HASH_WORDS);
+		}
+
+		size_type size() const noexcept
+		{
+			return item_count;
+		}
+
+		data_view_t view() const noexcept
+		{
+			return data_view_t(items, item_count);
+		}
+
+	private:
+		void swap(item_buffer_t & rhs) noexcept
+		{
+			::std::swap(items, rhs.items);
+			::std::swap(item_count, rhs.item_count);
+			::std::swap(release_function, rhs.release_function);
+		}
+
+		void release() noexcept
+		{
+			if (release_function)
 			{
-				ss << ::std::setw(2) << ::std::setfill('0') << static_cast<uint16_t>(*i);
+				release_function();
 			}
-			return ss.str();
+			items = nullptr;
+			item_count = 0;
+			release_function = nullptr;
 		}
+
+		node * items;
+		size_type item_count;
+		release_function_type release_function;
 	};
 
-	struct sha3_256_t : public sha3_base<32, ::sha3_256>
+#ifndef WIN32
+	/** \brief mapped_file_t is a read-only memory mapping of an entire file.
+	*
+	*	The mapping is private, so parts of it can be replaced by write() without the changes reaching the file.
+	*/
+	class mapped_file_t
 	{
-		sha3_256_t(::std::string const & input)
-		: sha3_base(input)
+	public:
+		using size_type = ::std::size_t;
+
+		explicit mapped_file_t(::std::string const & file_path)
+		: address(MAP_FAILED)
+		, length(0)
+		, write_mutex()
 		{
+			int const fd = ::open(file_path.c_str(), O_RDONLY);
+			if (fd == -1)
+			{
+				throw hash_exception("Could not open file.");
+			}
+
+			struct stat file_stat;
+			if (::fstat(fd, &file_stat) != 0)
+			{
+				::close(fd);
+				throw hash_exception("Could not stat file.");
+			}
+			length = static_cast<size_type>(file_stat.st_size);
+
+			if (length > 0)
+			{
+				address = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+			}
+			::close(fd); // the mapping remains valid after the descriptor is closed
 
+			if (address == MAP_FAILED)
+			{
+				throw hash_exception("Could not map file.");
+			}
 		}
 
-		sha3_256_t(void const * input, size_type const input_size)
-		: sha3_base(input, input_size)
+		mapped_file_t(mapped_file_t const &) = delete;
+		mapped_file_t & operator=(mapped_file_t const &) = delete;
+
+		~mapped_file_t()
 		{
+			if (address != MAP_FAILED)
+			{
+				::munmap(address, length);
+			}
+		}
 
+		uint8_t const * data() const noexcept
+		{
+			return reinterpret_cast<uint8_t const *>(address);
 		}
-	};
 
-	struct sha3_512_t : public sha3_base<64, ::sha3_512>
-	{
-		sha3_512_t(::std::string const & input)
-		: sha3_base(input)
+		size_type size() const noexcept
 		{
+			return length;
+		}
 
+		/** \brief Give the kernel a hint about how a region of the mapping will be accessed. Hints are best effort only.
+		*/
+		void advise(size_type offset, size_type count, int advice) const noexcept
+		{
+			long const page_size = ::sysconf(_SC_PAGESIZE);
+			size_type const page_offset = (page_size > 0) ? (offset - (offset % static_cast<size_type>(page_size))) : 0;
+			::madvise(reinterpret_cast<char *>(address) + page_offset, count + (offset - page_offset), advice);
 		}
 
-		sha3_512_t(void const * input, size_type const input_size)
-		: sha3_base(input, input_size)
+		/** \brief Replace count bytes of the mapping at offset with src, the file is not changed.
+		*
+		*	The affected pages are only writable while they are copied, other threads may keep reading the rest of the mapping.
+		*/
+		void write(size_type offset, void const * src, size_type count)
 		{
+			long const page_size = ::sysconf(_SC_PAGESIZE);
+			if ((page_size <= 0) || (count > length) || (offset > (length - count)))
+			{
+				throw hash_exception("Could not write to mapped file.");
+			}
+			size_type const page_offset = offset - (offset % static_cast<size_type>(page_size));
+			char * const first_page = reinterpret_cast<char *>(address) + page_offset;
+			size_type const protect_length = count + (offset - page_offset);
 
+			// writes to neighbouring regions may share a page, so they must not lift and restore the protection concurrently
+			::std::lock_guard<::std::mutex> lock(write_mutex);
+			if (::mprotect(first_page, protect_length, PROT_READ | PROT_WRITE) != 0)
+			{
+				throw hash_exception("Could not write to mapped file.");
+			}
+			::std::memcpy(reinterpret_cast<char *>(address) + offset, src, count);
+			::mprotect(first_page, protect_length, PROT_READ);
 		}
+
+	private:
+		void * address;
+		size_type length;
+		::std::mutex write_mutex;
 	};
+#endif // WIN32
 
-	// TODO: unit tests / validation
-	template <typename HashType>
-	typename HashType::deserialized_hash_t hash_words(::std::string const & data)
+	/** \brief dag_memory_policy_t holds the settings of dag_t::set_memory_policy().
+	*/
+	struct dag_memory_policy_t
 	{
-		return HashType(data).data;
-	}
+		dag_page_mode pages = dag_pages_default;
+		dag_numa_mode numa = dag_numa_default;
+		unsigned int numa_node = 0;
+	};
 
-	template <typename HashType, typename DataType>
-	typename HashType::deserialized_hash_t hash_words(DataType * data_ptr, typename HashType::size_type data_size)
+	::std::mutex & get_dag_memory_policy_mutex()
 	{
-		return HashType(data_ptr, data_size).data;
+		static ::std::mutex mutex;
+		return mutex;
 	}
 
-	// TODO: unit tests / validation
-	template <typename HashType>
-	typename HashType::deserialized_hash_t hash_words(typename HashType::deserialized_hash_t const & deserialized)
+	dag_memory_policy_t & get_dag_memory_policy()
 	{
-		auto const serialized = HashType::serialize(deserialized);
-		return hash_words<HashType>(serialized);
+		static dag_memory_policy_t policy;
+		return policy;
 	}
 
-	template <typename HashFunc, typename DatasetType>
-	result_t hash_header_nonce(HashFunc hashfunc, DatasetType const & dataset, h256_t const & header_hash, uint64_t const nonce)
-	{
-		uint8_t const * nonce_bytes = reinterpret_cast<uint8_t const *>(&nonce);
+#ifdef __linux__
+	// anonymous mappings are page aligned, reserved huge pages need whole pages of this size
+	constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
 
-		// combine header_hash with nonce
-		uint8_t const bytes[sizeof(header_hash.b) + sizeof(nonce)] =
-		{
-			header_hash.b[ 0], header_hash.b[ 1], header_hash.b[ 2], header_hash.b[ 3],
-			header_hash.b[ 4], header_hash.b[ 5], header_hash.b[ 6], header_hash.b[ 7],
-			header_hash.b[ 8], header_hash.b[ 9], header_hash.b[10], header_hash.b[11],
-			header_hash.b[12], header_hash.b[13], header_hash.b[14], header_hash.b[15],
-			header_hash.b[16], header_hash.b[17], header_hash.b[18], header_hash.b[19],
-			header_hash.b[20], header_hash.b[21], header_hash.b[22], header_hash.b[23],
-			header_hash.b[24], header_hash.b[25], header_hash.b[26], header_hash.b[27],
-			header_hash.b[28], header_hash.b[29], header_hash.b[30], header_hash.b[31],
+	// values of MPOL_BIND and MPOL_INTERLEAVE in <linux/mempolicy.h>, which is not always installed
+	constexpr int MEMORY_POLICY_BIND = 2;
+	constexpr int MEMORY_POLICY_INTERLEAVE = 3;
+	constexpr size_t MAX_NUMA_NODES = 1024;
+	using numa_node_mask_t = unsigned long[MAX_NUMA_NODES / (8 * sizeof(unsigned long))];
 
-			nonce_bytes[0], nonce_bytes[1], nonce_bytes[2], nonce_bytes[3],
-			nonce_bytes[4], nonce_bytes[5], nonce_bytes[6], nonce_bytes[7],
-		};
+	// parse the online NUMA nodes, e.g. "0-1,3", into mask
+	bool get_online_numa_nodes(numa_node_mask_t & mask)
+	{
+		::std::ifstream fs("/sys/devices/system/node/online");
+		::std::string line;
+		if (!::std::getline(fs, line))
+		{
+			return false;
+		}
 
-		return hashfunc(dataset, bytes, sizeof(bytes));
+		bool any = false;
+		::std::istringstream ranges(line);
+		::std::string range;
+		while (::std::getline(ranges, range, ','))
+		{
+			unsigned long first = 0, last = 0;
+			char dash = 0;
+			::std::istringstream r(range);
+			if (!(r >> first))
+			{
+				return false;
+			}
+			last = (r >> dash >> last) ? last : first;
+			for (unsigned long node = first; node <= last && node < MAX_NUMA_NODES; node++)
+			{
+				mask[node / (8 * sizeof(unsigned long))] |= 1ul << (node % (8 * sizeof(unsigned long)));
+				any = true;
+			}
+		}
+		return any;
 	}
-}
-
-namespace egihash
-{
-	constexpr h256_t::size_type h256_t::hash_size;
 
-	h256_t::h256_t(void const * input_data, size_type input_size)
-	: b{0}
+	// place the pages of a mapping which has not been touched yet according to policy, best effort
+	void apply_numa_policy(void * address, size_t length, dag_memory_policy_t const & policy) noexcept
 	{
-		if (::sha3_256(b, hash_size, reinterpret_cast<uint8_t const *>(input_data), input_size) != 0)
+		numa_node_mask_t mask = { 0 };
+		int mode = 0;
+		if (policy.numa == dag_numa_interleave)
 		{
-			throw hash_exception("Keccak-256 computation failed.");
+			if (!get_online_numa_nodes(mask))
+			{
+				return;
+			}
+			mode = MEMORY_POLICY_INTERLEAVE;
+		}
+		else if (policy.numa == dag_numa_bind && policy.numa_node < MAX_NUMA_NODES)
+		{
+			mask[policy.numa_node / (8 * sizeof(unsigned long))] = 1ul << (policy.numa_node % (8 * sizeof(unsigned long)));
+			mode = MEMORY_POLICY_BIND;
+		}
+		else
+		{
+			return;
 		}
+		::syscall(SYS_mbind, address, length, mode, mask, MAX_NUMA_NODES + 1, 0);
 	}
+#endif // __linux__
 
-	::std::string h256_t::to_hex() const
+	// number of threads to use when 0 (automatic) is requested
+	inline unsigned int resolve_thread_count(unsigned int thread_count) noexcept
 	{
-		// TODO: fast hex conversion
-		::std::stringstream ss;
-		ss << ::std::hex << ::std::nouppercase;
-		uint8_t const * iEnd = reinterpret_cast<uint8_t const *>(&b[hash_size]);
-		for (uint8_t const * i = reinterpret_cast<uint8_t const *>(&b[0]); i != iEnd; i++)
+		if (thread_count == 0)
 		{
-			ss << ::std::setw(2) << ::std::setfill('0') << static_cast<uint16_t>(*i);
+			thread_count = ::std::thread::hardware_concurrency();
 		}
-		return ss.str();
+		return (::std::max)(thread_count, 1u);
 	}
 
-	h256_t::operator bool() const
+	/** \brief Run task(begin, end) over the index range [0, count) in chunks of chunk_size items on thread_count threads.
+	*
+	*	The calling thread takes part in the work and is the only thread which calls progress(items_done),
+	*	so progress callbacks never need to be thread safe. Returning false from progress cancels the remaining work.
+	*	\return true if all work was completed, false if it was cancelled.
+	*	\throws the first exception thrown by any task.
+	*/
+	template <typename TaskType, typename ProgressType>
+	bool parallel_for(::std::size_t const count, ::std::size_t const chunk_size, unsigned int const thread_count, TaskType task, ProgressType progress)
 	{
-		return (::std::memcmp(&b[0], &empty_h256.b[0], sizeof(b)) != 0);
-	}
+		using namespace std;
 
-	bool h256_t::operator==(h256_t const & rhs) const
-	{
-		return (::std::memcmp(&b[0], &rhs.b[0], sizeof(b)) == 0);
-	}
+		atomic<size_t> next_chunk(0);
+		atomic<size_t> items_done(0);
+		atomic<bool> stop(false);
+		mutex error_mutex;
+		exception_ptr error;
 
-	constexpr h512_t::size_type h512_t::hash_size;
+		size_t const chunk_count = (count + chunk_size - 1) / chunk_size;
+		auto run_chunk = [&]() -> bool
+		{
+			size_t const chunk = next_chunk++;
+			if (stop || (chunk >= chunk_count))
+			{
+				return false;
+			}
 
-	h512_t::h512_t(void const * input_data, size_type input_size)
-	: b{0}
-	{
-		if (::sha3_512(b, hash_size, reinterpret_cast<uint8_t const *>(input_data), input_size) != 0)
+			size_t const begin = chunk * chunk_size;
+			size_t const end = (min)(begin + chunk_size, count);
+			try
+			{
+				task(begin, end);
+			}
+			catch (...)
+			{
+				lock_guard<mutex> lock(error_mutex);
+				if (!error)
+				{
+					error = current_exception();
+				}
+				stop = true;
+				return false;
+			}
+			items_done += (end - begin);
+			return true;
+		};
+
+		vector<thread> workers;
+		unsigned int const worker_count = (min)(static_cast<size_t>(thread_count), chunk_count);
+		for (unsigned int i = 1; i < worker_count; i++)
 		{
-			throw hash_exception("Keccak-512 computation failed.");
+			workers.emplace_back([&]() { while (run_chunk()) {} });
 		}
-	}
 
-	::std::string h512_t::to_hex() const
-	{
-		// TODO: fast hex conversion
-		::std::stringstream ss;
-		ss << ::std::hex << ::std::nouppercase;
-		uint8_t const * iEnd = reinterpret_cast<uint8_t const *>(&b[hash_size]);
-		for (uint8_t const * i = reinterpret_cast<uint8_t const *>(&b[0]); i != iEnd; i++)
+		bool cancelled = false;
+		while (run_chunk())
 		{
-			ss << ::std::setw(2) << ::std::setfill('0') << static_cast<uint16_t>(*i);
+			if (!progress(items_done.load()))
+			{
+				cancelled = true;
+				stop = true;
+			}
 		}
-		return ss.str();
-	}
 
-	h512_t::operator bool() const
-	{
-		return (::std::memcmp(&b[0], &empty_h512.b[0], sizeof(b)) != 0);
-	}
+		for (auto & worker : workers)
+		{
+			worker.join();
+		}
 
-	bool h512_t::operator==(h512_t const & rhs) const
-	{
-		return (::std::memcmp(&b[0], &rhs.b[0], sizeof(b)) == 0);
-	}
+		if (error)
+		{
+			rethrow_exception(error);
+		}
 
-	result_t::operator bool() const
-	{
-		return bool(value) && bool(mixhash);
+		return !cancelled;
 	}
 
-	bool result_t::operator==(result_t const & rhs) const
+	// compute a Keccak-512 hash directly into a cache or DAG item
+	inline void sha3_512_item(node * out, void const * input, size_t const input_size)
 	{
-		return ((value == rhs.value) && (mixhash == rhs.mixhash));
+		if (::sha3_512(reinterpret_cast<uint8_t *>(out), constants::HASH_BYTES, reinterpret_cast<uint8_t const *>(input), input_size) != 0)
+		{
+			throw hash_exception("Keccak-512 computation failed.");
+		}
 	}
 
-	// TODO: unit tests / validation
-	template <typename T>
-	sha3_512_t::deserialized_hash_t sha3_512(T const & data)
+	// compute four Keccak-512 hashes of equally sized inputs, in parallel where the CPU supports it
+	inline void sha3_512_items_x4(node * const (&out)[4], node const * const (&input)[4], size_t const input_size)
 	{
-		return hash_words<sha3_512_t>(data);
+		uint8_t * const out_bytes[4] = {
+			reinterpret_cast<uint8_t *>(out[0]), reinterpret_cast<uint8_t *>(out[1]),
+			reinterpret_cast<uint8_t *>(out[2]), reinterpret_cast<uint8_t *>(out[3])
+		};
+		uint8_t const * const input_bytes[4] = {
+			reinterpret_cast<uint8_t const *>(input[0]), reinterpret_cast<uint8_t const *>(input[1]),
+			reinterpret_cast<uint8_t const *>(input[2]), reinterpret_cast<uint8_t const *>(input[3])
+		};
+		if (::sha3_512_x4(out_bytes, constants::HASH_BYTES, input_bytes, input_size) != 0)
+		{
+			throw hash_exception("Keccak-512 computation failed.");
+		}
 	}
 
-	template <typename DataPtr>
-	sha3_512_t::deserialized_hash_t sha3_512(DataPtr const * data, sha3_512_t::size_type data_size)
+	/** \brief dag_checksums_t is the table of checksums which ends DAG files of minor version 1 and later.
+	*
+	*	The table holds the Keccak-256 hashes of the cache and of every constants::DAG_CHUNK_BYTES bytes of the DAG,
+	*	so corruption is found per chunk and only the affected chunks have to be regenerated.
+	*/
+	struct dag_checksums_t
 	{
-		return hash_words<sha3_512_t>(data, data_size);
+		using write_function_type = ::std::function<void(void const * src, ::std::size_t count)>;
+		static constexpr uint64_t chunk_items = constants::DAG_CHUNK_BYTES / constants::HASH_BYTES;
+		static_assert((constants::DAG_CHUNK_BYTES % constants::MIX_BYTES) == 0, "DAG chunks must consist of whole pages");
+
+		h256_t cache;
+		::std::vector<h256_t> chunks;
+
+		static size_t chunk_count(uint64_t const dag_size) noexcept
+		{
+			return static_cast<size_t>((dag_size + constants::DAG_CHUNK_BYTES - 1) / constants::DAG_CHUNK_BYTES);
+		}
+
+		static uint64_t table_size(uint64_t const dag_size) noexcept
+		{
+			return (2 * sizeof(uint64_t)) + ((1 + chunk_count(dag_size)) * h256_t::hash_size);
+		}
+
+		static h256_t checksum(data_view_t const & data)
+		{
+			return h256_t(data.data(), data.size_bytes());
+		}
+
+		static h256_t checksum_chunk(data_view_t const & dag, size_t const chunk)
+		{
+			size_t const begin = chunk * chunk_items;
+			size_t const end = (::std::min)(begin + chunk_items, static_cast<size_t>(dag.size()));
+			return checksum(data_view_t(dag[begin], end - begin));
+		}
+
+		/** \brief Compute the checksums of a cache and its DAG on thread_count threads.
+		*/
+		static dag_checksums_t compute(data_view_t const & cache, data_view_t const & dag, unsigned int const thread_count)
+		{
+			dag_checksums_t checksums;
+			checksums.cache = checksum(cache);
+			checksums.chunks.resize(chunk_count(dag.size_bytes()));
+			auto task = [&](size_t begin, size_t end)
+			{
+				for (size_t chunk = begin; chunk < end; chunk++)
+				{
+					checksums.chunks[chunk] = checksum_chunk(dag, chunk);
+				}
+			};
+			parallel_for(checksums.chunks.size(), 1, thread_count, task, [](size_t) { return true; });
+			return checksums;
+		}
+
+		/** \brief Read the table of a DAG of dag_size bytes.
+		*/
+		void read(read_function_type read, uint64_t const dag_size)
+		{
+			uint64_t chunk_bytes = 0, count = 0;
+			read(&chunk_bytes, sizeof(chunk_bytes));
+			read(&count, sizeof(count));
+			if ((chunk_bytes != constants::DAG_CHUNK_BYTES) || (count != chunk_count(dag_size)))
+			{
+				throw hash_exception("DAG checksums are corrupt");
+			}
+
+			read(&cache.b[0], h256_t::hash_size);
+			chunks.resize(count);
+			for (auto & chunk : chunks)
+			{
+				read(&chunk.b[0], h256_t::hash_size);
+			}
+		}
+
+		void write(write_function_type write) const
+		{
+			uint64_t const chunk_bytes = constants::DAG_CHUNK_BYTES;
+			uint64_t const count = chunks.size();
+			write(&chunk_bytes, sizeof(chunk_bytes));
+			write(&count, sizeof(count));
+			write(&cache.b[0], h256_t::hash_size);
+			for (auto const & chunk : chunks)
+			{
+				write(&chunk.b[0], h256_t::hash_size);
+			}
+		}
+	};
+
+	/** \brief dag_file_writer_t writes a file sequentially in large blocks.
+	*
+	*	Data is staged in a buffer of block_size bytes aligned to block_alignment, which is written with a single call once full.
+	*	With dag_write_direct the file is opened with O_DIRECT where it is supported, bypassing the page cache,
+	*	and the final partial block is written after clearing O_DIRECT again.
+	*/
+	class dag_file_writer_t
+	{
+	public:
+		static constexpr size_t block_size = 8u * 1024u * 1024u;
+		static constexpr size_t block_alignment = 4096u;
+
+		dag_file_writer_t(::std::string const & file_path, unsigned int const flags)
+		: flags(flags)
+		, allocation(new uint8_t[block_size + block_alignment])
+		, block(reinterpret_cast<uint8_t *>((reinterpret_cast<uintptr_t>(allocation.get()) + block_alignment - 1) & ~static_cast<uintptr_t>(block_alignment - 1)))
+		, used(0)
+#ifndef WIN32
+		, fd(-1)
+#endif
+		{
+#ifndef WIN32
+			int open_flags = O_WRONLY | O_CREAT | O_TRUNC;
+#ifdef O_DIRECT
+			if (flags & dag_write_direct)
+			{
+				fd = ::open(file_path.c_str(), open_flags | O_DIRECT, 0644);
+			}
+#endif
+			// also when the file system does not support O_DIRECT
+			if (fd < 0)
+			{
+				fd = ::open(file_path.c_str(), open_flags, 0644);
+			}
+			if (fd < 0)
+			{
+				throw hash_exception("Could not open file.");
+			}
+#else
+			fs.open(file_path, ::std::ios::out | ::std::ios::binary);
+			if (fs.fail())
+			{
+				throw hash_exception("Could not open file.");
+			}
+#endif
+		}
+
+		dag_file_writer_t(dag_file_writer_t const &) = delete;
+		dag_file_writer_t & operator=(dag_file_writer_t const &) = delete;
+
+		~dag_file_writer_t()
+		{
+#ifndef WIN32
+			if (fd >= 0)
+			{
+				::close(fd);
+			}
+#endif
+		}
+
+		void write(void const * src, size_t count)
+		{
+			uint8_t const * bytes = reinterpret_cast<uint8_t const *>(src);
+			while (count > 0)
+			{
+				size_t const n = (::std::min)(count, block_size - used);
+				::std::memcpy(block + used, bytes, n);
+				used += n;
+				bytes += n;
+				count -= n;
+				if (used == block_size)
+				{
+					write_block();
+				}
+			}
+		}
+
+		/** \brief Write the staged data, flush the file to the device with dag_write_sync, and close the file.
+		*/
+		void finish()
+		{
+#ifndef WIN32
+#ifdef O_DIRECT
+			// the final block is not a multiple of the device block size
+			int const status_flags = ::fcntl(fd, F_GETFL);
+			if ((status_flags != -1) && (status_flags & O_DIRECT))
+			{
+				::fcntl(fd, F_SETFL, status_flags & ~O_DIRECT);
+			}
+#endif
+			write_block();
+			if (flags & dag_write_sync)
+			{
+#if defined(__linux__)
+				int const result = ::fdatasync(fd);
+#else
+				int const result = ::fsync(fd);
+#endif
+				if (result != 0)
+				{
+					throw hash_exception("Sync failure");
+				}
+			}
+			int const result = ::close(fd);
+			fd = -1;
+			if (result != 0)
+			{
+				throw hash_exception("Write failure");
+			}
+#else
+			write_block();
+			fs.close();
+			if (fs.fail())
+			{
+				throw hash_exception("Write failure");
+			}
+#endif
+		}
+
+	private:
+		void write_block()
+		{
+#ifndef WIN32
+			size_t written = 0;
+			while (written < used)
+			{
+				ssize_t const result = ::write(fd, block + written, used - written);
+				if (result < 0)
+				{
+					if (errno == EINTR)
+					{
+						continue;
+					}
+					throw hash_exception("Write failure");
+				}
+				written += static_cast<size_t>(result);
+			}
+#else
+			fs.write(reinterpret_cast<char const *>(block), used);
+			if (fs.fail())
+			{
+				throw hash_exception("Write failure");
+			}
+#endif
+			used = 0;
+		}
+
+		unsigned int const flags;
+		::std::unique_ptr<uint8_t[]> allocation;
+		uint8_t * const block;
+		size_t used;
+#ifndef WIN32
+		int fd;
+#else
+		::std::ofstream fs;
+#endif
+	};
+
+	template <size_t HashSize, int (*HashFunction)(uint8_t *, size_t, uint8_t const * in, size_t)>
+	struct sha3_base
+	{
+		using deserialized_hash_t = ::std::vector<node>;
+		using size_type = ::std::size_t;
+
+		static constexpr size_type hash_size = HashSize;
+		static constexpr size_type data_size = HashSize / sizeof(node);
+		deserialized_hash_t data;
+
+		sha3_base(sha3_base const &) = default;
+		sha3_base(sha3_base &&) = default;
+		sha3_base & operator=(sha3_base const &) = default;
+		sha3_base & operator=(sha3_base &&) = default;
+		~sha3_base() = default;
+
+		sha3_base()
+		:data(data_size)
+		{
+
+		}
+
+		sha3_base(::std::string const & input)
+		:sha3_base()
+		{
+			compute_hash(input.c_str(), input.size());
+		}
+
+		sha3_base(void const * input, size_type const input_size)
+		:sha3_base()
+		{
+			compute_hash(input, input_size);
+		}
+
+		inline void compute_hash(void const * input, size_type const input_size)
+		{
+			if (HashFunction(reinterpret_cast<uint8_t*>(data.data()), hash_size, reinterpret_cast<uint8_t const *>(input), input_size) != 0)
+			{
+				throw hash_exception("Unable to compute hash"); // TODO: better message?
+			}
+		}
+
+		inline deserialized_hash_t deserialize() const
+		{
+			return data;
+		}
+
+		inline static ::std::string serialize(deserialized_hash_t const & h)
+		{
+			return std::string(reinterpret_cast<const char*>(h.data()), h.size() * sizeof(node));
+		}
+
+		operator ::std::string() const
+		{
+			// TODO: fast hex conversion
+			::std::stringstream ss;
+			ss << ::std::hex;
+			uint8_t const * iEnd = reinterpret_cast<uint8_t const *>(&data.back());
+			for (uint8_t const * i = reinterpret_cast<uint8_t const *>(data.data()); i != iEnd; i++)
+			{
+				ss << ::std::setw(2) << ::std::setfill('0') << static_cast<uint16_t>(*i);
+			}
+			return ss.str();
+		}
+	};
+
+	struct sha3_256_t : public sha3_base<32, ::sha3_256>
+	{
+		sha3_256_t(::std::string const & input)
+		: sha3_base(input)
+		{
+
+		}
+
+		sha3_256_t(void const * input, size_type const input_size)
+		: sha3_base(input, input_size)
+		{
+
+		}
+	};
+
+	struct sha3_512_t : public sha3_base<64, ::sha3_512>
+	{
+		sha3_512_t(::std::string const & input)
+		: sha3_base(input)
+		{
+
+		}
+
+		sha3_512_t(void const * input, size_type const input_size)
+		: sha3_base(input, input_size)
+		{
+
+		}
+	};
+
+	// TODO: unit tests / validation
+	template <typename HashType>
+	typename HashType::deserialized_hash_t hash_words(::std::string const & data)
+	{
+		return HashType(data).data;
+	}
+
+	template <typename HashType, typename DataType>
+	typename HashType::deserialized_hash_t hash_words(DataType * data_ptr, typename HashType::size_type data_size)
+	{
+		return HashType(data_ptr, data_size).data;
+	}
+
+	// TODO: unit tests / validation
+	template <typename HashType>
+	typename HashType::deserialized_hash_t hash_words(typename HashType::deserialized_hash_t const & deserialized)
+	{
+		auto const serialized = HashType::serialize(deserialized);
+		return hash_words<HashType>(serialized);
+	}
+}
+
+namespace egihash
+{
+	constexpr h256_t::size_type h256_t::hash_size;
+
+	sizing_t::sizing_t() noexcept
+	: epoch_length(constants::EPOCH_LENGTH)
+	, cache_bytes_init(constants::CACHE_BYTES_INIT)
+	, cache_bytes_growth(constants::CACHE_BYTES_GROWTH)
+	, dataset_bytes_init(constants::DATASET_BYTES_INIT)
+	, dataset_bytes_growth(constants::DATASET_BYTES_GROWTH)
+	{
+	}
+
+	sizing_t::sizing_t(uint64_t epoch_length, uint64_t cache_bytes_init, uint64_t cache_bytes_growth, uint64_t dataset_bytes_init, uint64_t dataset_bytes_growth)
+	: epoch_length(epoch_length)
+	, cache_bytes_init(cache_bytes_init)
+	, cache_bytes_growth(cache_bytes_growth)
+	, dataset_bytes_init(dataset_bytes_init)
+	, dataset_bytes_growth(dataset_bytes_growth)
+	{
+		using namespace constants;
+
+		// sizes are rounded down to a prime number of items, so at least two items must remain
+		if ((epoch_length == 0)
+			|| (cache_bytes_init < (4 * MIX_BYTES)) || (dataset_bytes_init < (4 * MIX_BYTES))
+			|| ((cache_bytes_init % MIX_BYTES) != 0) || ((cache_bytes_growth % MIX_BYTES) != 0)
+			|| ((dataset_bytes_init % MIX_BYTES) != 0) || ((dataset_bytes_growth % MIX_BYTES) != 0))
+		{
+			throw hash_exception("Invalid sizing");
+		}
+	}
+
+	bool sizing_t::operator==(sizing_t const & rhs) const noexcept
+	{
+		return (epoch_length == rhs.epoch_length)
+			&& (cache_bytes_init == rhs.cache_bytes_init)
+			&& (cache_bytes_growth == rhs.cache_bytes_growth)
+			&& (dataset_bytes_init == rhs.dataset_bytes_init)
+			&& (dataset_bytes_growth == rhs.dataset_bytes_growth);
+	}
+
+	bool sizing_t::operator!=(sizing_t const & rhs) const noexcept
+	{
+		return !(*this == rhs);
+	}
+
+	bool sizing_t::operator<(sizing_t const & rhs) const noexcept
+	{
+		using namespace std;
+		return tie(epoch_length, cache_bytes_init, cache_bytes_growth, dataset_bytes_init, dataset_bytes_growth)
+			< tie(rhs.epoch_length, rhs.cache_bytes_init, rhs.cache_bytes_growth, rhs.dataset_bytes_init, rhs.dataset_bytes_growth);
+	}
+
+	/** \brief sizing_state_t holds the current sizing.
+	*
+	*	Sizings are interned and never freed, so the current one is read through an atomic pointer without locking,
+	*	and a sizing returned by get_sizing() stays valid when the sizing is changed.
+	*/
+	struct sizing_state_t
+	{
+		::std::mutex mutex;
+		::std::set<sizing_t> sizings;
+		::std::atomic<sizing_t const *> current;
+		bool locked;
+
+		sizing_state_t()
+		: mutex()
+		, sizings()
+		, current(&*sizings.insert(sizing_t()).first)
+		, locked(false)
+		{
+		}
+	};
+
+	// construct on first use sizing state ensures safe static initialization order
+	sizing_state_t & get_sizing_state() noexcept
+	{
+		static sizing_state_t state;
+		return state;
+	}
+
+	void set_sizing(sizing_t const & sizing)
+	{
+		auto & state = get_sizing_state();
+		::std::lock_guard<::std::mutex> lock(state.mutex);
+		if (state.locked && (sizing != *state.current.load(::std::memory_order_relaxed)))
+		{
+			throw hash_exception("The sizing is locked.");
+		}
+		state.current.store(&*state.sizings.insert(sizing).first, ::std::memory_order_release);
+	}
+
+	void lock_sizing()
+	{
+		auto & state = get_sizing_state();
+		::std::lock_guard<::std::mutex> lock(state.mutex);
+		state.locked = true;
+	}
+
+	sizing_t const & get_sizing() noexcept
+	{
+		return *get_sizing_state().current.load(::std::memory_order_acquire);
+	}
+
+	uint64_t get_epoch(uint64_t const block_number) noexcept
+	{
+		return block_number / get_sizing().epoch_length;
+	}
+
+	h256_t::h256_t(void const * input_data, size_type input_size)
+	: b{0}
+	{
+		if (::sha3_256(b, hash_size, reinterpret_cast<uint8_t const *>(input_data), input_size) != 0)
+		{
+			throw hash_exception("Keccak-256 computation failed.");
+		}
+	}
+
+	::std::string h256_t::to_hex() const
+	{
+		// TODO: fast hex conversion
+		::std::stringstream ss;
+		ss << ::std::hex << ::std::nouppercase;
+		uint8_t const * iEnd = reinterpret_cast<uint8_t const *>(&b[hash_size]);
+		for (uint8_t const * i = reinterpret_cast<uint8_t const *>(&b[0]); i != iEnd; i++)
+		{
+			ss << ::std::setw(2) << ::std::setfill('0') << static_cast<uint16_t>(*i);
+		}
+		return ss.str();
+	}
+
+	h256_t::operator bool() const
+	{
+		return (::std::memcmp(&b[0], &empty_h256.b[0], sizeof(b)) != 0);
+	}
+
+	bool h256_t::operator==(h256_t const & rhs) const
+	{
+		return (::std::memcmp(&b[0], &rhs.b[0], sizeof(b)) == 0);
+	}
+
+	constexpr h512_t::size_type h512_t::hash_size;
+
+	h512_t::h512_t(void const * input_data, size_type input_size)
+	: b{0}
+	{
+		if (::sha3_512(b, hash_size, reinterpret_cast<uint8_t const *>(input_data), input_size) != 0)
+		{
+			throw hash_exception("Keccak-512 computation failed.");
+		}
+	}
+
+	::std::string h512_t::to_hex() const
+	{
+		// TODO: fast hex conversion
+		::std::stringstream ss;
+		ss << ::std::hex << ::std::nouppercase;
+		uint8_t const * iEnd = reinterpret_cast<uint8_t const *>(&b[hash_size]);
+		for (uint8_t const * i = reinterpret_cast<uint8_t const *>(&b[0]); i != iEnd; i++)
+		{
+			ss << ::std::setw(2) << ::std::setfill('0') << static_cast<uint16_t>(*i);
+		}
+		return ss.str();
+	}
+
+	h512_t::operator bool() const
+	{
+		return (::std::memcmp(&b[0], &empty_h512.b[0], sizeof(b)) != 0);
+	}
+
+	bool h512_t::operator==(h512_t const & rhs) const
+	{
+		return (::std::memcmp(&b[0], &rhs.b[0], sizeof(b)) == 0);
+	}
+
+	result_t::operator bool() const
+	{
+		return bool(value) && bool(mixhash);
+	}
+
+	bool result_t::operator==(result_t const & rhs) const
+	{
+		return ((value == rhs.value) && (mixhash == rhs.mixhash));
+	}
+
+	// TODO: unit tests / validation
+	template <typename T>
+	sha3_512_t::deserialized_hash_t sha3_512(T const & data)
+	{
+		return hash_words<sha3_512_t>(data);
+	}
+
+	template <typename DataPtr>
+	sha3_512_t::deserialized_hash_t sha3_512(DataPtr const * data, sha3_512_t::size_type data_size)
+	{
+		return hash_words<sha3_512_t>(data, data_size);
 	}
 
 	// TODO: unit tests / validation
@@ -430,14 +1281,66 @@ namespace egihash
 		return serialize_cache(dataset);
 	}
 
+	/** \brief seedhash_table_t memoizes the seedhash of every epoch, seeds[n] is the seedhash for epoch n.
+	*/
+	struct seedhash_table_t
+	{
+		::std::mutex mutex;
+		::std::vector<h256_t> seeds;
+
+		seedhash_table_t()
+		: mutex()
+		, seeds()
+		{
+			seeds.push_back(h256_t());
+			::std::memcpy(&seeds.back().b[0], epoch0_seedhash, size_epoch0_seedhash);
+		}
+
+		// callers must hold the mutex
+		h256_t get(uint64_t const epoch)
+		{
+			uint64_t const table_epochs = (::std::min)(epoch + 1, constants::SEEDHASH_TABLE_MAX_EPOCHS);
+			if (seeds.size() < table_epochs)
+			{
+				seeds.reserve(table_epochs);
+				while (seeds.size() < table_epochs)
+				{
+					seeds.push_back(h256_t(&seeds.back().b[0], h256_t::hash_size));
+				}
+			}
+
+			if (epoch < seeds.size())
+			{
+				return seeds[epoch];
+			}
+
+			// beyond the table, derive the seedhash from the last stored one
+			h256_t seed(seeds.back());
+			for (uint64_t i = seeds.size() - 1; i < epoch; i++)
+			{
+				seed = h256_t(&seed.b[0], h256_t::hash_size);
+			}
+			return seed;
+		}
+	};
+
+	static_assert(sizeof(h256_t) == h256_t::hash_size, "Seedhash tables must be tightly packed");
+
+	// construct on first use seedhash table ensures safe static initialization order
+	seedhash_table_t & get_seedhash_table()
+	{
+		static seedhash_table_t seedhash_table;
+		return seedhash_table;
+	}
+
 	struct cache_t::impl_t
 	{
 		using size_type = cache_t::size_type;
-		using data_type = ::std::vector<std::vector<node>>;
+		using data_type = item_buffer_t;
 		using cache_cache_map = ::std::map<uint64_t /* epoch */, ::std::shared_ptr<impl_t>>;
 
 		impl_t(uint64_t const block_number, progress_callback_type callback)
-		: epoch(block_number / constants::EPOCH_LENGTH)
+		: epoch(get_epoch(block_number))
 		, seedhash(get_seedhash(block_number))
 		, size(get_cache_size(block_number))
 		, data()
@@ -447,43 +1350,49 @@ namespace egihash
 
 		impl_t(uint64_t epoch, uint64_t size, read_function_type read, progress_callback_type callback)
 		: epoch(epoch)
-		, seedhash(get_seedhash((epoch * constants::EPOCH_LENGTH) + 1))
+		, seedhash(get_seedhash((epoch * get_sizing().epoch_length) + 1))
 		, size(size)
 		, data()
 		{
 			load(read, callback);
 		}
 
+		impl_t(uint64_t epoch, uint64_t size, data_type && data)
+		: epoch(epoch)
+		, seedhash(get_seedhash((epoch * get_sizing().epoch_length) + 1))
+		, size(size)
+		, data(::std::move(data))
+		{
+		}
+
 		void mkcache(progress_callback_type callback)
 		{
 			uint32_t n = size / constants::HASH_BYTES;
 
-			data.reserve(n);
-			data.push_back(sha3_512(&seedhash.b[0], seedhash.hash_size));
+			data = data_type(n);
+			sha3_512_item(data[0], &seedhash.b[0], seedhash.hash_size);
 			for (uint32_t i = 1; i < n; i++)
 			{
-				data.push_back(sha3_512(data.back()));
+				sha3_512_item(data[i], data[i - 1], constants::HASH_BYTES);
 				if (((i % constants::CALLBACK_FREQUENCY) == 0) && !callback(i, n, cache_seeding))
 				{
 					throw hash_exception("Cache creation cancelled.");
 				}
 			}
 
-			//std::cout << "Length: " << data.size() << std::endl;
-
 			uint32_t progress_counter = 0;
 			for (uint32_t i = 0; i < constants::CACHE_ROUNDS; i++)
 			{
 				for (uint32_t j = 0; j < n; j++)
 				{
-					auto v = data[j][0].hword % n;
-					auto u = data[(n - 1 + j)%n];
-					size_t count = 0;
-					for (auto & k : u)
+					node u[constants::HASH_WORDS];
+					node const * const v = data[data[j][0].hword % n];
+					node const * const prev = data[(n - 1 + j) % n];
+					for (uint32_t k = 0; k < constants::HASH_WORDS; k++)
 					{
-						k.hword = k.hword ^ data[v][count++].hword;
+						u[k].hword = prev[k].hword ^ v[k].hword;
 					}
-					data[j] = sha3_512(u);
+					sha3_512_item(data[j], u, sizeof(u));
 
 					if (((++progress_counter % constants::CALLBACK_FREQUENCY) == 0) && !callback(progress_counter, n * constants::CACHE_ROUNDS, cache_generation))
 					{
@@ -497,13 +1406,11 @@ namespace egihash
 		{
 			size_type const cache_hash_count = size / constants::HASH_BYTES;
 
-			data.resize(cache_hash_count);
-			size_t count = 0;
-			for (auto & i : data)
+			data = data_type(cache_hash_count);
+			for (size_type i = 0; i < cache_hash_count; i++)
 			{
-				i.resize(constants::HASH_BYTES / constants::WORD_BYTES);
-				read(&i[0], constants::HASH_BYTES);
-				if (((++count % constants::CALLBACK_FREQUENCY) == 0) && !callback(count, cache_hash_count, cache_loading))
+				read(data[i], constants::HASH_BYTES);
+				if ((((i + 1) % constants::CALLBACK_FREQUENCY) == 0) && !callback(i + 1, cache_hash_count, cache_loading))
 				{
 					throw hash_exception("Cache loading cancelled.");
 				}
@@ -514,7 +1421,8 @@ namespace egihash
 		{
 			using namespace constants;
 
-			size_type cache_size = (CACHE_BYTES_INIT + (CACHE_BYTES_GROWTH * (block_number / EPOCH_LENGTH))) - HASH_BYTES;
+			auto const & sizing = get_sizing();
+			size_type cache_size = (sizing.cache_bytes_init + (sizing.cache_bytes_growth * get_epoch(block_number))) - HASH_BYTES;
 			while (!is_prime(cache_size / HASH_BYTES))
 			{
 				cache_size -= (2 * HASH_BYTES);
@@ -522,17 +1430,7 @@ namespace egihash
 			return cache_size;
 		}
 
-		static h256_t get_seedhash(uint64_t const block_number)
-		{
-			::std::string s(epoch0_seedhash, size_epoch0_seedhash);
-			for (size_t i = 0; i < (block_number / constants::EPOCH_LENGTH); i++)
-			{
-				s = sha3_256_t::serialize(sha3_256(s));
-			}
-			h256_t ret;
-			::std::memcpy(&ret.b[0], s.c_str(), (std::min)(ret.hash_size, s.length()));
-			return ret;
-		}
+		static h256_t get_seedhash(uint64_t const block_number);
 
 		uint64_t epoch;
 		h256_t seedhash;
@@ -550,24 +1448,156 @@ namespace egihash
 	std::recursive_mutex & cache_cache_mutex = get_cache_cache_mutex();
 
 	// construct on first use dag_cache_map ensures safe static initialization order
+	// caches are registered per sizing, the cache cache of the current sizing is returned
 	cache_t::impl_t::cache_cache_map & get_cache_cache()
 	{
 		std::lock_guard<std::recursive_mutex> lock(get_cache_cache_mutex());
-		static cache_t::impl_t::cache_cache_map cache_cache;
-		return cache_cache;
+		static ::std::map<sizing_t, cache_t::impl_t::cache_cache_map> cache_caches;
+		return cache_caches[get_sizing()];
 	}
 	// ensures single threaded construction
 	cache_t::impl_t::cache_cache_map & cache_cache = get_cache_cache();
 
+	// least recently used bookkeeping for the cache cache, guarded by the cache cache mutex
+	struct cache_cache_policy_t
+	{
+		uint64_t budget_bytes = 0;
+		uint64_t use_clock = 0;
+		::std::map<uint64_t /* epoch */, uint64_t /* use_clock */> last_use;
+		::std::set<uint64_t> pinned;
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t evictions = 0;
+
+		void touch(uint64_t const epoch)
+		{
+			last_use[epoch] = ++use_clock;
+		}
+
+		static uint64_t loaded_bytes()
+		{
+			uint64_t bytes = 0;
+			for (auto const & i : get_cache_cache())
+			{
+				bytes += i.second->size;
+			}
+			return bytes;
+		}
+
+		// unload least recently used caches until the loaded caches fit the budget
+		void enforce_budget(uint64_t const keep_epoch)
+		{
+			if (budget_bytes == 0)
+			{
+				return;
+			}
+
+			auto & caches = get_cache_cache();
+			uint64_t bytes = loaded_bytes();
+			while (bytes > budget_bytes)
+			{
+				auto victim = last_use.end();
+				for (auto i = last_use.begin(); i != last_use.end(); i++)
+				{
+					if ((i->first != keep_epoch) && (pinned.count(i->first) == 0) && ((victim == last_use.end()) || (i->second < victim->second)))
+					{
+						victim = i;
+					}
+				}
+				if (victim == last_use.end())
+				{
+					break;
+				}
+
+				auto const cache_iterator = caches.find(victim->first);
+				if (cache_iterator != caches.end())
+				{
+					bytes -= cache_iterator->second->size;
+					caches.erase(cache_iterator);
+					evictions++;
+				}
+				last_use.erase(victim);
+			}
+		}
+	};
+
+	// construct on first use policy ensures safe static initialization order
+	cache_cache_policy_t & get_cache_cache_policy()
+	{
+		std::lock_guard<std::recursive_mutex> lock(get_cache_cache_mutex());
+		static cache_cache_policy_t policy;
+		return policy;
+	}
+
 	void cache_t::unload() const
 	{
+		std::lock_guard<std::recursive_mutex> lock(get_cache_cache_mutex());
 		get_cache_cache().erase(epoch());
+		get_cache_cache_policy().last_use.erase(epoch());
+	}
+
+	void cache_t::set_memory_budget(uint64_t const budget_bytes)
+	{
+		std::lock_guard<std::recursive_mutex> lock(get_cache_cache_mutex());
+		auto & policy = get_cache_cache_policy();
+		policy.budget_bytes = budget_bytes;
+		policy.enforce_budget(::std::numeric_limits<uint64_t>::max());
+	}
+
+	void cache_t::set_pinned_epochs(::std::vector<uint64_t> const & epochs)
+	{
+		std::lock_guard<std::recursive_mutex> lock(get_cache_cache_mutex());
+		auto & policy = get_cache_cache_policy();
+		policy.pinned = ::std::set<uint64_t>(epochs.begin(), epochs.end());
+		policy.enforce_budget(::std::numeric_limits<uint64_t>::max());
+	}
+
+	cache_t::stats_t cache_t::get_stats()
+	{
+		std::lock_guard<std::recursive_mutex> lock(get_cache_cache_mutex());
+		auto const & policy = get_cache_cache_policy();
+		stats_t stats;
+		stats.hits = policy.hits;
+		stats.misses = policy.misses;
+		stats.evictions = policy.evictions;
+		stats.loaded_count = get_cache_cache().size();
+		stats.loaded_bytes = policy.loaded_bytes();
+		stats.budget_bytes = policy.budget_bytes;
+		return stats;
+	}
+
+	// register a cache as the loaded cache of its epoch, unless one has been registered in the meantime
+	::std::shared_ptr<cache_t::impl_t> add_to_cache_cache(uint64_t const epoch_number, ::std::shared_ptr<cache_t::impl_t> const & impl)
+	{
+		using namespace std;
+
+		lock_guard<recursive_mutex> lock(get_cache_cache_mutex());
+		auto insert_pair = get_cache_cache().insert(make_pair(epoch_number, impl));
+		auto & policy = get_cache_cache_policy();
+		policy.touch(epoch_number);
+
+		// if insert succeded, make room for the new cache and return it
+		if (insert_pair.second)
+		{
+			policy.enforce_budget(epoch_number);
+			return insert_pair.first->second;
+		}
+
+		// if insert failed, it's probably already been inserted
+		auto const cache_cache_iterator = get_cache_cache().find(epoch_number);
+		if (cache_cache_iterator != get_cache_cache().end())
+		{
+			return cache_cache_iterator->second;
+		}
+
+		// we couldn't insert it and it's not in the cache
+		throw hash_exception("Could not get cache");
 	}
 
 	::std::shared_ptr<cache_t::impl_t> get_cache_from_cache(uint64_t const block_number, progress_callback_type callback)
 	{
 		using namespace std;
-		uint64_t epoch_number = block_number / constants::EPOCH_LENGTH;
+		uint64_t epoch_number = get_epoch(block_number);
 
 		// if we have the correct cache already loaded, return it from the cache cache
 		{
@@ -575,37 +1605,200 @@ namespace egihash
 			auto const cache_cache_iterator = get_cache_cache().find(epoch_number);
 			if (cache_cache_iterator != get_cache_cache().end())
 			{
+				auto & policy = get_cache_cache_policy();
+				policy.hits++;
+				policy.touch(epoch_number);
 				return cache_cache_iterator->second;
 			}
+			get_cache_cache_policy().misses++;
 		}
 
 		// otherwise create the cache and add it to the cache cache
 		// this is not locked as it can be a lengthy process and we don't want to block access to the cache cache
 		shared_ptr<cache_t::impl_t> impl(new cache_t::impl_t(block_number, callback));
+		return add_to_cache_cache(epoch_number, impl);
+	}
 
-		lock_guard<recursive_mutex> lock(get_cache_cache_mutex());
-		auto insert_pair = get_cache_cache().insert(make_pair(epoch_number, impl));
+	// returns the cache of an epoch if it is already loaded, nullptr otherwise
+	::std::shared_ptr<cache_t::impl_t> find_in_cache_cache(uint64_t const epoch_number)
+	{
+		std::lock_guard<std::recursive_mutex> lock(get_cache_cache_mutex());
+		auto const cache_cache_iterator = get_cache_cache().find(epoch_number);
+		if (cache_cache_iterator != get_cache_cache().end())
+		{
+			get_cache_cache_policy().touch(epoch_number);
+			return cache_cache_iterator->second;
+		}
+		return nullptr;
+	}
+
+	::std::shared_ptr<cache_t::impl_t> read_cache_file(::std::string const & file_path, progress_callback_type callback)
+	{
+		using namespace std;
+		using size_type = cache_t::size_type;
+
+		ifstream fs;
+		fs.open(file_path, ios::in | ios::binary);
+		if (fs.fail())
+		{
+			throw hash_exception("Could not open cache file.");
+		}
+		fs.seekg(0, ios::end);
+		size_type const filesize = static_cast<size_type>(fs.tellg());
+		fs.seekg(0, ios::beg);
+
+		auto read = [&fs](void * dst, size_type count)
+		{
+			fs.read(reinterpret_cast<char *>(dst), count);
+			if (fs.fail())
+			{
+				throw hash_exception("Read failure");
+			}
+		};
+
+		cache_file_header_t header(read);
+		if (filesize != (constants::CACHE_FILE_HEADER_SIZE + header.size))
+		{
+			throw hash_exception("Cache is corrupt");
+		}
+
+		auto const loaded = find_in_cache_cache(header.epoch);
+		if (loaded)
+		{
+			return loaded;
+		}
+
+		size_type const item_count = header.size / constants::HASH_BYTES;
+		item_buffer_t data(item_count);
+		for (size_type i = 0; i < item_count; i += constants::CALLBACK_FREQUENCY)
+		{
+			size_type const count = (::std::min)(item_count - i, static_cast<size_type>(constants::CALLBACK_FREQUENCY));
+			read(data[i], count * constants::HASH_BYTES);
+			if (!callback(i + count, item_count, cache_loading))
+			{
+				throw hash_exception("Cache loading cancelled.");
+			}
+		}
+
+		if (!(h256_t(data[0], header.size) == header.checksum))
+		{
+			throw hash_exception("Cache is corrupt");
+		}
+
+		shared_ptr<cache_t::impl_t> impl(new cache_t::impl_t(header.epoch, header.size, move(data)));
+		return add_to_cache_cache(header.epoch, impl);
+	}
+
+#ifndef WIN32
+	::std::shared_ptr<cache_t::impl_t> map_cache_file(::std::string const & file_path, progress_callback_type callback)
+	{
+		using namespace std;
+		using size_type = cache_t::size_type;
+
+		auto const mapping = make_shared<mapped_file_t>(file_path);
+
+		size_type offset = 0;
+		auto read = [&mapping, &offset](void * dst, size_type count)
+		{
+			if (count > (mapping->size() - offset))
+			{
+				throw hash_exception("Read failure");
+			}
+			::std::memcpy(dst, mapping->data() + offset, count);
+			offset += count;
+		};
+
+		cache_file_header_t header(read);
+		if (mapping->size() != (constants::CACHE_FILE_HEADER_SIZE + header.size))
+		{
+			throw hash_exception("Cache is corrupt");
+		}
+
+		auto const loaded = find_in_cache_cache(header.epoch);
+		if (loaded)
+		{
+			return loaded;
+		}
+
+		// every cache item is needed to compute light hashes and the checksum reads them all anyway
+		mapping->advise(constants::CACHE_FILE_HEADER_SIZE, header.size, MADV_WILLNEED);
+
+		// the buffer shares ownership of the mapping, the mapping is read-only so the items must never be written to
+		uint8_t * const base = const_cast<uint8_t *>(mapping->data());
+		size_type const item_count = header.size / constants::HASH_BYTES;
+		item_buffer_t data(reinterpret_cast<node *>(base + constants::CACHE_FILE_HEADER_SIZE), item_count, [mapping]() {});
+
+		if (!(h256_t(data[0], header.size) == header.checksum))
+		{
+			throw hash_exception("Cache is corrupt");
+		}
+
+		if (!callback(item_count, item_count, cache_loading))
+		{
+			throw hash_exception("Cache loading cancelled.");
+		}
+
+		shared_ptr<cache_t::impl_t> impl(new cache_t::impl_t(header.epoch, header.size, move(data)));
+		return add_to_cache_cache(header.epoch, impl);
+	}
+#endif // WIN32
+
+	::std::shared_ptr<cache_t::impl_t> get_cache_from_file(::std::string const & file_path, progress_callback_type callback, dag_load_mode mode)
+	{
+#ifndef WIN32
+		if (mode == dag_load_mmap)
+		{
+			return map_cache_file(file_path, callback);
+		}
+#endif // WIN32
+		// memory mapping is unavailable on this platform, fall back to reading the file
+		return read_cache_file(file_path, callback);
+	}
+
+	cache_t::cache_t(uint64_t const block_number, progress_callback_type callback)
+	: impl(get_cache_from_cache(block_number, callback))
+	{
+	}
+
+	cache_t::cache_t(::std::string const & file_path, progress_callback_type callback, dag_load_mode mode)
+	: impl(get_cache_from_file(file_path, callback, mode))
+	{
+	}
+
+	void cache_t::save(::std::string const & file_path, progress_callback_type callback) const
+	{
+		using namespace std;
 
-		// if insert succeded, return the cache
-		if (insert_pair.second)
+		ofstream fs;
+		fs.open(file_path, ios::out | ios::binary | ios::trunc);
+		if (fs.fail())
 		{
-			return insert_pair.first->second;
+			throw hash_exception("Could not open cache file for writing.");
 		}
 
-		// if insert failed, it's probably already been inserted
-		auto const cache_cache_iterator = get_cache_cache().find(epoch_number);
-		if (cache_cache_iterator != get_cache_cache().end())
+		auto write = [&fs](void const * data, size_t count)
 		{
-			return cache_cache_iterator->second;
-		}
+			fs.write(reinterpret_cast<char const *>(data), count);
+			if (fs.fail())
+			{
+				throw hash_exception("Write failure");
+			}
+		};
 
-		// we couldn't insert it and it's not in the cache
-		throw hash_exception("Could not get cache");
-	}
+		auto const items = data();
+		cache_file_header_t const header(epoch(), size(), seedhash(), h256_t(items.data(), items.size_bytes()));
+		header.write(write);
 
-	cache_t::cache_t(uint64_t const block_number, progress_callback_type callback)
-	: impl(get_cache_from_cache(block_number, callback))
-	{
+		size_type const item_count = items.size();
+		for (size_type i = 0; i < item_count; i += constants::CALLBACK_FREQUENCY)
+		{
+			size_type const count = (::std::min)(item_count - i, static_cast<size_type>(constants::CALLBACK_FREQUENCY));
+			write(items[i], count * constants::HASH_BYTES);
+			if (!callback(i + count, item_count, cache_saving))
+			{
+				throw hash_exception("Cache save cancelled.");
+			}
+		}
 	}
 
 	cache_t::cache_t(uint64_t epoch, uint64_t size, read_function_type read, progress_callback_type callback)
@@ -613,6 +1806,11 @@ namespace egihash
 	{
 	}
 
+	cache_t::cache_t(::std::shared_ptr<impl_t> const & impl)
+	: impl(impl)
+	{
+	}
+
 	uint64_t cache_t::epoch() const
 	{
 		return impl->epoch;
@@ -623,9 +1821,9 @@ namespace egihash
 		return impl->size;
 	}
 
-	cache_t::data_type const & cache_t::data() const
+	cache_t::data_type cache_t::data() const
 	{
-		return impl->data;
+		return impl->data.view();
 	}
 
 	h256_t cache_t::seedhash() const
@@ -643,11 +1841,138 @@ namespace egihash
 		return impl_t::get_cache_size(block_number);
 	}
 
+	h256_t cache_t::impl_t::get_seedhash(uint64_t const block_number)
+	{
+		auto & table = get_seedhash_table();
+		::std::lock_guard<::std::mutex> lock(table.mutex);
+		return table.get(get_epoch(block_number));
+	}
+
 	h256_t cache_t::get_seedhash(uint64_t const block_number)
 	{
 		return impl_t::get_seedhash(block_number);
 	}
 
+	void cache_t::load_seedhashes(::std::string const & file_path)
+	{
+		using namespace std;
+
+		ifstream fs;
+		fs.open(file_path, ios::in | ios::binary);
+		if (fs.fail())
+		{
+			throw hash_exception("Could not open seedhash file.");
+		}
+
+		auto read = [&fs](void * dst, size_t count)
+		{
+			fs.read(reinterpret_cast<char *>(dst), count);
+			if (fs.fail())
+			{
+				throw hash_exception("Read failure");
+			}
+		};
+
+		char magic[sizeof(constants::SEEDHASH_MAGIC_BYTES)] = {0};
+		read(magic, sizeof(magic));
+		if (::std::memcmp(magic, constants::SEEDHASH_MAGIC_BYTES, sizeof(magic)) != 0)
+		{
+			throw hash_exception("Not a seedhash file");
+		}
+
+		uint64_t count = 0;
+		read(&count, sizeof(count));
+		if ((count == 0) || (count > constants::SEEDHASH_TABLE_MAX_EPOCHS))
+		{
+			throw hash_exception("Seedhash file is corrupt");
+		}
+
+		vector<h256_t> seeds(count);
+		read(&seeds[0], count * sizeof(h256_t));
+
+		h256_t checksum;
+		read(&checksum.b[0], sizeof(checksum.b));
+		if (!(h256_t(&seeds[0], count * sizeof(h256_t)) == checksum) || (::std::memcmp(&seeds[0].b[0], epoch0_seedhash, size_epoch0_seedhash) != 0))
+		{
+			throw hash_exception("Seedhash file is corrupt");
+		}
+
+		// the checksum only guards against accidental corruption, every seedhash must also follow from its predecessor
+		for (size_t i = 1; i < seeds.size(); i++)
+		{
+			if (!(seeds[i] == h256_t(&seeds[i - 1].b[0], h256_t::hash_size)))
+			{
+				throw hash_exception("Seedhash file is corrupt");
+			}
+		}
+
+		auto & table = get_seedhash_table();
+		lock_guard<mutex> lock(table.mutex);
+		if (seeds.size() > table.seeds.size())
+		{
+			table.seeds.swap(seeds);
+		}
+	}
+
+	void cache_t::save_seedhashes(::std::string const & file_path)
+	{
+		using namespace std;
+
+		vector<h256_t> seeds;
+		{
+			auto & table = get_seedhash_table();
+			lock_guard<mutex> lock(table.mutex);
+			seeds = table.seeds;
+		}
+
+		// write a temporary file and rename it over the previous one, so an interrupted save never leaves a truncated file behind
+		// the temporary file is unique to this process, as the file may be shared by several processes
+		static mutex save_mutex;
+		lock_guard<mutex> lock(save_mutex);
+		stringstream temp_name;
+		temp_name << file_path << "." << hex << chrono::steady_clock::now().time_since_epoch().count();
+#ifndef WIN32
+		temp_name << "-" << ::getpid();
+#endif
+		temp_name << ".tmp";
+		string const temp_path = temp_name.str();
+		{
+			ofstream fs;
+			fs.open(temp_path, ios::out | ios::binary | ios::trunc);
+
+			auto write = [&fs, &temp_path](void const * data, size_t count)
+			{
+				fs.write(reinterpret_cast<char const *>(data), count);
+				if (fs.fail())
+				{
+					fs.close();
+					::std::remove(temp_path.c_str());
+					throw hash_exception("Write failure");
+				}
+			};
+
+			uint64_t const count = seeds.size();
+			h256_t const checksum(&seeds[0], count * sizeof(h256_t));
+			write(constants::SEEDHASH_MAGIC_BYTES, sizeof(constants::SEEDHASH_MAGIC_BYTES));
+			write(&count, sizeof(count));
+			write(&seeds[0], count * sizeof(h256_t));
+			write(&checksum.b[0], sizeof(checksum.b));
+			fs.close();
+			if (fs.fail())
+			{
+				::std::remove(temp_path.c_str());
+				throw hash_exception("Write failure");
+			}
+		}
+
+		// rename does not replace an existing file on every platform
+		if ((::std::rename(temp_path.c_str(), file_path.c_str()) != 0) && ((::std::remove(file_path.c_str()) != 0) || (::std::rename(temp_path.c_str(), file_path.c_str()) != 0)))
+		{
+			::std::remove(temp_path.c_str());
+			throw hash_exception("Could not replace seedhash file.");
+		}
+	}
+
 	bool cache_t::is_loaded(uint64_t const epoch)
 	{
 		using namespace std;
@@ -673,17 +1998,47 @@ namespace egihash
 	struct dag_t::impl_t
 	{
 		using size_type = dag_t::size_type;
-		using data_type = ::std::vector<::std::vector<node>>;
+		using data_type = item_buffer_t;
 		using dag_cache_map = ::std::map<uint64_t /* epoch */, ::std::shared_ptr<impl_t>>;
 		static constexpr uint64_t max_epoch = ::std::numeric_limits<uint64_t>::max();
 
-		impl_t(uint64_t block_number, progress_callback_type callback)
-		: epoch(block_number / constants::EPOCH_LENGTH)
+		impl_t(uint64_t block_number, progress_callback_type callback, unsigned int thread_count)
+		: epoch(get_epoch(block_number))
 		, size(get_full_size(block_number))
 		, cache(block_number, callback)
-		, data()
+		, data(data_type::dag_items(size / constants::HASH_BYTES))
+		{
+			generate(callback, thread_count, nullptr);
+		}
+
+		impl_t(uint64_t block_number, ::std::string const & file_path, progress_callback_type callback, unsigned int thread_count, unsigned int write_flags)
+		: epoch(get_epoch(block_number))
+		, size(get_full_size(block_number))
+		, cache(block_number, callback)
+		, data(data_type::dag_items(size / constants::HASH_BYTES))
 		{
-			generate(callback);
+			save_pipeline_t pipeline(*this, file_path, write_flags);
+			try
+			{
+				generate(callback, thread_count, &pipeline);
+				pipeline.finish();
+			}
+			catch (...)
+			{
+				// the partial file is removed whether generation was cancelled or writing failed
+				try
+				{
+					pipeline.abort();
+				}
+				catch (...)
+				{
+					// a write error is what cancelled the generation, report it instead
+					::std::remove(file_path.c_str());
+					throw;
+				}
+				::std::remove(file_path.c_str());
+				throw;
+			}
 		}
 
 		impl_t(read_function_type read, dag_file_header_t & header, progress_callback_type callback)
@@ -693,135 +2048,557 @@ namespace egihash
 		, data()
 		{
 			// load the DAG
-			size_type dag_hash_count = size / constants::HASH_BYTES;
-			data.resize(dag_hash_count);
-			size_t count = 0;
-			for (auto & i : data)
+			size_type const dag_hash_count = size / constants::HASH_BYTES;
+			data = data_type::dag_items(dag_hash_count);
+			for (size_type i = 0; i < dag_hash_count; i++)
 			{
-				i.resize(constants::HASH_BYTES / constants::WORD_BYTES);
-				read(&i[0], constants::HASH_BYTES);
-				if (((++count % constants::CALLBACK_FREQUENCY) == 0) && !callback(count, data.size(), dag_loading))
+				read(data[i], constants::HASH_BYTES);
+				if ((((i + 1) % constants::CALLBACK_FREQUENCY) == 0) && !callback(i + 1, dag_hash_count, dag_loading))
 				{
 					throw hash_exception("DAG loading cancelled.");
 				}
 			}
 		}
 
-		void save(::std::string const & file_path, progress_callback_type callback) const
+		impl_t(dag_file_header_t const & header, cache_t::impl_t::data_type && cache_data, data_type && dag_data)
+		: epoch(header.epoch)
+		, size(header.dag_end - header.dag_begin)
+		, cache(::std::make_shared<cache_t::impl_t>(header.epoch, header.cache_end - header.cache_begin, ::std::move(cache_data)))
+		, data(::std::move(dag_data))
 		{
-			using namespace std;
-			ofstream fs;
-			fs.open(file_path, ios::out | ios::binary);
+		}
+
+		void save(::std::string const & file_path, progress_callback_type callback, unsigned int write_flags) const
+		{
+			dag_file_writer_t writer(file_path, write_flags);
+			auto const write = [&writer](void const * src, size_t count)
+			{
+				writer.write(src, count);
+			};
+
+			write_header(write);
+
+			// the cache and the DAG are contiguous, so they are written in ranges of constants::CALLBACK_FREQUENCY items
+			auto const cache_data = cache.data();
+			size_t const max_count = cache_data.size() + data.size();
+			size_t count = 0;
+			for (auto const & items : { cache_data, data.view() })
+			{
+				for (size_t i = 0; i < items.size(); i += constants::CALLBACK_FREQUENCY)
+				{
+					size_t const n = (::std::min)(static_cast<size_t>(constants::CALLBACK_FREQUENCY), items.size() - i);
+					write(items[i], n * constants::HASH_BYTES);
+					count += n;
+					if (!callback(count, max_count, dag_saving))
+					{
+						throw hash_exception("DAG save cancelled.");
+					}
+				}
+			}
+
+			// the checksum table follows the DAG, so files of minor version 0 and 1 share all offsets
+			dag_checksums_t::compute(cache_data, data.view(), 0).write(write);
+			writer.finish();
+		}
 
+		void write_header(dag_checksums_t::write_function_type write) const
+		{
 			uint64_t cache_begin = constants::DAG_FILE_HEADER_SIZE + 1;
 			uint64_t cache_end = cache_begin + cache.size();
 			uint64_t dag_begin = cache_end;
 			uint64_t dag_end = dag_begin + size;
 
-			auto write = [&fs](void const * data, size_type count)
+			// TODO: write all value in little endian
+			write(constants::DAG_MAGIC_BYTES, sizeof(constants::DAG_MAGIC_BYTES));
+			write(&constants::MAJOR_VERSION, sizeof(constants::MAJOR_VERSION));
+			write(&constants::REVISION, sizeof(constants::REVISION));
+			write(&constants::MINOR_VERSION, sizeof(constants::MINOR_VERSION));
+			write(&epoch, sizeof(epoch));
+			write(&cache_begin, sizeof(cache_begin));
+			write(&cache_end, sizeof(cache_end));
+			write(&dag_begin, sizeof(dag_begin));
+			write(&dag_end, sizeof(dag_end));
+		}
+
+		/** \brief save_pipeline_t writes a DAG file on its own thread while the DAG is being generated.
+		*
+		*	Generating threads report ranges of constants::CALLBACK_FREQUENCY items as complete in any order.
+		*	The pipeline writes the completed prefix of the DAG in file order, and checksums each chunk once all of its items are written.
+		*/
+		class save_pipeline_t
+		{
+		public:
+			static_assert((dag_checksums_t::chunk_items % constants::CALLBACK_FREQUENCY) == 0, "DAG chunks must consist of whole ranges");
+
+			save_pipeline_t(impl_t const & dag, ::std::string const & file_path, unsigned int const write_flags)
+			: dag(dag)
+			, writer(file_path, write_flags)
+			, range_count((dag.data.size() + constants::CALLBACK_FREQUENCY - 1) / constants::CALLBACK_FREQUENCY)
+			, complete_ranges(new ::std::atomic<bool>[range_count])
+			, checksums()
+			, cancelled(false)
+			, failed(false)
+			{
+				for (size_t i = 0; i < range_count; i++)
+				{
+					complete_ranges[i].store(false, ::std::memory_order_relaxed);
+				}
+				checksums.cache = dag_checksums_t::checksum(dag.cache.data());
+				checksums.chunks.resize(dag_checksums_t::chunk_count(dag.size));
+				worker = ::std::thread(&save_pipeline_t::run, this);
+			}
+
+			save_pipeline_t(save_pipeline_t const &) = delete;
+			save_pipeline_t & operator=(save_pipeline_t const &) = delete;
+
+			~save_pipeline_t()
+			{
+				stop();
+			}
+
+			/** \brief Mark the items [begin, end) as generated, begin must be a multiple of constants::CALLBACK_FREQUENCY.
+			*/
+			void complete(size_t const begin, size_t const end)
+			{
+				for (size_t range = begin / constants::CALLBACK_FREQUENCY; (range * constants::CALLBACK_FREQUENCY) < end; range++)
+				{
+					complete_ranges[range].store(true, ::std::memory_order_release);
+				}
+				{
+					::std::lock_guard<::std::mutex> lock(mutex);
+				}
+				condition.notify_one();
+			}
+
+			/** \brief Test if writing has failed, generation should then be cancelled.
+			*/
+			bool healthy() const noexcept
+			{
+				return !failed;
+			}
+
+			/** \brief Wait until the whole DAG is written, then write the checksums and close the file.
+			*/
+			void finish()
+			{
+				worker.join();
+				if (error)
+				{
+					::std::rethrow_exception(error);
+				}
+				checksums.write([this](void const * src, size_t count) { writer.write(src, count); });
+				writer.finish();
+			}
+
+			/** \brief Stop writing, and throw the write error if there was one.
+			*/
+			void abort()
+			{
+				stop();
+				if (error)
+				{
+					::std::rethrow_exception(error);
+				}
+			}
+
+		private:
+			void stop()
+			{
+				{
+					::std::lock_guard<::std::mutex> lock(mutex);
+					cancelled = true;
+				}
+				condition.notify_one();
+				if (worker.joinable())
+				{
+					worker.join();
+				}
+			}
+
+			void run()
+			{
+				try
+				{
+					dag.write_header([this](void const * src, size_t count) { writer.write(src, count); });
+					auto const cache_data = dag.cache.data();
+					writer.write(cache_data.data(), cache_data.size_bytes());
+
+					auto const items = dag.data.view();
+					for (size_t range = 0; range < range_count; range++)
+					{
+						{
+							::std::unique_lock<::std::mutex> lock(mutex);
+							condition.wait(lock, [this, range]() { return cancelled || complete_ranges[range].load(::std::memory_order_acquire); });
+							if (cancelled)
+							{
+								return;
+							}
+						}
+
+						size_t const begin = range * constants::CALLBACK_FREQUENCY;
+						size_t const end = (::std::min)(begin + constants::CALLBACK_FREQUENCY, items.size());
+						writer.write(items[begin], (end - begin) * constants::HASH_BYTES);
+						if (((end % dag_checksums_t::chunk_items) == 0) || (end == items.size()))
+						{
+							size_t const chunk = (end - 1) / dag_checksums_t::chunk_items;
+							checksums.chunks[chunk] = dag_checksums_t::checksum_chunk(items, chunk);
+						}
+					}
+				}
+				catch (...)
+				{
+					error = ::std::current_exception();
+					failed = true;
+				}
+			}
+
+			impl_t const & dag;
+			dag_file_writer_t writer;
+			size_t const range_count;
+			::std::unique_ptr<::std::atomic<bool>[]> complete_ranges;
+			dag_checksums_t checksums;
+			::std::mutex mutex;
+			::std::condition_variable condition;
+			bool cancelled;
+			::std::atomic<bool> failed;
+			::std::exception_ptr error;
+			::std::thread worker;
+		};
+
+		// generate the items of data, reporting completed ranges to pipeline if it is not null
+		void generate(progress_callback_type callback, unsigned int thread_count, save_pipeline_t * pipeline)
+		{
+			uint32_t const n = size / constants::HASH_BYTES;
+			auto const cache_data = cache.data();
+
+			thread_count = resolve_thread_count(thread_count);
+			if (thread_count == 1)
+			{
+				for (uint32_t i = 0; i < n; i += constants::CALLBACK_FREQUENCY)
+				{
+					uint32_t const end = (::std::min)(i + constants::CALLBACK_FREQUENCY, n);
+					calc_dataset_items(cache_data, i, end, data);
+					if (pipeline)
+					{
+						pipeline->complete(i, end);
+					}
+					if (!callback(i, n, dag_generation) || (pipeline && !pipeline->healthy()))
+					{
+						throw hash_exception("DAG creation cancelled.");
+					}
+				}
+				return;
+			}
+
+			// every item depends only on the cache, so the items can be computed in any order by any thread
+			auto const task = [this, &cache_data, pipeline](size_t begin, size_t end)
+			{
+				calc_dataset_items(cache_data, static_cast<uint32_t>(begin), static_cast<uint32_t>(end), data);
+				if (pipeline)
+				{
+					pipeline->complete(begin, end);
+				}
+			};
+			auto const progress = [&callback, n, pipeline](size_t done)
+			{
+				return callback(done, n, dag_generation) && !(pipeline && !pipeline->healthy());
+			};
+			if (!parallel_for(n, constants::CALLBACK_FREQUENCY, thread_count, task, progress))
+			{
+				throw hash_exception("DAG creation cancelled.");
+			}
+		}
+
+		static void calc_dataset_item(data_view_t const & cache, uint32_t const i, node * out)
+		{
+			uint32_t const n = cache.size();
+			node mix[constants::HASH_WORDS];
+			::std::memcpy(mix, cache[i % n], sizeof(mix));
+			mix[0].hword ^= i;
+			sha3_512_item(mix, mix, sizeof(mix));
+			fnv_kernels::active_kernels().dataset_parents(mix, cache, i);
+			sha3_512_item(out, mix, sizeof(mix));
+		}
+
+		// compute DAG items [begin, end) into their places in data
+		static void calc_dataset_items(data_view_t const & cache, uint32_t const begin, uint32_t const end, data_type & data)
+		{
+			if (begin < end)
+			{
+				calc_dataset_items(cache, begin, end, data[begin]);
+			}
+		}
+
+		// compute DAG items [begin, end) four at a time into consecutive items starting at out,
+		// so their Keccak-512 hashes share one multi-buffer call
+		static void calc_dataset_items(data_view_t const & cache, uint32_t const begin, uint32_t const end, node * out)
+		{
+			auto const item = [out, begin](uint32_t const i) { return out + ((i - begin) * constants::HASH_WORDS); };
+			uint32_t const n = cache.size();
+			auto const & kernels = fnv_kernels::active_kernels();
+			uint32_t i = begin;
+			for (; (end - i) >= 4; i += 4)
+			{
+				node mix[4][constants::HASH_WORDS];
+				for (uint32_t m = 0; m < 4; m++)
+				{
+					::std::memcpy(mix[m], cache[(i + m) % n], sizeof(mix[m]));
+					mix[m][0].hword ^= i + m;
+				}
+				node * const mix_out[4] = { mix[0], mix[1], mix[2], mix[3] };
+				node const * const mix_in[4] = { mix[0], mix[1], mix[2], mix[3] };
+				sha3_512_items_x4(mix_out, mix_in, sizeof(mix[0]));
+				for (uint32_t m = 0; m < 4; m++)
+				{
+					kernels.dataset_parents(mix[m], cache, i + m);
+				}
+				node * const items[4] = { item(i), item(i + 1), item(i + 2), item(i + 3) };
+				sha3_512_items_x4(items, mix_in, sizeof(mix[0]));
+			}
+			for (; i < end; i++)
+			{
+				calc_dataset_item(cache, i, item(i));
+			}
+		}
+
+		cache_t get_cache() const
+		{
+			return cache;
+		}
+
+		static size_type get_full_size(uint64_t const block_number) noexcept
+		{
+			using namespace constants;
+
+			auto const & sizing = get_sizing();
+			uint64_t full_size = (sizing.dataset_bytes_init + (sizing.dataset_bytes_growth * get_epoch(block_number))) - MIX_BYTES;
+			while (!is_prime(full_size / MIX_BYTES))
+			{
+				full_size -= (2 * MIX_BYTES);
+			}
+			return full_size;
+		}
+
+		/** \brief chunk_verifier_t checks the chunks of a loaded DAG against the checksums of its file, and regenerates corrupt chunks.
+		*
+		*	Every chunk is verified once, either all at once by verify_all(), on a background thread started by verify_in_background(),
+		*	or on first use by ensure(). Threads using a chunk which is being verified wait for it, verified chunks are only read.
+		*	Regenerated chunks are installed into the DAG and written back to the file, if it is writable.
+		*/
+		struct chunk_verifier_t
+		{
+			/** \brief Replace count items of the DAG starting at first_item with items. */
+			using install_function_type = ::std::function<void(size_t first_item, node const * items, size_t count)>;
+
+			chunk_verifier_t(dag_checksums_t && checksums, data_view_t const & cache_data, data_type & dag_data, ::std::string const & file_path, uint64_t const dag_offset, install_function_type install)
+			: checksums(::std::move(checksums))
+			, cache_data(cache_data)
+			, dag_data(dag_data)
+			, file_path(file_path)
+			, dag_offset(dag_offset)
+			, install(install)
+			, verified(new ::std::atomic<bool>[this->checksums.chunks.size()])
+			, mutexes(new ::std::mutex[this->checksums.chunks.size()])
+			, repaired(0)
+			, verifying(false)
+			, cancelled(false)
+			, background()
+			{
+				for (size_t chunk = 0; chunk < this->checksums.chunks.size(); chunk++)
+				{
+					verified[chunk].store(false, ::std::memory_order_relaxed);
+				}
+			}
+
+			chunk_verifier_t(chunk_verifier_t const &) = delete;
+			chunk_verifier_t & operator=(chunk_verifier_t const &) = delete;
+
+			~chunk_verifier_t()
+			{
+				cancelled = true;
+				if (background.joinable())
+				{
+					background.join();
+				}
+			}
+
+			inline bool is_verified(uint32_t const index) const noexcept
+			{
+				return verified[index / dag_checksums_t::chunk_items].load(::std::memory_order_acquire);
+			}
+
+			/** \brief Test if the background verification started by verify_in_background() is still running.
+			*/
+			inline bool in_background() const noexcept
+			{
+				return verifying.load(::std::memory_order_acquire);
+			}
+
+			inline void ensure(uint32_t const index)
 			{
-				// TODO: write all value in little endian
-				fs.write(reinterpret_cast<char const *>(data), count);
-				if (fs.fail())
+				size_t const chunk = index / dag_checksums_t::chunk_items;
+				if (!verified[chunk].load(::std::memory_order_acquire))
 				{
-					throw hash_exception("Write failure");
+					verify_chunk(chunk);
 				}
-			};
-
-			write(constants::DAG_MAGIC_BYTES, sizeof(constants::DAG_MAGIC_BYTES));
-			write(&constants::MAJOR_VERSION, sizeof(constants::MAJOR_VERSION));
-			write(&constants::REVISION, sizeof(constants::REVISION));
-			write(&constants::MINOR_VERSION, sizeof(constants::MINOR_VERSION));
-			write(&epoch, sizeof(epoch));
-			write(&cache_begin, sizeof(cache_begin));
-			write(&cache_end, sizeof(cache_end));
-			write(&dag_begin, sizeof(dag_begin));
-			write(&dag_end, sizeof(dag_end));
+			}
 
-			size_t max_count = cache.size() + data.size();
-			size_t count = 0;
-			for (auto const & i : cache.data())
+			void verify_chunk(size_t const chunk)
 			{
-				for (auto const & j : i)
+				::std::lock_guard<::std::mutex> lock(mutexes[chunk]);
+				if (verified[chunk].load(::std::memory_order_relaxed))
 				{
-					write(&j, sizeof(j));
+					return;
 				}
-				if (((++count % constants::CALLBACK_FREQUENCY) == 0) && !callback(count, max_count, dag_saving))
+
+				if (!(dag_checksums_t::checksum_chunk(dag_data.view(), chunk) == checksums.chunks[chunk]))
 				{
-					throw hash_exception("DAG save cancelled.");
+					size_t const begin = chunk * dag_checksums_t::chunk_items;
+					size_t const end = (::std::min)(begin + dag_checksums_t::chunk_items, dag_data.size());
+					data_type items(end - begin);
+					calc_dataset_items(cache_data, static_cast<uint32_t>(begin), static_cast<uint32_t>(end), items[0]);
+					if (install)
+					{
+						install(begin, items[0], end - begin);
+					}
+					else
+					{
+						::std::memcpy(dag_data[begin], items[0], items.view().size_bytes());
+					}
+					write_back(chunk, items.view());
+					repaired++;
 				}
+				verified[chunk].store(true, ::std::memory_order_release);
 			}
 
-			for (auto const & i : data)
+			bool verify_all(unsigned int const thread_count, progress_callback_type callback)
 			{
-				for (auto const & j : i)
+				size_t const count = checksums.chunks.size();
+				auto const task = [this](size_t begin, size_t end)
 				{
-					write(&j, sizeof(j));
-				}
-				if (((++count % constants::CALLBACK_FREQUENCY) == 0) && !callback(count, max_count, dag_saving))
+					for (size_t chunk = begin; chunk < end; chunk++)
+					{
+						if (!verified[chunk].load(::std::memory_order_acquire))
+						{
+							verify_chunk(chunk);
+						}
+					}
+				};
+				auto const progress = [&callback, count](size_t done)
 				{
-					throw hash_exception("DAG save cancelled.");
-				}
+					return callback(done, count, dag_verification);
+				};
+				return parallel_for(count, 1, resolve_thread_count(thread_count), task, progress);
 			}
-		}
 
-		void generate(progress_callback_type callback)
-		{
-			uint32_t const n = size / constants::HASH_BYTES;
-			data.reserve(n);
-			for (uint32_t i = 0; i < n; i++)
+			/** \brief Verify all chunks on a background thread, which is stopped when the verifier is destroyed.
+			*/
+			void verify_in_background()
 			{
-				data.push_back(calc_dataset_item(cache.data(), i));
-				if ((i % constants::CALLBACK_FREQUENCY) == 0 && !callback(i, n, dag_generation))
+				verifying = true;
+				background = ::std::thread([this]()
 				{
-					throw hash_exception("DAG creation cancelled.");
-				}
+					try
+					{
+						verify_all(1, [this](size_t, size_t, int) { return !cancelled.load(); });
+					}
+					catch (...)
+					{
+						// chunks left unverified are verified on first use
+					}
+					verifying = false;
+				});
 			}
-		}
 
-		static data_type::value_type calc_dataset_item(::std::vector<sha3_512_t::deserialized_hash_t> const & cache, uint32_t const i)
-		{
-			uint32_t const n = cache.size();
-			constexpr uint32_t r = constants::HASH_BYTES / constants::WORD_BYTES;
-			sha3_512_t::deserialized_hash_t mix(cache[i%n]);
-			mix[0].hword ^= i;
-			mix = sha3_512(mix);
-			for (uint32_t j = 0; j < constants::DATASET_PARENTS; j++)
-			{
-				uint32_t const cache_index = fnv(i ^ j, mix[j % r].hword);
-				auto lBeg = cache[cache_index % n].begin();
-				auto lEnd = cache[cache_index % n].end();
-				for (auto k = mix.begin(), kEnd = mix.end();
-					((k != kEnd) && (lBeg != lEnd)); k++, lBeg++)
+			dag_checksums_t const checksums;
+			data_view_t const cache_data;
+			data_type & dag_data;
+			::std::string const file_path;
+			uint64_t const dag_offset;
+			install_function_type const install;
+			::std::unique_ptr<::std::atomic<bool>[]> verified;
+			::std::unique_ptr<::std::mutex[]> mutexes;
+			::std::atomic<size_t> repaired;
+
+			/** \brief Write regenerated items back to the file at offset, and their checksum at checksum_offset if it differs from table_checksum.
+			*
+			*	Only the corrupt section and its table entry are rewritten in place, with the bytes a correct file holds there.
+			*	This is best effort only, the data in memory is repaired whether or not the file can be written.
+			*/
+			static void write_back(::std::string const & file_path, uint64_t const offset, data_view_t const & items, uint64_t const checksum_offset, h256_t const & table_checksum)
+			{
+				using namespace std;
+
+				if (file_path.empty())
+				{
+					return;
+				}
+				fstream fs(file_path, ios::in | ios::out | ios::binary);
+				if (!fs.is_open())
 				{
-					k->hword = fnv(k->hword, lBeg->hword);
+					return;
 				}
+				fs.seekp(static_cast<streamoff>(offset));
+				fs.write(reinterpret_cast<char const *>(items.data()), items.size_bytes());
 
+				h256_t const checksum = dag_checksums_t::checksum(items);
+				if (!(checksum == table_checksum))
+				{
+					fs.seekp(static_cast<streamoff>(checksum_offset));
+					fs.write(reinterpret_cast<char const *>(&checksum.b[0]), h256_t::hash_size);
+				}
 			}
-			return sha3_512(mix);
-		}
 
-		cache_t get_cache() const
-		{
-			return cache;
-		}
+			/** \brief The offset of the table entry of the cache checksum, or of a chunk checksum, in a file in which the DAG of dag_size bytes starts at dag_offset.
+			*
+			*	The table follows the DAG: chunk size, chunk count, the cache checksum and the chunk checksums.
+			*/
+			static uint64_t checksum_offset(uint64_t const dag_offset, uint64_t const dag_size, size_t const entry)
+			{
+				return dag_offset + dag_size + (2 * sizeof(uint64_t)) + (entry * h256_t::hash_size);
+			}
 
-		static size_type get_full_size(uint64_t const block_number) noexcept
-		{
-			using namespace constants;
+		private:
+			/** \brief Write a regenerated chunk, and its checksum if the table entry was wrong, back to the file.
+			*/
+			void write_back(size_t const chunk, data_view_t const & items) const
+			{
+				uint64_t const dag_size = dag_data.view().size_bytes();
+				write_back(file_path, dag_offset + (chunk * constants::DAG_CHUNK_BYTES), items, checksum_offset(dag_offset, dag_size, 1 + chunk), checksums.chunks[chunk]);
+			}
 
-			uint64_t full_size = (DATASET_BYTES_INIT + (DATASET_BYTES_GROWTH * (block_number / EPOCH_LENGTH))) - MIX_BYTES;
-			while (!is_prime(full_size / MIX_BYTES))
+			::std::atomic<bool> verifying;
+			::std::atomic<bool> cancelled;
+			::std::thread background;
+		};
+
+		/** \brief Check the cache against its checksum, regenerate it if it is corrupt, and prepare verification of the DAG chunks.
+		*
+		*	Regenerated chunks are put in place by install, or copied into the DAG if install is empty.
+		*	A regenerated cache and regenerated chunks are written back to the file at file_path, in which the DAG starts at dag_offset.
+		*/
+		void attach_checksums(dag_checksums_t && checksums, ::std::string const & file_path, uint64_t const dag_offset, chunk_verifier_t::install_function_type install, progress_callback_type callback)
+		{
+			if (!(dag_checksums_t::checksum(cache.data()) == checksums.cache))
 			{
-				full_size -= (2 * MIX_BYTES);
+				cache = cache_t(epoch * get_sizing().epoch_length, callback);
+
+				// the cache immediately precedes the DAG, it is only written back if the regenerated one fits in its place
+				data_view_t const cache_data = cache.data();
+				uint64_t const cache_size = cache_data.size_bytes();
+				if ((constants::DAG_FILE_HEADER_SIZE + cache_size) == dag_offset)
+				{
+					chunk_verifier_t::write_back(file_path, constants::DAG_FILE_HEADER_SIZE, cache_data, chunk_verifier_t::checksum_offset(dag_offset, data.view().size_bytes(), 0), checksums.cache);
+				}
 			}
-			return full_size;
+			verifier.reset(new chunk_verifier_t(::std::move(checksums), cache.data(), data, file_path, dag_offset, install));
 		}
 
 		uint64_t epoch;
 		size_type size;
 		cache_t cache;
 		data_type data;
+		::std::unique_ptr<chunk_verifier_t> verifier;
 	};
 
 	// construct on first use mutex ensures safe static initialization order
@@ -834,19 +2611,20 @@ namespace egihash
 	std::recursive_mutex & dag_cache_mutex = get_dag_cache_mutex();
 
 	// construct on first use dag_cache_map ensures safe static initialization order
+	// DAGs are registered per sizing, the DAG cache of the current sizing is returned
 	dag_t::impl_t::dag_cache_map & get_dag_cache()
 	{
 		std::lock_guard<std::recursive_mutex> lock(get_dag_cache_mutex());
-		static dag_t::impl_t::dag_cache_map dag_cache;
-		return dag_cache;
+		static ::std::map<sizing_t, dag_t::impl_t::dag_cache_map> dag_caches;
+		return dag_caches[get_sizing()];
 	}
 	// ensures single threaded construction
 	dag_t::impl_t::dag_cache_map & dag_cache = get_dag_cache();
 
-	::std::shared_ptr<dag_t::impl_t> get_dag(uint64_t block_number, progress_callback_type callback)
+	::std::shared_ptr<dag_t::impl_t> get_dag(uint64_t block_number, progress_callback_type callback, unsigned int thread_count)
 	{
 		using namespace std;
-		uint64_t epoch_number = block_number / constants::EPOCH_LENGTH;
+		uint64_t epoch_number = get_epoch(block_number);
 
 		// if we have the correct DAG already loaded, return it from the cache
 		{
@@ -860,7 +2638,7 @@ namespace egihash
 
 		// otherwise create the dag and add it to the cache
 		// this is not locked as it can be a lengthy process and we don't want to block access to the dag cache
-		shared_ptr<dag_t::impl_t> impl(new dag_t::impl_t(block_number, callback));
+		shared_ptr<dag_t::impl_t> impl(new dag_t::impl_t(block_number, callback, thread_count));
 
 		lock_guard<recursive_mutex> lock(get_dag_cache_mutex());
 		auto insert_pair = get_dag_cache().insert(make_pair(epoch_number, impl));
@@ -882,7 +2660,64 @@ namespace egihash
 		throw hash_exception("Could not get DAG");
 	}
 
-	::std::shared_ptr<dag_t::impl_t> get_dag(::std::string const & file_path, progress_callback_type callback)
+	::std::shared_ptr<dag_t::impl_t> add_to_dag_cache(uint64_t const epoch_number, ::std::shared_ptr<dag_t::impl_t> const & impl);
+
+	::std::shared_ptr<dag_t::impl_t> get_dag(uint64_t block_number, ::std::string const & file_path, progress_callback_type callback, unsigned int thread_count, unsigned int write_flags)
+	{
+		using namespace std;
+		uint64_t epoch_number = get_epoch(block_number);
+
+		// if we have the correct DAG already loaded, only save it
+		shared_ptr<dag_t::impl_t> loaded;
+		{
+			lock_guard<recursive_mutex> lock(get_dag_cache_mutex());
+			auto const dag_cache_iterator = get_dag_cache().find(epoch_number);
+			if (dag_cache_iterator != get_dag_cache().end())
+			{
+				loaded = dag_cache_iterator->second;
+			}
+		}
+		if (loaded)
+		{
+			loaded->save(file_path, callback, write_flags);
+			return loaded;
+		}
+
+		// otherwise create the dag while writing it and add it to the cache
+		shared_ptr<dag_t::impl_t> impl(new dag_t::impl_t(block_number, file_path, callback, thread_count, write_flags));
+		return add_to_dag_cache(epoch_number, impl);
+	}
+
+	::std::shared_ptr<dag_t::impl_t> add_to_dag_cache(uint64_t const epoch_number, ::std::shared_ptr<dag_t::impl_t> const & impl)
+	{
+		using namespace std;
+		lock_guard<recursive_mutex> lock(get_dag_cache_mutex());
+		auto insert_pair = get_dag_cache().insert(make_pair(epoch_number, impl));
+
+		// if insert succeded, return the dag
+		if (insert_pair.second)
+		{
+			return insert_pair.first->second;
+		}
+
+		// if insert failed, it's probably already been inserted
+		auto const dag_cache_iterator = get_dag_cache().find(epoch_number);
+		if (dag_cache_iterator != get_dag_cache().end())
+		{
+			return dag_cache_iterator->second;
+		}
+
+		// we couldn't insert it and it's not in the cache
+		throw hash_exception("Could not get DAG");
+	}
+
+	// no DAG file is smaller than the file of epoch 0 with the current sizing
+	uint64_t dag_file_minimum_size() noexcept
+	{
+		return constants::DAG_FILE_HEADER_SIZE + cache_t::get_cache_size(0) + dag_t::get_full_size(0);
+	}
+
+	::std::shared_ptr<dag_t::impl_t> read_dag(::std::string const & file_path, progress_callback_type callback)
 	{
 		using namespace std;
 		using size_type = dag_t::size_type;
@@ -892,7 +2727,7 @@ namespace egihash
 
 		if (fs.fail())
 		{
-			throw hash_exception("Could not open DAG file.");
+			throw hash_exception("Could not open file.");
 		}
 
 		fs.seekg(0, ios::end);
@@ -900,13 +2735,13 @@ namespace egihash
 		fs.seekg(0, ios::beg);
 
 		// check minimum dag size
-		if (filesize < constants::DAG_FILE_MINIMUM_SIZE)
+		if (filesize < dag_file_minimum_size())
 		{
 			throw hash_exception("DAG is corrupt");
 		}
 
 		// data for 64MiB reads
-		// 64MiB was chosen as it is divisible by the constants::CACHE_BYTES_GROWTH and the constants::DATASET_BYTES_GROWTH
+		// 64MiB was chosen as it is divisible by the default cache and dataset growth
 		vector<char> read_buffer(64 * 1024 * 1024, 0);
 		auto buffer_ptr = &read_buffer[0];
 		auto buffer_ptr_end = &read_buffer.back() + 1;
@@ -969,37 +2804,150 @@ namespace egihash
 			}
 		}
 
+		size_type const dag_size = header.dag_end - header.dag_begin;
+		size_type const table_offset = constants::DAG_FILE_HEADER_SIZE + (header.cache_end - header.cache_begin) + dag_size;
+		if ((header.minor_version >= 1) && ((table_offset + dag_checksums_t::table_size(dag_size)) > filesize))
+		{
+			throw hash_exception("DAG checksums are corrupt");
+		}
+
 		// otherwise create the dag and add it to the cache
 		// this is not locked as it can be a lengthy process and we don't want to block access to the dag cache
 		shared_ptr<dag_t::impl_t> impl(new dag_t::impl_t(read, header, callback));
 
-		lock_guard<recursive_mutex> lock(get_dag_cache_mutex());
-		auto insert_pair = get_dag_cache().insert(make_pair(header.epoch, impl));
+		// the copy is verified completely before it is used, the checksum table follows the DAG
+		if (header.minor_version >= 1)
+		{
+			dag_checksums_t checksums;
+			checksums.read(read, dag_size);
+			size_type const dag_offset = constants::DAG_FILE_HEADER_SIZE + (header.cache_end - header.cache_begin);
+			impl->attach_checksums(move(checksums), file_path, dag_offset, nullptr, callback);
+			if (!impl->verifier->verify_all(0, callback))
+			{
+				throw hash_exception("DAG verification cancelled.");
+			}
+		}
+		return add_to_dag_cache(header.epoch, impl);
+	}
 
-		// if insert succeded, return the dag
-		if (insert_pair.second)
+#ifndef WIN32
+	::std::shared_ptr<dag_t::impl_t> map_dag(::std::string const & file_path, progress_callback_type callback)
+	{
+		using namespace std;
+		using size_type = dag_t::size_type;
+
+		// the mapping is read-only, corrupt chunks are regenerated into a private copy of their pages
+		auto const mapping = make_shared<mapped_file_t>(file_path);
+		size_type const filesize = mapping->size();
+
+		// check minimum dag size
+		if (filesize < dag_file_minimum_size())
 		{
-			return insert_pair.first->second;
+			throw hash_exception("DAG is corrupt");
 		}
 
-		// if insert failed, it's probably already been inserted
-		auto const dag_cache_iterator = get_dag_cache().find(header.epoch);
-		if (dag_cache_iterator != get_dag_cache().end())
+		size_type offset = 0;
+		auto read = [&mapping, &offset](void * dst, size_type count)
 		{
-			return dag_cache_iterator->second;
+			if (count > (mapping->size() - offset))
+			{
+				throw hash_exception("Read failure");
+			}
+			::std::memcpy(dst, mapping->data() + offset, count);
+			offset += count;
+		};
+
+		dag_file_header_t header(read);
+
+		// the cache and the DAG immediately follow the header, as written by dag_t::impl_t::save
+		size_type const cache_offset = constants::DAG_FILE_HEADER_SIZE;
+		size_type const cache_size = header.cache_end - header.cache_begin;
+		size_type const dag_offset = cache_offset + cache_size;
+		size_type const dag_size = header.dag_end - header.dag_begin;
+		if ((header.cache_end >= filesize) || (header.dag_end > (filesize + 1)) || ((dag_offset + dag_size) > filesize))
+		{
+			throw hash_exception("DAG is corrupt");
+		}
+		if ((header.minor_version >= 1) && ((dag_offset + dag_size + dag_checksums_t::table_size(dag_size)) > filesize))
+		{
+			throw hash_exception("DAG checksums are corrupt");
 		}
 
-		// we couldn't insert it and it's not in the cache
-		throw hash_exception("Could not get DAG");
+		// if we have the correct DAG already loaded, return it from the cache
+		{
+			lock_guard<recursive_mutex> lock(get_dag_cache_mutex());
+			auto const dag_cache_iterator = get_dag_cache().find(header.epoch);
+			if (dag_cache_iterator != get_dag_cache().end())
+			{
+				return dag_cache_iterator->second;
+			}
+		}
+
+		// the whole cache is needed to compute light hashes, whereas DAG pages are accessed randomly
+		mapping->advise(cache_offset, cache_size, MADV_WILLNEED);
+		mapping->advise(dag_offset, dag_size, MADV_RANDOM);
+
+		// the buffers share ownership of the mapping, it is unmapped once both are released
+		uint8_t * const base = const_cast<uint8_t *>(mapping->data());
+		size_type const cache_items = cache_size / constants::HASH_BYTES;
+		size_type const dag_items = dag_size / constants::HASH_BYTES;
+		item_buffer_t cache_data(reinterpret_cast<node *>(base + cache_offset), cache_items, [mapping]() {});
+		item_buffer_t dag_data(reinterpret_cast<node *>(base + dag_offset), dag_items, [mapping]() {});
+
+		if (!callback(cache_items, cache_items, cache_loading))
+		{
+			throw hash_exception("Cache loading cancelled.");
+		}
+
+		shared_ptr<dag_t::impl_t> impl(new dag_t::impl_t(header, move(cache_data), move(dag_data)));
+
+		// the cache is verified now, DAG chunks on a background thread, see hashimoto::full_lookup_t
+		if (header.minor_version >= 1)
+		{
+			offset = dag_offset + dag_size;
+			dag_checksums_t checksums;
+			checksums.read(read, dag_size);
+			auto const install = [mapping, dag_offset](size_t first_item, node const * items, size_t count)
+			{
+				mapping->write(dag_offset + (first_item * constants::HASH_BYTES), items, count * constants::HASH_BYTES);
+			};
+			impl->attach_checksums(move(checksums), file_path, dag_offset, install, callback);
+			impl->verifier->verify_in_background();
+		}
+
+		if (!callback(dag_items, dag_items, dag_loading))
+		{
+			throw hash_exception("DAG loading cancelled.");
+		}
+
+		return add_to_dag_cache(header.epoch, impl);
+	}
+#endif // WIN32
+
+	::std::shared_ptr<dag_t::impl_t> get_dag(::std::string const & file_path, progress_callback_type callback, dag_load_mode mode)
+	{
+#ifndef WIN32
+		if (mode == dag_load_mmap)
+		{
+			return map_dag(file_path, callback);
+		}
+#endif // WIN32
+		// memory mapping is unavailable on this platform, fall back to reading the file
+		return read_dag(file_path, callback);
 	}
 
-	dag_t::dag_t(uint64_t block_number, progress_callback_type callback)
-	: impl(get_dag(block_number, callback))
+	dag_t::dag_t(uint64_t block_number, progress_callback_type callback, unsigned int thread_count)
+	: impl(get_dag(block_number, callback, thread_count))
 	{
 	}
 
-	dag_t::dag_t(::std::string const & file_path, progress_callback_type callback)
-	: impl(get_dag(file_path, callback))
+	dag_t::dag_t(uint64_t block_number, ::std::string const & file_path, progress_callback_type callback, unsigned int thread_count, unsigned int write_flags)
+	: impl(get_dag(block_number, file_path, callback, thread_count, write_flags))
+	{
+	}
+
+	dag_t::dag_t(::std::string const & file_path, progress_callback_type callback, dag_load_mode mode)
+	: impl(get_dag(file_path, callback, mode))
 	{
 
 	}
@@ -1014,14 +2962,14 @@ namespace egihash
 		return impl->size;
 	}
 
-	dag_t::data_type const & dag_t::data() const
+	dag_t::data_type dag_t::data() const
 	{
-		return impl->data;
+		return impl->data.view();
 	}
 
-	void dag_t::save(::std::string const & file_path, progress_callback_type callback) const
+	void dag_t::save(::std::string const & file_path, progress_callback_type callback, unsigned int write_flags) const
 	{
-		impl->save(file_path, callback);
+		impl->save(file_path, callback, write_flags);
 	}
 
 	cache_t dag_t::get_cache() const
@@ -1029,12 +2977,32 @@ namespace egihash
 		return impl->get_cache();
 	}
 
+	dag_t::size_type dag_t::verify(unsigned int thread_count, progress_callback_type callback) const
+	{
+		if (!impl->verifier)
+		{
+			return 0;
+		}
+
+		if (!impl->verifier->verify_all(thread_count, callback))
+		{
+			throw hash_exception("DAG verification cancelled.");
+		}
+		return impl->verifier->repaired.load();
+	}
+
 	void dag_t::unload() const
 	{
-		auto const i = get_dag_cache().erase(epoch());
-		if (i == 0)
 		{
-			throw hash_exception("Can not unload DAG - not loaded.");
+			::std::lock_guard<::std::recursive_mutex> lock(get_dag_cache_mutex());
+			auto & dag_cache = get_dag_cache();
+			auto const dag_cache_iterator = dag_cache.find(epoch());
+			// only this DAG is unregistered, never another one loaded for the same epoch in the meantime
+			if ((dag_cache_iterator == dag_cache.end()) || (dag_cache_iterator->second != impl))
+			{
+				throw hash_exception("Can not unload DAG - not loaded.");
+			}
+			dag_cache.erase(dag_cache_iterator);
 		}
 		get_cache().unload();
 	}
@@ -1066,6 +3034,60 @@ namespace egihash
 		return loaded_epochs;
 	}
 
+	void dag_t::set_memory_policy(dag_page_mode const pages, dag_numa_mode const numa, unsigned int const numa_node)
+	{
+		::std::lock_guard<::std::mutex> lock(get_dag_memory_policy_mutex());
+		auto & policy = get_dag_memory_policy();
+		policy.pages = pages;
+		policy.numa = numa;
+		policy.numa_node = numa_node;
+	}
+
+	::std::shared_ptr<void> allocate_dag_memory(::std::size_t bytes)
+	{
+		dag_memory_policy_t policy;
+		{
+			::std::lock_guard<::std::mutex> lock(get_dag_memory_policy_mutex());
+			policy = get_dag_memory_policy();
+		}
+
+#ifdef __linux__
+		if ((policy.pages != dag_pages_default) || (policy.numa != dag_numa_default))
+		{
+			void * address = MAP_FAILED;
+			size_t length = 0;
+			if (policy.pages == dag_pages_huge)
+			{
+				length = ((bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE) * HUGE_PAGE_SIZE;
+				address = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+			}
+			// not enough reserved huge pages, fall back to transparent huge pages
+			if (address == MAP_FAILED)
+			{
+				length = bytes;
+				address = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#ifdef MADV_HUGEPAGE
+				if ((address != MAP_FAILED) && (policy.pages != dag_pages_default))
+				{
+					::madvise(address, length, MADV_HUGEPAGE);
+				}
+#endif // MADV_HUGEPAGE
+			}
+			if (address != MAP_FAILED)
+			{
+				apply_numa_policy(address, length, policy);
+				return ::std::shared_ptr<void>(address, [length](void * p) { ::munmap(p, length); });
+			}
+		}
+#endif // __linux__
+
+		void * const allocation = ::operator new(bytes + constants::DATA_ALIGNMENT);
+		uintptr_t const address = reinterpret_cast<uintptr_t>(allocation);
+		uintptr_t const aligned = (address + constants::DATA_ALIGNMENT - 1) & ~static_cast<uintptr_t>(constants::DATA_ALIGNMENT - 1);
+		::std::shared_ptr<void> const owner(allocation, [](void * p) { ::operator delete(p); });
+		return ::std::shared_ptr<void>(owner, reinterpret_cast<void *>(aligned));
+	}
+
 // TODO: reference code, remove me
 #if 0
 	// TODO: unit tests / validation
@@ -1136,68 +3158,194 @@ namespace egihash
 	}
 #endif // 0
 
-	// TODO: unify light & full implementation
 	namespace hashimoto
 	{
-		using mediator_get_dag_size = std::function<dag_t::size_type ()>;
-		using mediator_get_dag_item = std::function<std::vector<node> const (uint32_t index)>;
+		/** \brief full_lookup_t reads DAG items directly from a fully generated or loaded DAG.
+		*
+		*	Items of chunks of a mapped DAG which were not verified yet are computed from the cache while the background
+		*	verification runs, rather than waiting for their chunk to be verified.
+		*/
+		struct full_lookup_t
+		{
+			explicit full_lookup_t(dag_t const & dag)
+			: data(dag.data())
+			, full_size(dag.size())
+			, verifier(dag.impl->verifier.get())
+			{
+			}
+
+			inline node const * operator()(uint32_t const index, node * scratch) const
+			{
+				if (verifier && !verifier->is_verified(index))
+				{
+					if (verifier->in_background())
+					{
+						dag_t::impl_t::calc_dataset_item(verifier->cache_data, index, scratch);
+						return scratch;
+					}
+					verifier->ensure(index);
+				}
+				return data[index];
+			}
+
+			data_view_t const data;
+			dag_t::size_type const full_size;
+			dag_t::impl_t::chunk_verifier_t * const verifier;
+		};
 
-		result_t hash(void const * input_data, dag_t::size_type input_size, mediator_get_dag_size get_dag_size, mediator_get_dag_item get_dag_item)
+		/** \brief light_lookup_t computes DAG items on demand from the cache.
+		*/
+		struct light_lookup_t
 		{
-			static constexpr auto w = constants::MIX_BYTES / constants::WORD_BYTES;
-			auto MIXNODES = (constants::MIX_BYTES / constants::HASH_BYTES);
+			explicit light_lookup_t(cache_t const & cache)
+			: data(cache.data())
+			, full_size(dag_t::get_full_size(cache.epoch() * get_sizing().epoch_length))
+			{
+			}
+
+			inline node const * operator()(uint32_t const index, node * scratch) const
+			{
+				dag_t::impl_t::calc_dataset_item(data, index, scratch);
+				return scratch;
+			}
+
+			data_view_t const data;
+			dag_t::size_type const full_size;
+		};
 
-			auto s = sha3_512(std::string(static_cast<const char*>(input_data), input_size));
-			decltype(s) mix;
+		/** \brief Compute an egihash from its seed, the Keccak-512 hash of the input, using LookupType to fetch DAG items.
+		*
+		*	LookupType is a static policy, so the lookup is inlined into the access loop.
+		*	All intermediate state lives in fixed-size arrays on the stack, no heap allocations are made.
+		*/
+		template <typename LookupType>
+		result_t hash_seed(node const * seed, LookupType const & lookup)
+		{
+			static constexpr uint32_t w = constants::MIX_BYTES / constants::WORD_BYTES;
+			static constexpr uint32_t MIXNODES = constants::MIX_BYTES / constants::HASH_BYTES;
+			static constexpr uint32_t CMIX_WORDS = w / 4;
+			static_assert((w % constants::HASH_WORDS) == 0, "Mix must consist of whole DAG items");
+
+			// s is followed by the compressed mix so both can be hashed together for the result
+			node s_cmix[constants::HASH_WORDS + CMIX_WORDS];
+			node * const s = s_cmix;
+			node * const cmix = s_cmix + constants::HASH_WORDS;
+			::std::memcpy(s, seed, constants::HASH_BYTES);
+
+			node mix[w];
 			for (uint32_t i = 0; i < MIXNODES; i++)
 			{
-				mix.insert(mix.end(), s.begin(), s.end());
+				::std::memcpy(&mix[i * constants::HASH_WORDS], s, constants::HASH_BYTES);
 			}
 
-			uint32_t const full_page_count = (uint32_t) ( get_dag_size() / constants::MIX_BYTES );
+			node scratch[constants::HASH_WORDS];
+			fnv_kernels::mix_item_function_type const mix_item = fnv_kernels::active_kernels().mix_item;
+			uint32_t const full_page_count = static_cast<uint32_t>(lookup.full_size / constants::MIX_BYTES);
 			for (uint32_t i = 0; i < constants::ACCESSES; i++)
 			{
-				auto p = fnv(i ^ s[0].hword, mix[i % w].hword) % full_page_count;
+				uint32_t const p = fnv(i ^ s[0].hword, mix[i % w].hword) % full_page_count;
 				for (uint32_t j = 0; j < MIXNODES; j++)
 				{
-					auto h = get_dag_item(p * MIXNODES + j);
-					auto k = h.begin(), kEnd = h.end();
-					for (auto m = mix.begin() + j * w / 2, mEnd = mix.begin() + ( j + 1 ) * w / 2; m != mEnd && k != kEnd; m++, k++)
-					{
-						m->hword = fnv(m->hword, k->hword);
-					}
+					mix_item(&mix[j * constants::HASH_WORDS], lookup((p * MIXNODES) + j, scratch));
 				}
 			}
 
-			decltype(s) cmix;
-			for (uint32_t i = 0; i < mix.size(); i += 4)
+			for (uint32_t i = 0; i < w; i += 4)
 			{
-				cmix.push_back(node(fnv(fnv(fnv(mix[i].hword, mix[i+1].hword), mix[i+2].hword), mix[i+3].hword)));
+				cmix[i / 4].hword = fnv(fnv(fnv(mix[i].hword, mix[i + 1].hword), mix[i + 2].hword), mix[i + 3].hword);
 			}
 
-			auto combined = std::move(s);
-			combined.insert(combined.end(), cmix.begin(), cmix.end());
-			auto v = sha3_256(combined);
 			result_t out;
-			::std::memcpy(&out.value.b[0], &v[0], ::std::min(sizeof(out.value.b), v.size() * sizeof(node)));
-			::std::memcpy(&out.mixhash.b[0], &cmix[0], ::std::min(sizeof(out.mixhash.b), cmix.size() * sizeof(node)));
+			if (::sha3_256(&out.value.b[0], sizeof(out.value.b), reinterpret_cast<uint8_t const *>(s_cmix), sizeof(s_cmix)) != 0)
+			{
+				throw hash_exception("Keccak-256 computation failed.");
+			}
+			::std::memcpy(&out.mixhash.b[0], cmix, sizeof(out.mixhash.b));
 			return out;
 		}
+
+		/** \brief Compute an egihash using LookupType to fetch DAG items.
+		*/
+		template <typename LookupType>
+		result_t hash(void const * input_data, ::std::size_t const input_size, LookupType const & lookup)
+		{
+			node seed[constants::HASH_WORDS];
+			sha3_512_item(seed, input_data, input_size);
+			return hash_seed(seed, lookup);
+		}
+
+		/** \brief Compute an egihash of a header hash and a nonce using LookupType to fetch DAG items.
+		*/
+		template <typename LookupType>
+		result_t hash(h256_t const & header_hash, uint64_t const nonce, LookupType const & lookup)
+		{
+			// combine header_hash with nonce
+			uint8_t bytes[sizeof(header_hash.b) + sizeof(nonce)];
+			::std::memcpy(bytes, &header_hash.b[0], sizeof(header_hash.b));
+			::std::memcpy(bytes + sizeof(header_hash.b), &nonce, sizeof(nonce));
+			return hash(bytes, sizeof(bytes), lookup);
+		}
+
+		/** \brief Search nonces in [start_nonce, start_nonce + count) for the first egihash not above target, using LookupType to fetch DAG items.
+		*
+		*	The seeds of four consecutive nonces are computed together with the multi-buffer Keccak-512.
+		*/
+		template <typename LookupType>
+		bool search(h256_t const & header_hash, uint64_t const start_nonce, uint64_t const count, h256_t const & target, LookupType const & lookup, uint64_t & nonce, result_t & result)
+		{
+			static constexpr size_t INPUT_WORDS = (sizeof(header_hash.b) + sizeof(nonce)) / constants::WORD_BYTES;
+			static_assert((INPUT_WORDS * constants::WORD_BYTES) == (sizeof(header_hash.b) + sizeof(nonce)), "Input must consist of whole words");
+
+			// the header hash is laid out once, only the nonce words change per round
+			node input[4][INPUT_WORDS];
+			node seed[4][constants::HASH_WORDS];
+			node const * const inputs[4] = { input[0], input[1], input[2], input[3] };
+			node * const seeds[4] = { seed[0], seed[1], seed[2], seed[3] };
+			for (auto & in : input)
+			{
+				::std::memcpy(in, &header_hash.b[0], sizeof(header_hash.b));
+			}
+
+			for (uint64_t done = 0; done < count; done += 4)
+			{
+				for (int k = 0; k < 4; k++)
+				{
+					uint64_t const n = start_nonce + done + k;
+					::std::memcpy(reinterpret_cast<uint8_t *>(input[k]) + sizeof(header_hash.b), &n, sizeof(n));
+				}
+				sha3_512_items_x4(seeds, inputs, sizeof(input[0]));
+
+				for (uint64_t k = 0; k < 4 && (done + k) < count; k++)
+				{
+					result_t const r = hash_seed(seed[k], lookup);
+					// hashes compare as big endian numbers, as arith_uint256 does after conversion to uint256
+					if (::std::memcmp(&r.value.b[0], &target.b[0], sizeof(target.b)) <= 0)
+					{
+						nonce = start_nonce + done + k;
+						result = r;
+						return true;
+					}
+				}
+			}
+			return false;
+		}
 	}
+
 	namespace full
 	{
-
-
 		result_t hash(dag_t const & dag, void const * input_data, dag_t::size_type input_size)
 		{
-			return hashimoto::hash(input_data, input_size
-					, [&]() -> dag_t::size_type { return dag.size(); }
-					, [&](uint32_t index) -> std::vector<node> const { return dag.data()[index]; });
+			return hashimoto::hash(input_data, input_size, hashimoto::full_lookup_t(dag));
 		}
+
 		result_t hash(dag_t const & dag, h256_t const & header_hash, uint64_t const nonce)
 		{
-			std::function<result_t (dag_t const &, void const *, dag_t::size_type)> hash_func = static_cast<result_t (*)(dag_t const &, void const *, dag_t::size_type)>(&hash);
-			return hash_header_nonce(hash_func, dag, header_hash, nonce);
+			return hashimoto::hash(header_hash, nonce, hashimoto::full_lookup_t(dag));
+		}
+
+		bool search(dag_t const & dag, h256_t const & header_hash, uint64_t const start_nonce, uint64_t const count, h256_t const & target, uint64_t & nonce, result_t & result)
+		{
+			return hashimoto::search(header_hash, start_nonce, count, target, hashimoto::full_lookup_t(dag), nonce, result);
 		}
 	}
 
@@ -1205,15 +3353,17 @@ namespace egihash
 	{
 		result_t hash(cache_t const & cache, void const * input_data, cache_t::size_type input_size)
 		{
-			return hashimoto::hash(input_data, input_size
-					, [&]() -> dag_t::size_type { return dag_t::get_full_size((cache.epoch() * constants::EPOCH_LENGTH)); }
-					, [&](uint32_t index) -> std::vector<node> const { return dag_t::impl_t::calc_dataset_item(cache.data(), index); });
+			return hashimoto::hash(input_data, input_size, hashimoto::light_lookup_t(cache));
 		}
 
 		result_t hash(cache_t const & cache, h256_t const & header_hash, uint64_t const nonce)
 		{
-			std::function<result_t (cache_t const &, void const *, cache_t::size_type)> hash_func = static_cast<result_t (*)(cache_t const &, void const *, cache_t::size_type)>(&hash);
-			return hash_header_nonce(hash_func, cache, header_hash, nonce);
+			return hashimoto::hash(header_hash, nonce, hashimoto::light_lookup_t(cache));
+		}
+
+		bool search(cache_t const & cache, h256_t const & header_hash, uint64_t const start_nonce, uint64_t const count, h256_t const & target, uint64_t & nonce, result_t & result)
+		{
+			return hashimoto::search(header_hash, start_nonce, count, target, hashimoto::light_lookup_t(cache), nonce, result);
 		}
 	}
 
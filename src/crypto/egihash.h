@@ -25,11 +25,29 @@ namespace egihash
 		*/
 		static constexpr char DAG_MAGIC_BYTES[] = "NRGHASH_DAG";
 
+		/** \brief CACHE_MAGIC_BYTES is the starting sequence of a cache file, used for identification.
+		*/
+		static constexpr char CACHE_MAGIC_BYTES[] = "NRGHASH_CACHE";
+
+		/** \brief SEEDHASH_MAGIC_BYTES is the starting sequence of a seedhash table file, used for identification.
+		*/
+		static constexpr char SEEDHASH_MAGIC_BYTES[] = "NRGHASH_SEED";
+
+		/** \brief SEEDHASH_TABLE_MAX_EPOCHS is the maximum number of seedhashes kept in the in-memory seedhash table.
+		*
+		*	Seedhashes for later epochs are still computed, but they are derived from the last stored seedhash each time.
+		*/
+		static constexpr uint64_t SEEDHASH_TABLE_MAX_EPOCHS = 1u << 16u;
+
 		/** \brief DAG_FILE_HEADER_SIZE is the expected size of a DAG file header.
 		*/
 		static constexpr uint32_t DAG_FILE_HEADER_SIZE = 64u;
 
-		/** \brief DAG_FILE_MINIMUM_SIZE is the size of the DAG file at epoch 0.
+		/** \brief CACHE_FILE_HEADER_SIZE is the size of a cache file header, the cache items start at this offset.
+		*/
+		static constexpr uint32_t CACHE_FILE_HEADER_SIZE = 128u;
+
+		/** \brief DAG_FILE_MINIMUM_SIZE is the size of the DAG file at epoch 0 with the default sizing_t.
 		*/
 		static constexpr uint64_t DAG_FILE_MINIMUM_SIZE = 2641099136;
 
@@ -48,26 +66,36 @@ namespace egihash
 		static constexpr uint32_t REVISION = 23u;
 
 		/** \brief The minor version number of egihash
+		*
+		*	DAG files of minor version 1 and later end with a table of chunk checksums, see DAG_CHUNK_BYTES.
 		*/
-		static constexpr uint32_t MINOR_VERSION = 0u;
+		static constexpr uint32_t MINOR_VERSION = 1u;
+
+		/** \brief DAG_CHUNK_BYTES is the size of the DAG chunks which are checksummed, verified and regenerated independently.
+		*/
+		static constexpr uint64_t DAG_CHUNK_BYTES = 16u * 1024u * 1024u;
 
 		/** \brief Number of bytes in a hash word.
 		*/
 		static constexpr uint32_t WORD_BYTES = 4u;
 
-		/** \brief The growth of the dataset in bytes per epoch.
+		/** \brief Alignment in bytes of the contiguous cache and DAG storage (one cache line).
+		*/
+		static constexpr uint32_t DATA_ALIGNMENT = 64u;
+
+		/** \brief The growth of the dataset in bytes per epoch, the default of sizing_t::dataset_bytes_growth.
 		*/
 		static constexpr uint32_t DATASET_BYTES_GROWTH = 1u << 23u;
 
-		/** \brief The number of bytes in the dataset at genesis.
+		/** \brief The number of bytes in the dataset at genesis, the default of sizing_t::dataset_bytes_init.
 		*/
 		static constexpr uint32_t DATASET_BYTES_INIT = (1u << 30u) + (DATASET_BYTES_GROWTH * 182);
 
-		/** \brief The growth of the cache in bytes per epoch.
+		/** \brief The growth of the cache in bytes per epoch, the default of sizing_t::cache_bytes_growth.
 		*/
 		static constexpr uint32_t CACHE_BYTES_GROWTH = 1u << 17u;
 
-		/** \brief The number of bytes in the cache at genesis.
+		/** \brief The number of bytes in the cache at genesis, the default of sizing_t::cache_bytes_init.
 		*/
 		static constexpr uint32_t CACHE_BYTES_INIT = (1u << 24u) + (CACHE_BYTES_GROWTH * 182);
 
@@ -75,7 +103,7 @@ namespace egihash
 		*/
 		static constexpr uint32_t CACHE_MULTIPLIER=1024u;
 
-		/** \brief The number of blocks which constitute one epoch.
+		/** \brief The number of blocks which constitute one epoch, the default of sizing_t::epoch_length.
 		*
 		*	The DAG and cache must be regenerated once per epoch. (approximately 120 hours)
 		*/
@@ -89,6 +117,10 @@ namespace egihash
 		*/
 		static constexpr uint32_t HASH_BYTES = 64u;
 
+		/** \brief The number of hash words in a single cache or DAG item.
+		*/
+		static constexpr uint32_t HASH_WORDS = HASH_BYTES / WORD_BYTES;
+
 		/** \brief The number of parents for each element in the DAG.
 		*/
 		static constexpr uint32_t DATASET_PARENTS = 256u;
@@ -102,6 +134,64 @@ namespace egihash
 		static constexpr uint32_t ACCESSES = 64u;
 	}
 
+	/** \brief sizing_t holds the parameters which determine the length of an epoch and the sizes of its cache and DAG.
+	*
+	*	The defaults are the values of constants. A network may use other values, e.g. a regression test network
+	*	with a cache and DAG of a few MiB, so full DAG code paths can be exercised in seconds.
+	*	The sizes are rounded down to a prime number of items, as for the defaults.
+	*/
+	struct sizing_t
+	{
+		uint64_t epoch_length;			/**< number of blocks per epoch */
+		uint64_t cache_bytes_init;		/**< cache size in bytes at epoch 0 */
+		uint64_t cache_bytes_growth;	/**< cache growth in bytes per epoch */
+		uint64_t dataset_bytes_init;	/**< DAG size in bytes at epoch 0 */
+		uint64_t dataset_bytes_growth;	/**< DAG growth in bytes per epoch */
+
+		/** \brief Construct the default sizing from constants.
+		*/
+		sizing_t() noexcept;
+
+		/** \brief Construct a sizing from its parameters.
+		*
+		*	\throws hash_exception if the epoch length is 0, or the cache or DAG would be smaller than a single page of constants::MIX_BYTES.
+		*/
+		sizing_t(uint64_t epoch_length, uint64_t cache_bytes_init, uint64_t cache_bytes_growth, uint64_t dataset_bytes_init, uint64_t dataset_bytes_growth);
+
+		bool operator==(sizing_t const & rhs) const noexcept;
+		bool operator!=(sizing_t const & rhs) const noexcept;
+		bool operator<(sizing_t const & rhs) const noexcept;
+	};
+
+	/** \brief Select the sizing used by all caches and DAGs created, loaded or looked up from now on.
+	*
+	*	Loaded caches and DAGs are registered per sizing, so switching back to a sizing finds those loaded before.
+	*	The sizing must not be changed while other threads create or use caches and DAGs, see lock_sizing().
+	*	\param sizing is the new sizing.
+	*	\throws hash_exception if the sizing is locked and differs from sizing.
+	*/
+	void set_sizing(sizing_t const & sizing);
+
+	/** \brief Lock the current sizing, set_sizing() only accepts the same sizing from now on.
+	*
+	*	Call this once the sizing is final and before other threads create or use caches and DAGs.
+	*/
+	void lock_sizing();
+
+	/** \brief Get the current sizing, see set_sizing().
+	*
+	*	Reading the sizing takes no lock, the returned sizing stays valid for the lifetime of the process.
+	*	\return sizing_t currently in use, the default sizing if set_sizing() was never called.
+	*/
+	sizing_t const & get_sizing() noexcept;
+
+	/** \brief Get the epoch of a block number with the current sizing.
+	*
+	*	\param block_number is the block number for which to compute the epoch.
+	*	\return uint64_t representing the epoch number (block_number / get_sizing().epoch_length)
+	*/
+	uint64_t get_epoch(uint64_t const block_number) noexcept;
+
 	/** \brief node union is used instead of the native integer to allow both bytes level access and as a 4 byte hash word
 	*
 	*/
@@ -125,6 +215,73 @@ namespace egihash
 	#pragma pack(pop)
 	static_assert(sizeof(node) == sizeof(uint32_t), "Invalid hash node size");
 
+	/** \brief data_view_t is a read-only view of the items of a cache or DAG.
+	*
+	*	Cache and DAG data is stored in a single contiguous buffer aligned to constants::DATA_ALIGNMENT.
+	*	Each item is constants::HASH_BYTES long and consists of constants::HASH_WORDS nodes.
+	*/
+	struct data_view_t
+	{
+		/** \brief size_type represents sizes used by a data view.
+		*/
+		using size_type = ::std::size_t;
+
+		/** \brief Construct an empty view.
+		*/
+		constexpr data_view_t()
+		: ptr(nullptr)
+		, count(0)
+		{}
+
+		/** \brief Construct a view of item_count items starting at first.
+		*/
+		constexpr data_view_t(node const * first, size_type item_count)
+		: ptr(first)
+		, count(item_count)
+		{}
+
+		/** \brief Get the item at index.
+		*
+		*	\returns node const * to the first of constants::HASH_WORDS nodes of the item.
+		*/
+		node const * operator[](size_type index) const noexcept
+		{
+			return ptr + (index * constants::HASH_WORDS);
+		}
+
+		/** \brief Get a pointer to the start of the contiguous data.
+		*/
+		node const * data() const noexcept
+		{
+			return ptr;
+		}
+
+		/** \brief Get the number of items in this view.
+		*/
+		size_type size() const noexcept
+		{
+			return count;
+		}
+
+		/** \brief Get the number of bytes in this view.
+		*/
+		size_type size_bytes() const noexcept
+		{
+			return count * constants::HASH_BYTES;
+		}
+
+		/** \brief Test if this view contains no items.
+		*/
+		bool empty() const noexcept
+		{
+			return count == 0;
+		}
+
+	private:
+		node const * ptr;
+		size_type count;
+	};
+
 
 	/** \brief hash_exception indicates an error or cancellation when performing a task within egihash.
 	*
@@ -350,7 +507,8 @@ namespace egihash
 		cache_loading,		/**< cache_loading is loading the cache from disk */
 		dag_generation,		/**< dag_generation is computing the DAG for a given epoch (block_number) */
 		dag_saving,			/**< dag_saving is saving the DAG to disk */
-		dag_loading			/**< dag_loading is loading the DAG from disk */
+		dag_loading,		/**< dag_loading is loading the DAG from disk */
+		dag_verification	/**< dag_verification is verifying the chunk checksums of a loaded DAG, and regenerating corrupt chunks */
 	};
 
 	/** \brief progress_callback_type is a function which may be passed to any phase of DAG/cache or generation to receive progress updates.
@@ -362,6 +520,54 @@ namespace egihash
 	*/
 	using progress_callback_type = ::std::function<bool (::std::size_t step, ::std::size_t max, progress_callback_phase phase)>;
 
+	/** \brief dag_load_mode values select how a DAG file is brought into memory.
+	*/
+	enum dag_load_mode
+	{
+		dag_load_copy,		/**< dag_load_copy reads the whole DAG file into memory */
+		dag_load_mmap		/**< dag_load_mmap maps the DAG file read-only, pages are faulted in lazily from the page cache (falls back to dag_load_copy where unsupported) */
+	};
+
+	/** \brief dag_write_flags values control how DAG files are written, they may be combined.
+	*/
+	enum dag_write_flags : unsigned int
+	{
+		dag_write_buffered = 0u,	/**< dag_write_buffered writes through the page cache */
+		dag_write_direct = 1u,		/**< dag_write_direct bypasses the page cache with O_DIRECT where supported */
+		dag_write_sync = 2u		/**< dag_write_sync flushes the file to the device before returning */
+	};
+
+	/** \brief dag_page_mode values select the page size backing the memory of generated and copied DAGs.
+	*
+	*	The DAG is read in random pages of constants::MIX_BYTES, so with small pages nearly every access misses the TLB.
+	*	Every mode falls back to the next smaller one when the system can not provide it.
+	*/
+	enum dag_page_mode
+	{
+		dag_pages_default,		/**< dag_pages_default uses regular allocations */
+		dag_pages_transparent,	/**< dag_pages_transparent asks the kernel for transparent huge pages (madvise MADV_HUGEPAGE) */
+		dag_pages_huge			/**< dag_pages_huge uses reserved huge pages (mmap MAP_HUGETLB, see /proc/sys/vm/nr_hugepages) */
+	};
+
+	/** \brief dag_numa_mode values select how the memory of generated and copied DAGs is placed on NUMA nodes.
+	*/
+	enum dag_numa_mode
+	{
+		dag_numa_default,		/**< dag_numa_default leaves placement to the kernel, pages go to the node of the thread touching them first */
+		dag_numa_interleave,	/**< dag_numa_interleave spreads pages round robin over all nodes, so all sockets see the same average latency */
+		dag_numa_bind			/**< dag_numa_bind places all pages on one node, for miners whose threads run on that node */
+	};
+
+	/** \brief Allocate memory for DAG items following the policy set with dag_t::set_memory_policy().
+	*
+	*	All DAGs which are generated or copied from a file are stored in memory from here.
+	*	It is exposed so the effect of a policy can be measured without generating a DAG.
+	*	\param bytes is the number of bytes to allocate.
+	*	\throws ::std::bad_alloc if no memory could be allocated
+	*	\return shared_ptr owning the memory, aligned to at least constants::DATA_ALIGNMENT bytes
+	*/
+	::std::shared_ptr<void> allocate_dag_memory(::std::size_t bytes);
+
 	/** \brief read_function_type is a function which passed to various objects which perform loading of a file, such as the cache and DAG.
 	*
 	*	Note that this function will own whatever data it needs to perform the read, i.e. the filestream.
@@ -381,9 +587,9 @@ namespace egihash
 		*/
 		using size_type = uint64_t;
 
-		/** \brief data_type is the underlying data store which stores a cache.
+		/** \brief data_type is a view of the contiguous data which stores a cache.
 		*/
-		using data_type = ::std::vector<::std::vector<node>>;
+		using data_type = data_view_t;
 
 		/** \brief default copy constructor.
 		*/
@@ -416,9 +622,27 @@ namespace egihash
 		*/
 		cache_t(uint64_t block_number, progress_callback_type callback = [](size_type, size_type, int){ return true; });
 
+		/** \brief Construct a cache_t by loading a cache file written by save().
+		*
+		*	The cache becomes the loaded cache of its epoch. If a cache of that epoch is already loaded, it is used instead.
+		*	\param file_path is the path to the cache file.
+		*	\param callback (optional) may be used to monitor the progress of cache loading. Return false to cancel, true to continue.
+		*	\param mode (optional) selects whether the file is read into memory or memory mapped read-only.
+		*	\throws hash_exception if the file can not be read, or its size, seedhash or checksum do not match.
+		*/
+		cache_t(::std::string const & file_path, progress_callback_type callback = [](size_type, size_type, int){ return true; }, dag_load_mode mode = dag_load_copy);
+
+		/** \brief Save the cache to a cache file, so it can be loaded instead of generated later.
+		*
+		*	\param file_path is the path to which the cache file should be written.
+		*	\param callback (optional) may be used to monitor the progress of cache saving. Return false to cancel, true to continue.
+		*	\throws hash_exception if the file can not be written.
+		*/
+		void save(::std::string const & file_path, progress_callback_type callback = [](size_type, size_type, int){ return true; }) const;
+
 		/** \brief Get the epoch number for which this cache is valid.
 		*
-		*	\returns uint64_t representing the epoch number (block_number / constants::EPOCH_LENGTH)
+		*	\returns uint64_t representing the epoch number, see get_epoch()
 		*/
 		uint64_t epoch() const;
 
@@ -430,9 +654,9 @@ namespace egihash
 
 		/** \brief Get the data the cache contains.
 		*
-		*	\returns data_type const & to the actual cache data.
+		*	\returns data_type view of the actual cache data, valid for the lifetime of this cache_t.
 		*/
-		data_type const & data() const;
+		data_type data() const;
 
 		/** \brief Get the seedhash for this cache.
 		*
@@ -457,11 +681,30 @@ namespace egihash
 
 		/** \brief get_seedhash(uint64_t) will compute the seedhash for a given block number.
 		*
+		*	Seedhashes are memoized in a process-wide, thread-safe table which is extended as later epochs are requested.
 		*	\param block_number An unsigned 64-bit integer representing the block number for which to compute the seed hash.
 		*	\return An h256_t keccak-256 seed hash for the given block number.
 		*/
 		static h256_t get_seedhash(uint64_t const block_number);
 
+		/** \brief Load previously saved seedhashes into the seedhash table.
+		*
+		*	The file is checked for its magic bytes, the epoch 0 seedhash and a Keccak-256 checksum of its contents,
+		*	and every seedhash is checked to be the Keccak-256 hash of the one before it.
+		*	The table is only replaced if the file contains more seedhashes than are already known.
+		*	\param file_path is the path to the file the seedhashes should be loaded from.
+		*	\throws hash_exception if the file can not be read or is corrupt.
+		*/
+		static void load_seedhashes(::std::string const & file_path);
+
+		/** \brief Save the seedhash table for future loading.
+		*
+		*	The table is written to a temporary file next to file_path, which then replaces file_path.
+		*	\param file_path is the path to the file the seedhashes should be saved to.
+		*	\throws hash_exception if the file can not be written.
+		*/
+		static void save_seedhashes(::std::string const & file_path);
+
 		/** \brief Determine whether the cache_t for this epoch is already loaded
 		*
 		*	\param epoch is the epoch number for which to determine if a cache_t is already loaded.
@@ -475,6 +718,38 @@ namespace egihash
 		*/
 		static ::std::vector<uint64_t> get_loaded();
 
+		/** \brief stats_t contains the counters of the process-wide registry of loaded caches.
+		*/
+		struct stats_t
+		{
+			uint64_t hits;			/**< requests served by an already loaded cache */
+			uint64_t misses;		/**< requests which had to generate a cache */
+			uint64_t evictions;		/**< caches released to stay within the memory budget */
+			uint64_t loaded_count;	/**< number of caches currently loaded */
+			uint64_t loaded_bytes;	/**< total size in bytes of the caches currently loaded */
+			uint64_t budget_bytes;	/**< memory budget in bytes, 0 if unlimited */
+		};
+
+		/** \brief Limit the memory used by loaded caches.
+		*
+		*	When a cache is generated and the loaded caches exceed the budget, the least recently used caches are unloaded.
+		*	Pinned caches and the cache just generated are never evicted, so the budget may be exceeded by them.
+		*	\param budget_bytes is the memory budget in bytes, 0 for unlimited (the default).
+		*/
+		static void set_memory_budget(uint64_t const budget_bytes);
+
+		/** \brief Set the epochs whose caches are exempt from eviction, replacing the previously pinned epochs.
+		*
+		*	\param epochs are the epoch numbers to pin, typically the current and the next epoch.
+		*/
+		static void set_pinned_epochs(::std::vector<uint64_t> const & epochs);
+
+		/** \brief Get the counters of the loaded cache registry.
+		*
+		*	\return stats_t snapshot of the counters.
+		*/
+		static stats_t get_stats();
+
 		/** \brief cache_t internal implementation.
 		*/
 		struct impl_t;
@@ -498,6 +773,12 @@ namespace egihash
 		*/
 		void load(read_function_type read, progress_callback_type callback = [](size_type, size_type, int){ return true; });
 
+		/** \brief Construct a cache_t from an existing implementation, e.g. one which refers to a memory mapped DAG file.
+		*
+		*	\param impl is the implementation to share.
+		*/
+		explicit cache_t(::std::shared_ptr<impl_t> const & impl);
+
 		/** \brief shared_ptr to impl allows default moving/copying of cache. Internally, only one cache_t::impl_t per epoch will exist.
 		*/
 		::std::shared_ptr<impl_t> impl;
@@ -506,8 +787,8 @@ namespace egihash
 	/** \brief dag_t is the DAG which is used by full nodes and miners to compute egihashes.
 	*
 	*	The DAG gives egihash it's ASIC resistance, ensuring that this hashing function is memory bound not compute bound.
-	*	The DAG must be updated once per constants::EPOCH_LENGTH block numbers.
-	*	The DAG for epoch 0 is 1073739904 bytes in size and will grow linearly with each following epoch.
+	*	The DAG must be updated once per epoch, get_sizing().epoch_length block numbers.
+	*	With the default sizing_t, the DAG for epoch 0 is 2600467328 bytes in size and will grow linearly with each following epoch.
 	*	The DAG can take a long time to generate. It is recommended to save the DAG to disk to avoid having to regenerate it each time.
 	*	It makes sense to pre-compute the DAG for the next epoch, so generating it does not interrupt mining / operation of a full node.
 	*	Whether by generation or by loading, the DAG will own a cache_t which corresponds to cache for the same epoch.
@@ -518,9 +799,9 @@ namespace egihash
 		*/
 		using size_type = ::std::size_t;
 
-		/** \brief data_type is the underlying data store which stores a cache.
+		/** \brief data_type is a view of the contiguous data which stores a DAG.
 		*/
-		using data_type = ::std::vector<::std::vector<node>>;
+		using data_type = data_view_t;
 
 		/** \brief default copy constructor.
 		*/
@@ -552,20 +833,39 @@ namespace egihash
 		*	If this DAG is not yet loaded, this will take a long time.
 		*	\param block_number is the block number for which to generate a DAG.
 		*	\param callback (optional) may be used to monitor the progress of DAG generation. Return false to cancel, true to continue.
+		*		The callback is only ever called from the constructing thread.
+		*	\param thread_count (optional) is the number of threads used to generate the DAG, 0 uses all available hardware threads.
 		*/
-		dag_t(uint64_t const block_number, progress_callback_type = [](size_type, size_type, int){ return true; });
+		dag_t(uint64_t const block_number, progress_callback_type = [](size_type, size_type, int){ return true; }, unsigned int thread_count = 1);
+
+		/** \brief generate a DAG for a given block_number and save it to a file while it is being generated.
+		*
+		*	Completed parts of the DAG are written in file order by a separate thread, so saving overlaps with generation.
+		*	If the DAG is already loaded, it is saved as by save().
+		*	\param block_number is the block number for which to generate a DAG.
+		*	\param file_path is the path to the file the DAG should be saved to. It is removed if generation fails or is cancelled.
+		*	\param callback (optional) may be used to monitor the progress of DAG generation. Return false to cancel, true to continue.
+		*		The callback is only ever called from the constructing thread.
+		*	\param thread_count (optional) is the number of threads used to generate the DAG, 0 uses all available hardware threads.
+		*	\param write_flags (optional) is a combination of dag_write_flags.
+		*/
+		dag_t(uint64_t const block_number, ::std::string const & file_path, progress_callback_type = [](size_type, size_type, int){ return true; }, unsigned int thread_count = 1, unsigned int write_flags = dag_write_buffered);
 
 		/** \brief load a DAG from a file.
 		*
 		*	DAG's are cached in a singleton per epoch. If this DAG is already loaded in memory it will be returned quickly.
+		*	If the file has chunk checksums, a copied DAG is verified completely before it is returned, whereas the chunks
+		*	of a mapped DAG are verified on a background thread, items of chunks not verified yet are computed from the cache.
+		*	Corrupt chunks are regenerated and written back to the file, see verify().
 		*	\param file_path is the path to the file the DAG should be loaded from.
 		*	\param callback (optional) may be used to monitor the progress of DAG loading. Return false to cancel, true to continue.
+		*	\param mode (optional) whether to copy the DAG file into memory or to map it read-only.
 		*/
-		dag_t(::std::string const & file_path, progress_callback_type = [](size_type, size_type, int){ return true; });
+		dag_t(::std::string const & file_path, progress_callback_type = [](size_type, size_type, int){ return true; }, dag_load_mode mode = dag_load_copy);
 
 		/** \brief Get the epoch number for which this DAG is valid.
 		*
-		*	\returns uint64_t representing the epoch number (block_number / constants::EPOCH_LENGTH)
+		*	\returns uint64_t representing the epoch number, see get_epoch()
 		*/
 		uint64_t epoch() const;
 
@@ -577,16 +877,17 @@ namespace egihash
 
 		/** \brief Get the data the DAG contains.
 		*
-		*	\returns data_type const & to the actual DAG data.
+		*	\returns data_type view of the actual DAG data, valid for the lifetime of this dag_t.
 		*/
-		data_type const & data() const;
+		data_type data() const;
 
 		/** \brief Save the DAG to a file fur future loading.
 		*
 		*	\param file_path is the path to the file the DAG should be saved to.
 		*	\param callback (optional) may be used to monitor the progress of DAG saving. Return false to cancel, true to continue.
+		*	\param write_flags (optional) is a combination of dag_write_flags.
 		*/
-		void save(::std::string const & file_path, progress_callback_type callback = [](size_type, size_type, int){ return true; }) const;
+		void save(::std::string const & file_path, progress_callback_type callback = [](size_type, size_type, int){ return true; }, unsigned int write_flags = dag_write_buffered) const;
 
 		/** \brief Get the cache for this DAG.
 		*
@@ -594,6 +895,15 @@ namespace egihash
 		*/
 		cache_t get_cache() const;
 
+		/** \brief Verify all chunks of a DAG loaded from a file with chunk checksums which were not verified yet.
+		*
+		*	Corrupt chunks are regenerated from the cache, and written back to the file if it is writable.
+		*	\param thread_count (optional) is the number of threads used, 0 uses all available hardware threads.
+		*	\param callback (optional) may be used to monitor the progress of verification. Return false to cancel, true to continue.
+		*	\return the number of chunks which have been regenerated since the DAG was loaded.
+		*/
+		size_type verify(unsigned int thread_count = 0, progress_callback_type callback = [](size_type, size_type, int){ return true; }) const;
+
 		/** \brief Unload a DAG.
 		*
 		*	To actually free a DAG from memory, call this function on a DAG. The DAG will then be released from the internal cache.
@@ -621,6 +931,16 @@ namespace egihash
 		*/
 		static ::std::vector<uint64_t> get_loaded();
 
+		/** \brief Set how the memory of DAGs generated or copied from now on is allocated, see allocate_dag_memory().
+		*
+		*	Policies are best effort, a mode that the system does not support falls back to the default.
+		*	DAGs mapped from files with dag_load_mmap use the page cache and are not affected.
+		*	\param pages selects the page size.
+		*	\param numa selects the placement on NUMA nodes.
+		*	\param numa_node is the node to use with dag_numa_bind.
+		*/
+		static void set_memory_policy(dag_page_mode const pages, dag_numa_mode const numa = dag_numa_default, unsigned int const numa_node = 0);
+
 		/** \brief dag_t private implementation.
 		*/
 		struct impl_t;
@@ -668,6 +988,22 @@ namespace egihash
 		*	\return result_t containing hashed data
 		*/
 		result_t hash(dag_t const & dag, h256_t const & header_hash, uint64_t const nonce);
+
+		/** \brief Search a range of nonces for a solution, as miners do.
+		*
+		*	The header hash is prepared once and the nonces are hashed in a tight loop.
+		*
+		*	\param dag A const reference to the DAG for the current epoch
+		*	\param header_hash A h256_t (Keccak-256) hash of the truncated block header
+		*	\param start_nonce The first nonce to try
+		*	\param count The number of nonces to try
+		*	\param target The largest acceptable hash value, compared as a big endian number
+		*	\param nonce Receives the first nonce with a hash value not above target
+		*	\param result Receives the hash and mix hash of that nonce
+		*	\throws hash_exception on error
+		*	\return true if a solution was found, false otherwise
+		*/
+		bool search(dag_t const & dag, h256_t const & header_hash, uint64_t const start_nonce, uint64_t const count, h256_t const & target, uint64_t & nonce, result_t & result);
 	}
 
 	namespace light
@@ -706,6 +1042,20 @@ namespace egihash
 		*	\return result_t containing hashed data
 		*/
 		result_t hash(cache_t const & cache, h256_t const & header_hash, uint64_t const nonce);
+
+		/** \brief Search a range of nonces for a solution without a DAG, see full::search().
+		*
+		*	\param cache A const reference to the cache for the current epoch
+		*	\param header_hash A h256_t (Keccak-256) hash of the truncated block header
+		*	\param start_nonce The first nonce to try
+		*	\param count The number of nonces to try
+		*	\param target The largest acceptable hash value, compared as a big endian number
+		*	\param nonce Receives the first nonce with a hash value not above target
+		*	\param result Receives the hash and mix hash of that nonce
+		*	\throws hash_exception on error
+		*	\return true if a solution was found, false otherwise
+		*/
+		bool search(cache_t const & cache, h256_t const & header_hash, uint64_t const start_nonce, uint64_t const count, h256_t const & target, uint64_t & nonce, result_t & result);
 	}
 }
 
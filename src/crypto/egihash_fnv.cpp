@@ -0,0 +1,144 @@
+// Copyright (c) 2017 Energi Development Team
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "egihash_fnv.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define EGIHASH_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace
+{
+	using namespace egihash;
+	using namespace egihash::fnv_kernels;
+
+	constexpr uint32_t FNV_PRIME = 0x01000193u;
+
+	inline uint32_t fnv(uint32_t v1, uint32_t v2) noexcept
+	{
+		return (v1 * FNV_PRIME) ^ v2;
+	}
+
+	inline void mix_item_scalar(node * mix, node const * item)
+	{
+		for (uint32_t k = 0; k < constants::HASH_WORDS; k++)
+		{
+			mix[k].hword = fnv(mix[k].hword, item[k].hword);
+		}
+	}
+
+	void dataset_parents_scalar(node * mix, data_view_t const & cache, uint32_t index)
+	{
+		uint32_t const n = cache.size();
+		for (uint32_t j = 0; j < constants::DATASET_PARENTS; j++)
+		{
+			uint32_t const cache_index = fnv(index ^ j, mix[j % constants::HASH_WORDS].hword);
+			mix_item_scalar(mix, cache[cache_index % n]);
+		}
+	}
+
+#ifdef EGIHASH_X86_KERNELS
+	static_assert(constants::HASH_BYTES == 64, "SIMD kernels assume 64 byte items");
+
+	__attribute__((target("sse4.1")))
+	inline void mix_item_sse41(node * mix, node const * item)
+	{
+		__m128i const prime = _mm_set1_epi32(FNV_PRIME);
+		__m128i * const m = reinterpret_cast<__m128i *>(mix);
+		__m128i const * const d = reinterpret_cast<__m128i const *>(item);
+		for (int k = 0; k < 4; k++)
+		{
+			__m128i const v = _mm_mullo_epi32(_mm_loadu_si128(m + k), prime);
+			_mm_storeu_si128(m + k, _mm_xor_si128(v, _mm_loadu_si128(d + k)));
+		}
+	}
+
+	__attribute__((target("sse4.1")))
+	void dataset_parents_sse41(node * mix, data_view_t const & cache, uint32_t index)
+	{
+		uint32_t const n = cache.size();
+		for (uint32_t j = 0; j < constants::DATASET_PARENTS; j++)
+		{
+			uint32_t const cache_index = fnv(index ^ j, mix[j % constants::HASH_WORDS].hword);
+			mix_item_sse41(mix, cache[cache_index % n]);
+		}
+	}
+
+	__attribute__((target("avx2")))
+	inline void mix_item_avx2(node * mix, node const * item)
+	{
+		__m256i const prime = _mm256_set1_epi32(FNV_PRIME);
+		__m256i * const m = reinterpret_cast<__m256i *>(mix);
+		__m256i const * const d = reinterpret_cast<__m256i const *>(item);
+		__m256i const v0 = _mm256_mullo_epi32(_mm256_loadu_si256(m), prime);
+		__m256i const v1 = _mm256_mullo_epi32(_mm256_loadu_si256(m + 1), prime);
+		_mm256_storeu_si256(m, _mm256_xor_si256(v0, _mm256_loadu_si256(d)));
+		_mm256_storeu_si256(m + 1, _mm256_xor_si256(v1, _mm256_loadu_si256(d + 1)));
+	}
+
+	__attribute__((target("avx2")))
+	void dataset_parents_avx2(node * mix, data_view_t const & cache, uint32_t index)
+	{
+		uint32_t const n = cache.size();
+		for (uint32_t j = 0; j < constants::DATASET_PARENTS; j++)
+		{
+			uint32_t const cache_index = fnv(index ^ j, mix[j % constants::HASH_WORDS].hword);
+			mix_item_avx2(mix, cache[cache_index % n]);
+		}
+	}
+#endif // EGIHASH_X86_KERNELS
+
+	kernels_t const scalar_kernels = { scalar, "scalar", &mix_item_scalar, &dataset_parents_scalar };
+#ifdef EGIHASH_X86_KERNELS
+	kernels_t const sse41_kernels = { sse41, "sse4.1", &mix_item_sse41, &dataset_parents_sse41 };
+	kernels_t const avx2_kernels = { avx2, "avx2", &mix_item_avx2, &dataset_parents_avx2 };
+#endif // EGIHASH_X86_KERNELS
+}
+
+namespace egihash
+{
+	namespace fnv_kernels
+	{
+		bool is_supported(kernel_level level) noexcept
+		{
+			switch (level)
+			{
+				case scalar:
+					return true;
+#ifdef EGIHASH_X86_KERNELS
+				case sse41:
+					__builtin_cpu_init();
+					return __builtin_cpu_supports("sse4.1");
+				case avx2:
+					__builtin_cpu_init();
+					return __builtin_cpu_supports("avx2");
+#endif // EGIHASH_X86_KERNELS
+				default:
+					return false;
+			}
+		}
+
+		kernels_t const & get_kernels(kernel_level level) noexcept
+		{
+			switch (level)
+			{
+#ifdef EGIHASH_X86_KERNELS
+				case sse41:
+					return sse41_kernels;
+				case avx2:
+					return avx2_kernels;
+#endif // EGIHASH_X86_KERNELS
+				default:
+					return scalar_kernels;
+			}
+		}
+
+		kernels_t const & active_kernels() noexcept
+		{
+			static kernels_t const & active = is_supported(avx2) ? get_kernels(avx2) : (is_supported(sse41) ? get_kernels(sse41) : get_kernels(scalar));
+			return active;
+		}
+	}
+}
@@ -0,0 +1,58 @@
+// Copyright (c) 2017 Energi Development Team
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include "egihash.h"
+
+namespace egihash
+{
+	/** \brief fnv_kernels contains the FNV mixing loops of egihash in scalar and SIMD variants.
+	*
+	*	All variants produce identical results. The best variant supported by the CPU is selected at runtime.
+	*/
+	namespace fnv_kernels
+	{
+		/** \brief kernel_level identifies an implementation of the FNV kernels.
+		*/
+		enum kernel_level
+		{
+			scalar,		/**< portable scalar code, always available */
+			sse41,		/**< SSE4.1, 4 words per instruction */
+			avx2		/**< AVX2, 8 words per instruction */
+		};
+
+		/** \brief mix_item_function_type mixes one DAG item into constants::HASH_WORDS words of mix: mix[k] = fnv(mix[k], item[k])
+		*/
+		using mix_item_function_type = void (*)(node * mix, node const * item);
+
+		/** \brief dataset_parents_function_type mixes the constants::DATASET_PARENTS cache parents of DAG item index into mix.
+		*/
+		using dataset_parents_function_type = void (*)(node * mix, data_view_t const & cache, uint32_t index);
+
+		/** \brief kernels_t is a set of FNV kernels of one kernel_level.
+		*/
+		struct kernels_t
+		{
+			kernel_level level;
+			char const * name;
+			mix_item_function_type mix_item;
+			dataset_parents_function_type dataset_parents;
+		};
+
+		/** \brief Determine whether the CPU supports a kernel level.
+		*/
+		bool is_supported(kernel_level level) noexcept;
+
+		/** \brief Get the kernels of a specific level.
+		*
+		*	\param level must be supported by the CPU, see is_supported().
+		*/
+		kernels_t const & get_kernels(kernel_level level) noexcept;
+
+		/** \brief Get the fastest kernels supported by the CPU, detected once on first use.
+		*/
+		kernels_t const & active_kernels() noexcept;
+	}
+}
@@ -20,16 +20,6 @@
 /******** The Keccak-f[1600] permutation ********/
 
 /*** Constants. ***/
-static const uint8_t rho[24] = \
-  { 1,  3,   6, 10, 15, 21,
-    28, 36, 45, 55,  2, 14,
-    27, 41, 56,  8, 25, 43,
-    62, 18, 39, 61, 20, 44};
-static const uint8_t pi[24] = \
-  {10,  7, 11, 17, 18, 3,
-    5, 16,  8, 21, 24, 4,
-   15, 23, 19, 13, 12, 2,
-   20, 14, 22,  9, 6,  1};
 static const uint64_t RC[24] = \
   {1ULL, 0x8082ULL, 0x800000000000808aULL, 0x8000000080008000ULL,
    0x808bULL, 0x80000001ULL, 0x8000000080008081ULL, 0x8000000000008009ULL,
@@ -40,46 +30,122 @@ static const uint64_t RC[24] = \
 
 /*** Helper macros to unroll the permutation. ***/
 #define rol(x, s) (((x) << s) | ((x) >> (64 - s)))
-#define REPEAT6(e) e e e e e e
-#define REPEAT24(e) REPEAT6(e e e e)
-#define REPEAT5(e) e e e e e
-#define FOR5(v, s, e) \
-  v = 0;            \
-  REPEAT5(e; v += s;)
 
 /*** Keccak-f[1600] ***/
-static inline void keccakf(void* state) {
-  uint64_t* a = (uint64_t*)state;
-  uint64_t b[5] = {0};
-  uint64_t t = 0;
-  uint8_t x, y;
-
-  for (int i = 0; i < 24; i++) {
-    // Theta
-    FOR5(x, 1,
-         b[x] = 0;
-         FOR5(y, 5,
-              b[x] ^= a[x + y]; ))
-    FOR5(x, 1,
-         FOR5(y, 5,
-              a[y + x] ^= b[(x + 4) % 5] ^ rol(b[(x + 1) % 5], 1); ))
-    // Rho and pi
-    t = a[1];
-    x = 0;
-    REPEAT24(b[0] = a[pi[x]];
-             a[pi[x]] = rol(t, rho[x]);
-             t = b[0];
-             x++; )
-    // Chi
-    FOR5(y,
-       5,
-       FOR5(x, 1,
-            b[x] = a[y + x];)
-       FOR5(x, 1,
-            a[y + x] = b[x] ^ ((~b[(x + 1) % 5]) & b[(x + 2) % 5]); ))
-    // Iota
-    a[0] ^= RC[i];
+
+/* The permutation is fully unrolled over named lanes, two rounds per
+ * iteration, with the state held in locals. The lanes be, bi, go, ki, mi
+ * and sa are kept complemented ("lane complementing"), which replaces 20
+ * of the 25 NOT operations per round in chi with OR operations.
+ */
+#define KECCAK_DECLARE_LANES(T, A) \
+  T A##ba, A##be, A##bi, A##bo, A##bu, \
+           A##ga, A##ge, A##gi, A##go, A##gu, \
+           A##ka, A##ke, A##ki, A##ko, A##ku, \
+           A##ma, A##me, A##mi, A##mo, A##mu, \
+           A##sa, A##se, A##si, A##so, A##su;
+
+#define KECCAK_THETA(A, T) \
+  Ca = A##ba ^ A##ga ^ A##ka ^ A##ma ^ A##sa; \
+  Ce = A##be ^ A##ge ^ A##ke ^ A##me ^ A##se; \
+  Ci = A##bi ^ A##gi ^ A##ki ^ A##mi ^ A##si; \
+  Co = A##bo ^ A##go ^ A##ko ^ A##mo ^ A##so; \
+  Cu = A##bu ^ A##gu ^ A##ku ^ A##mu ^ A##su; \
+  Da = Cu ^ T(Ce, 1); \
+  De = Ca ^ T(Ci, 1); \
+  Di = Ce ^ T(Co, 1); \
+  Do = Ci ^ T(Cu, 1); \
+  Du = Co ^ T(Ca, 1);
+
+#define KECCAK_ROUND(A, E, rc) \
+  KECCAK_THETA(A, rol) \
+  Ba = A##ba ^ Da; \
+  Be = rol(A##ge ^ De, 44); \
+  Bi = rol(A##ki ^ Di, 43); \
+  Bo = rol(A##mo ^ Do, 21); \
+  Bu = rol(A##su ^ Du, 14); \
+  E##ba = Ba ^ (Be | Bi) ^ (rc); \
+  E##be = Be ^ ((~Bi) | Bo); \
+  E##bi = Bi ^ (Bo & Bu); \
+  E##bo = Bo ^ (Bu | Ba); \
+  E##bu = Bu ^ (Ba & Be); \
+  Ba = rol(A##bo ^ Do, 28); \
+  Be = rol(A##gu ^ Du, 20); \
+  Bi = rol(A##ka ^ Da, 3); \
+  Bo = rol(A##me ^ De, 45); \
+  Bu = rol(A##si ^ Di, 61); \
+  E##ga = Ba ^ (Be | Bi); \
+  E##ge = Be ^ (Bi & Bo); \
+  E##gi = Bi ^ (Bo | (~Bu)); \
+  E##go = Bo ^ (Bu | Ba); \
+  E##gu = Bu ^ (Ba & Be); \
+  Ba = rol(A##be ^ De, 1); \
+  Be = rol(A##gi ^ Di, 6); \
+  Bi = rol(A##ko ^ Do, 25); \
+  Bo = rol(A##mu ^ Du, 8); \
+  Bu = rol(A##sa ^ Da, 18); \
+  E##ka = Ba ^ (Be | Bi); \
+  E##ke = Be ^ (Bi & Bo); \
+  E##ki = Bi ^ ((~Bo) & Bu); \
+  E##ko = (~Bo) ^ (Bu | Ba); \
+  E##ku = Bu ^ (Ba & Be); \
+  Ba = rol(A##bu ^ Du, 27); \
+  Be = rol(A##ga ^ Da, 36); \
+  Bi = rol(A##ke ^ De, 10); \
+  Bo = rol(A##mi ^ Di, 15); \
+  Bu = rol(A##so ^ Do, 56); \
+  E##ma = Ba ^ (Be & Bi); \
+  E##me = Be ^ (Bi | Bo); \
+  E##mi = Bi ^ ((~Bo) | Bu); \
+  E##mo = (~Bo) ^ (Bu & Ba); \
+  E##mu = Bu ^ (Ba | Be); \
+  Ba = rol(A##bi ^ Di, 62); \
+  Be = rol(A##go ^ Do, 55); \
+  Bi = rol(A##ku ^ Du, 39); \
+  Bo = rol(A##ma ^ Da, 41); \
+  Bu = rol(A##se ^ De, 2); \
+  E##sa = Ba ^ ((~Be) & Bi); \
+  E##se = (~Be) ^ (Bi | Bo); \
+  E##si = Bi ^ (Bo & Bu); \
+  E##so = Bo ^ (Bu | Ba); \
+  E##su = Bu ^ (Ba & Be);
+
+#define KECCAK_LANES(F, A, a) \
+  F(A##ba, a[0])  F(A##be, a[1])  F(A##bi, a[2])  F(A##bo, a[3])  F(A##bu, a[4])  \
+  F(A##ga, a[5])  F(A##ge, a[6])  F(A##gi, a[7])  F(A##go, a[8])  F(A##gu, a[9])  \
+  F(A##ka, a[10]) F(A##ke, a[11]) F(A##ki, a[12]) F(A##ko, a[13]) F(A##ku, a[14]) \
+  F(A##ma, a[15]) F(A##me, a[16]) F(A##mi, a[17]) F(A##mo, a[18]) F(A##mu, a[19]) \
+  F(A##sa, a[20]) F(A##se, a[21]) F(A##si, a[22]) F(A##so, a[23]) F(A##su, a[24])
+#define KECCAK_LOAD(lane, src) lane = src;
+#define KECCAK_STORE(lane, dst) dst = lane;
+
+/* Defines a permutation NAME over an array of 25 lanes of type T. T is
+ * either uint64_t or a vector of independent uint64_t lanes, one per state.
+ */
+#define KECCAK_PERMUTATION(NAME, T)                                       \
+  static inline void NAME(T* a) {                                         \
+    KECCAK_DECLARE_LANES(T, A)                                            \
+    KECCAK_DECLARE_LANES(T, E)                                            \
+    T Ba, Be, Bi, Bo, Bu;                                                 \
+    T Ca, Ce, Ci, Co, Cu;                                                 \
+    T Da, De, Di, Do, Du;                                                 \
+                                                                          \
+    KECCAK_LANES(KECCAK_LOAD, A, a)                                       \
+    Abe = ~Abe; Abi = ~Abi; Ago = ~Ago; Aki = ~Aki; Ami = ~Ami; Asa = ~Asa; \
+                                                                          \
+    for (int i = 0; i < 24; i += 2) {                                     \
+      KECCAK_ROUND(A, E, RC[i])                                           \
+      KECCAK_ROUND(E, A, RC[i + 1])                                       \
+    }                                                                     \
+                                                                          \
+    Abe = ~Abe; Abi = ~Abi; Ago = ~Ago; Aki = ~Aki; Ami = ~Ami; Asa = ~Asa; \
+    KECCAK_LANES(KECCAK_STORE, A, a)                                      \
   }
+
+KECCAK_PERMUTATION(keccakf_lanes, uint64_t)
+
+static inline void keccakf(void* state) {
+  keccakf_lanes((uint64_t*)state);
 }
 
 /******** The FIPS202-defined functions. ********/
@@ -169,3 +235,126 @@ defsha3(224)
 defsha3(256)
 defsha3(384)
 defsha3(512)
+
+/******** Multi-buffer SHA3 ********/
+
+/** Hashes four equally long messages. With AVX2 the four states are
+ * interleaved in 256-bit registers and permuted together, otherwise the
+ * messages are hashed one after another.
+ */
+#if defined(__GNUC__) && defined(__x86_64__)
+#define KECCAK_X4_AVX2 1
+
+typedef uint64_t keccak_lanes_x4 __attribute__((vector_size(32)));
+
+__attribute__((target("avx2")))
+KECCAK_PERMUTATION(keccakf_x4, keccak_lanes_x4)
+
+static inline uint64_t load64(const uint8_t* src) {
+  uint64_t v;
+  memcpy(&v, src, sizeof(v));
+  return v;
+}
+
+__attribute__((target("avx2")))
+static void hash_x4_avx2(uint8_t* const out[4], size_t outlen,
+                         const uint8_t* const in[4], size_t inlen,
+                         size_t rate, uint8_t delim) {
+  keccak_lanes_x4 a[25];
+  uint64_t block[4][Plen / 8];
+  size_t const lanes = rate / 8;
+  size_t offset = 0;
+  memset(a, 0, sizeof(a));
+
+  // Absorb full blocks.
+  for (; inlen - offset >= rate; offset += rate) {
+    for (size_t i = 0; i < lanes; i++) {
+      keccak_lanes_x4 const v = { load64(in[0] + offset + 8 * i),
+                                  load64(in[1] + offset + 8 * i),
+                                  load64(in[2] + offset + 8 * i),
+                                  load64(in[3] + offset + 8 * i) };
+      a[i] ^= v;
+    }
+    keccakf_x4(a);
+  }
+
+  // Pad and absorb the last block.
+  size_t const rest = inlen - offset;
+  for (int m = 0; m < 4; m++) {
+    uint8_t* const b = (uint8_t*)block[m];
+    memset(b, 0, rate);
+    memcpy(b, in[m] + offset, rest);
+    b[rest] ^= delim;
+    b[rate - 1] ^= 0x80;
+  }
+  for (size_t i = 0; i < lanes; i++) {
+    keccak_lanes_x4 const v = { block[0][i], block[1][i], block[2][i], block[3][i] };
+    a[i] ^= v;
+  }
+  keccakf_x4(a);
+
+  // Squeeze, the output of a SHA3 instance fits in a single block.
+  for (size_t i = 0; i < (outlen + 7) / 8; i++) {
+    for (int m = 0; m < 4; m++) {
+      block[m][i] = a[i][m];
+    }
+  }
+  for (int m = 0; m < 4; m++) {
+    memcpy(out[m], block[m], outlen);
+  }
+
+  #ifdef USE_SECURE_MEMZERO
+  secure_memzero(a, sizeof(a));
+  secure_memzero(block, sizeof(block));
+  #else
+  memset_s(a, sizeof(a), 0, sizeof(a));
+  memset_s(block, sizeof(block), 0, sizeof(block));
+  #endif
+}
+#endif
+
+int keccak_x4_native(void) {
+#ifdef KECCAK_X4_AVX2
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") ? 1 : 0;
+#else
+  return 0;
+#endif
+}
+
+static inline int hash_x4(uint8_t* const out[4], size_t outlen,
+                          const uint8_t* const in[4], size_t inlen,
+                          size_t rate, uint8_t delim) {
+  if ((out == NULL) || (in == NULL) || (outlen > rate)) {
+    return -1;
+  }
+  for (int m = 0; m < 4; m++) {
+    if ((out[m] == NULL) || ((in[m] == NULL) && inlen != 0)) {
+      return -1;
+    }
+  }
+#ifdef KECCAK_X4_AVX2
+  if (keccak_x4_native()) {
+    hash_x4_avx2(out, outlen, in, inlen, rate, delim);
+    return 0;
+  }
+#endif
+  for (int m = 0; m < 4; m++) {
+    if (hash(out[m], outlen, in[m], inlen, rate, delim) != 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+#define defsha3_x4(bits)                                              \
+  int sha3_##bits##_x4(uint8_t* const out[4], size_t outlen,          \
+                       const uint8_t* const in[4], size_t inlen) {    \
+    if (outlen > (bits/8)) {                                          \
+      return -1;                                                      \
+    }                                                                 \
+    return hash_x4(out, outlen, in, inlen, 200 - (bits / 4), 0x01);   \
+  }
+
+defsha3_x4(256)
+defsha3_x4(512)
@@ -15,4 +15,14 @@ decsha3(224)
 decsha3(256)
 decsha3(384)
 decsha3(512)
+
+/* Hash four messages of equal length at once, see keccak_x4_native(). */
+#define decsha3_x4(bits) \
+  int sha3_##bits##_x4(uint8_t* const[4], size_t, const uint8_t* const[4], size_t);
+
+decsha3_x4(256)
+decsha3_x4(512)
+
+/* Returns nonzero if the CPU hashes the four messages of sha3_*_x4 in parallel. */
+int keccak_x4_native(void);
 #endif
@@ -4,36 +4,112 @@
 
 #include "dag_singleton.h"
 
+#include <atomic>
+
 #include <boost/thread/locks.hpp>
 #include <boost/thread/mutex.hpp>
-//#include <mutex>
 
-std::unique_ptr<egihash::dag_t> const & ActiveDAG(std::unique_ptr<egihash::dag_t> next_dag)
+namespace
+{
+    // readers load the handles atomically, swaps are serialized by the mutex
+    boost::mutex csDAGSwap;
+    CDAGRef activeDAG;
+    CDAGRef previousDAG;
+
+    void UnloadDAG(CDAGRef const & dag)
+    {
+        auto const epoch = dag->epoch();
+        try
+        {
+            dag->unload();
+            LogPrint("nrghash", "DAG for epoch %d unloaded\n", epoch);
+        }
+        catch (egihash::hash_exception const & e)
+        {
+            LogPrint("nrghash", "DAG for epoch %d not unloaded: %s\n", epoch, e.what());
+        }
+    }
+}
+
+CDAGRef ActiveDAG(std::unique_ptr<egihash::dag_t> next_dag)
+{
+    using namespace std;
+
+    if (!next_dag)
+    {
+        return atomic_load(&activeDAG);
+    }
+
+    boost::lock_guard<boost::mutex> lock(csDAGSwap);
+    CDAGRef const next(move(next_dag));
+    CDAGRef const active = atomic_load(&activeDAG);
+    auto const previous_epoch = active ? active->epoch() : 0;
+    auto const new_epoch = next->epoch();
+    atomic_store(&activeDAG, next);
+    if (new_epoch != previous_epoch) LogPrint("nrghash", "DAG swapped to new epoch (%d->%d)\n", previous_epoch, new_epoch);
+    else LogPrint("nrghash", "DAG activated for epoch %d\n", new_epoch);
+
+    // keep the swapped out DAG resident for in-flight hashing and reorgs across the epoch boundary,
+    // only two epochs are kept at once. Handles still in use keep their DAG until they are released.
+    if (active && new_epoch != active->epoch())
+    {
+        CDAGRef const previous = atomic_load(&previousDAG);
+        atomic_store(&previousDAG, active);
+        if (previous && previous->epoch() != new_epoch)
+        {
+            UnloadDAG(previous);
+        }
+    }
+    return next;
+}
+
+CDAGRef ResidentDAG(uint64_t epoch)
 {
     using namespace std;
 
-    static boost::mutex m;
-    boost::lock_guard<boost::mutex> lock(m);
-    static unique_ptr<egihash::dag_t> active; // only keep one DAG in memory at once
+    CDAGRef dag = atomic_load(&activeDAG);
+    if (dag && dag->epoch() == epoch)
+    {
+        return dag;
+    }
+    dag = atomic_load(&previousDAG);
+    if (dag && dag->epoch() == epoch)
+    {
+        return dag;
+    }
+    return CDAGRef();
+}
+
+void ReleasePreviousDAG()
+{
+    using namespace std;
 
-    // if we have a next_dag swap it
-    if (next_dag)
+    if (!atomic_load(&previousDAG))
     {
-        auto const previous_epoch = active ? active->epoch() : 0;
-        auto const new_epoch = next_dag->epoch();
-        active.swap(next_dag);
-        if (new_epoch != previous_epoch) LogPrint("nrghash", "DAG swapped to new epoch (%d->%d)\n", previous_epoch, new_epoch);
-        else LogPrint("nrghash", "DAG activated for epoch %d\n", new_epoch);
+        return;
     }
 
-    // unload the previous dag
-    if (next_dag)
+    boost::lock_guard<boost::mutex> lock(csDAGSwap);
+    CDAGRef const previous = atomic_load(&previousDAG);
+    if (previous)
     {
-        auto const previous_epoch = next_dag->epoch();
-        next_dag->unload();
-        next_dag.reset();
-        LogPrint("nrghash", "DAG for epoch %d unloaded\n", previous_epoch);
+        atomic_store(&previousDAG, CDAGRef());
+        UnloadDAG(previous);
     }
+}
+
+void ReleaseDAGs()
+{
+    using namespace std;
 
-    return active;
+    boost::lock_guard<boost::mutex> lock(csDAGSwap);
+    for (CDAGRef* pdag : {&activeDAG, &previousDAG})
+    {
+        CDAGRef const dag = atomic_load(pdag);
+        if (dag)
+        {
+            atomic_store(pdag, CDAGRef());
+            UnloadDAG(dag);
+        }
+    }
 }
@@ -10,15 +10,36 @@
 
 #include <memory>
 
+/** Reference counted handle to a DAG. The DAG stays loaded while a handle to it exists, even after it has been swapped out. */
+typedef std::shared_ptr<const egihash::dag_t> CDAGRef;
+
 /** \brief Get the currently loaded DAG.
 *
 *	Note that this function is both a getter and a setter function.
 *	If no parameters are specified, or operator bool(next_dag) == false, return the currently active DAG
-*	If a valid next_dag is specified, swap the active DAG with next_dag and return the new active DAG (unloads the previous DAG)
+*	If a valid next_dag is specified, swap the active DAG with next_dag and return the new active DAG.
+*	A previously active DAG of another epoch stays resident as the previous DAG until ReleasePreviousDAG() is called,
+*	the DAG which was previous before is unloaded.
+*
+*	Reading the active DAG takes no lock. Hash through the returned handle rather than calling ActiveDAG() again,
+*	the active DAG may be swapped at any time.
 *
 *	\param next_dag (optional) swap the active DAG with next_dag
-*	\returns A unique_ptr to the currently active DAG, or a null unique_ptr if no DAG is active.
+*	\returns A handle to the currently active DAG, or a null handle if no DAG is active.
 */
-std::unique_ptr<egihash::dag_t> const & ActiveDAG(std::unique_ptr<egihash::dag_t> next_dag = std::unique_ptr<egihash::dag_t>());
+CDAGRef ActiveDAG(std::unique_ptr<egihash::dag_t> next_dag = std::unique_ptr<egihash::dag_t>());
+
+/** \brief Get the resident DAG of an epoch.
+*
+*	\param epoch the epoch of the DAG.
+*	\returns A handle to the active or the previous DAG if it is of epoch, or a null handle.
+*/
+CDAGRef ResidentDAG(uint64_t epoch);
+
+/** \brief Unload the previous DAG kept resident since the last swap, if any. */
+void ReleasePreviousDAG();
+
+/** \brief Unload the active and the previous DAG. Hashing falls back to light mode until a DAG is activated again. */
+void ReleaseDAGs();
 
 #endif
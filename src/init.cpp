@@ -34,6 +34,7 @@
 #include "scheduler.h"
 #include "txdb.h"
 #include "txmempool.h"
+#include "stratum.h"
 #include "torcontrol.h"
 #include "ui_interface.h"
 #include "util.h"
@@ -202,6 +203,7 @@ void Interrupt(boost::thread_group& threadGroup)
     InterruptRPC();
     InterruptREST();
     InterruptTorControl();
+    InterruptStratumServer();
     if (g_connman)
         g_connman->Interrupt();
     threadGroup.interrupt_all();
@@ -233,6 +235,10 @@ void PrepareShutdown()
         pwalletMain->Flush(false);
 #endif
     GenerateBitcoins(false, 0, Params(), *g_connman);
+    StopStratumServer();
+    StopPrepareDAG();
+    StopPrefetchEgihashCaches();
+    ReleaseDAGs();
     MapPort(false);
     UnregisterValidationInterface(peerLogic.get());
     peerLogic.reset();
@@ -404,8 +410,19 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-daemon", _("Run in the background as a daemon and accept commands"));
 #endif
     }
+    strUsage += HelpMessageOpt("-dagdir=<dir>", _("Specify the directory of DAG and light cache files, it may be shared by several processes on this host, which then generate each DAG once and share its memory when -dagmmap is enabled (default: <datadir>/dag)"));
+    strUsage += HelpMessageOpt("-dagdirectio", strprintf(_("Write DAG files bypassing the page cache where supported (default: %u)"), DEFAULT_DAGDIRECTIO));
+    strUsage += HelpMessageOpt("-daghugepages=<n>", strprintf(_("Back generated and copied DAGs with huge pages (0 = off, 1 = transparent huge pages, 2 = reserved huge pages, falling back to 1, default: %d)"), DEFAULT_DAGHUGEPAGES));
+    strUsage += HelpMessageOpt("-dagkeepblocks=<n>", strprintf(_("Keep the previous epoch's DAG loaded for <n> blocks after an epoch boundary, for reorgs across it (default: %u)"), DEFAULT_DAG_KEEP_BLOCKS));
+    strUsage += HelpMessageOpt("-dagmmap", strprintf(_("Map DAG and light cache files into memory read-only instead of copying them, sharing their pages with other processes (default: %u)"), DEFAULT_DAGMMAP));
+    strUsage += HelpMessageOpt("-dagnuma=<mode>", _("Place generated and copied DAGs on NUMA nodes: \"interleave\" spreads them over all nodes, a node number binds them to that node (default: placement by the kernel)"));
+    strUsage += HelpMessageOpt("-dagprepareblocks=<n>", strprintf(_("Start preparing the next epoch's DAG in the background <n> blocks before the epoch boundary, 0 to disable (default: %u)"), DEFAULT_DAG_PREPARE_BLOCKS));
+    strUsage += HelpMessageOpt("-dagsync", strprintf(_("Flush written DAG files to disk before using them (default: %u)"), DEFAULT_DAGSYNC));
+    strUsage += HelpMessageOpt("-dagthreads=<n>", strprintf(_("Set the number of threads used to generate the DAG (0 = auto, <0 = leave that many cores free, default: %d)"), DEFAULT_DAGTHREADS));
     strUsage += HelpMessageOpt("-datadir=<dir>", _("Specify data directory"));
     strUsage += HelpMessageOpt("-dbcache=<n>", strprintf(_("Set database cache size in megabytes (%d to %d, default: %d)"), nMinDbCache, nMaxDbCache, nDefaultDbCache));
+    strUsage += HelpMessageOpt("-egihashcacheprefetch=<n>", strprintf(_("Build the egihash light caches of up to <n> upcoming epochs in the background, 0 to disable (default: %u)"), DEFAULT_EGIHASH_CACHE_PREFETCH));
+    strUsage += HelpMessageOpt("-egihashcachemb=<n>", strprintf(_("Keep egihash light caches below <n> megabytes, the current and prefetched epochs are always kept (0 = unlimited, default: %u)"), DEFAULT_EGIHASH_CACHE_MB));
     strUsage += HelpMessageOpt("-loadblock=<file>", _("Imports blocks from external blk000??.dat file on startup"));
     strUsage += HelpMessageOpt("-maxorphantx=<n>", strprintf(_("Keep at most <n> unconnectable transactions in memory (default: %u)"), DEFAULT_MAX_ORPHAN_TRANSACTIONS));
     strUsage += HelpMessageOpt("-maxmempool=<n>", strprintf(_("Keep the transaction memory pool below <n> megabytes (default: %u)"), DEFAULT_MAX_MEMPOOL_SIZE));
@@ -528,6 +545,7 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-checkblocks=<n>", strprintf(_("How many blocks to check at startup (default: %u, 0 = all)"), DEFAULT_CHECKBLOCKS));
         strUsage += HelpMessageOpt("-checklevel=<n>", strprintf(_("How thorough the block verification of -checkblocks is (0-4, default: %u)"), DEFAULT_CHECKLEVEL));
         strUsage += HelpMessageOpt("-checkblockindex", strprintf("Do a full consistency check for mapBlockIndex, setBlockIndexCandidates, chainActive and mapBlocksUnlinked occasionally. Also sets -checkmempool (default: %u)", Params(CBaseChainParams::MAIN).DefaultConsistencyChecks()));
+        strUsage += HelpMessageOpt("-checkpowonload=<n>", strprintf(_("How thoroughly the proof-of-work of block headers is re-verified at startup (0 = only headers not verified before, 1 = also sample 1 in %u verified ones, 2 = all recent headers, 3 = all headers, default: %u)"), CHECKPOWONLOAD_SAMPLE_RATE, DEFAULT_CHECKPOWONLOAD));
         strUsage += HelpMessageOpt("-checkmempool=<n>", strprintf("Run checks every <n> transactions (default: %u)", Params(CBaseChainParams::MAIN).DefaultConsistencyChecks()));
         strUsage += HelpMessageOpt("-checkpoints", strprintf("Disable expensive verification for known chain history (default: %u)", DEFAULT_CHECKPOINTS_ENABLED));
 #ifdef ENABLE_WALLET
@@ -546,7 +564,7 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-limitdescendantcount=<n>", strprintf("Do not accept transactions if any ancestor would have <n> or more in-mempool descendants (default: %u)", DEFAULT_DESCENDANT_LIMIT));
         strUsage += HelpMessageOpt("-limitdescendantsize=<n>", strprintf("Do not accept transactions if any ancestor would have more than <n> kilobytes of in-mempool descendants (default: %u).", DEFAULT_DESCENDANT_SIZE_LIMIT));
     }
-    string debugCategories = "addrman, alert, bench, coindb, db, http, libevent, lock, mempool, mempoolrej, net, proxy, prune, rand, reindex, rpc, selectcoins, tor, zmq, "
+    string debugCategories = "addrman, alert, bench, coindb, db, http, libevent, lock, mempool, mempoolrej, net, proxy, prune, rand, reindex, rpc, selectcoins, stratum, tor, zmq, "
                              "energi (or specifically: gobject, instantsend, keepass, masternode, mnpayments, mnsync, privatesend, spork)"; // Don't translate these and qt below
     if (mode == HMM_BITCOIN_QT)
         debugCategories += ", qt";
@@ -617,6 +635,11 @@ std::string HelpMessage(HelpMessageMode mode)
     if (showDebug)
         strUsage += HelpMessageOpt("-blockversion=<n>", "Override block version to test forking scenarios");
 
+    strUsage += HelpMessageGroup(_("Stratum server options:"));
+    strUsage += HelpMessageOpt("-stratumport=<port>", _("Serve work to external miners with the Stratum protocol on <port> (default: disabled)"));
+    strUsage += HelpMessageOpt("-stratumbind=<addr>", strprintf(_("Bind the Stratum server to the given address, it has no authentication (default: %s)"), DEFAULT_STRATUM_BIND));
+    strUsage += HelpMessageOpt("-stratumaddress=<addr>", _("Pay blocks found by Stratum miners to <addr> (default: a new wallet address)"));
+
     strUsage += HelpMessageGroup(_("RPC server options:"));
     strUsage += HelpMessageOpt("-server", _("Accept command line and JSON-RPC commands"));
     strUsage += HelpMessageOpt("-rest", strprintf(_("Accept public REST requests (default: %u)"), DEFAULT_REST_ENABLE));
@@ -1274,6 +1297,9 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
             return InitError(_("Unable to sign spork message, wrong key?"));
     }
 
+    // the egihash sizing of the selected chain is final, caches and DAGs are used by other threads from here on
+    egihash::lock_sizing();
+
     // initialize the DAG
     InitDAG([](::std::size_t step, ::std::size_t max, int phase) -> bool
     {
@@ -1317,6 +1343,9 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
             case egihash::dag_loading:
                 progress_handler("Loading Dag ... ");
                 break;
+            case egihash::dag_verification:
+                progress_handler("Verifying Dag ... ");
+                break;
             default:
                 break;
         }
@@ -1326,6 +1355,8 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
 
         return true;
     });
+    // build the light caches of upcoming epochs as new headers and blocks arrive
+    StartPrefetchEgihashCaches();
 
     // Start the lightweight task scheduler thread
     CScheduler::Function serviceLoop = boost::bind(&CScheduler::serviceQueue, &scheduler);
@@ -2102,6 +2133,9 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     if (!connman.Start(scheduler, strNodeError, connOptions))
         return InitError(strNodeError);
 
+    if (!StartStratumServer(chainparams))
+        return InitError(_("Unable to start the Stratum server. See debug log for details."));
+
     // Generate coins in the background
     GenerateBitcoins(GetBoolArg("-gen", DEFAULT_GENERATE), GetArg("-genproclimit", DEFAULT_GENERATE_THREADS), chainparams, connman);
 
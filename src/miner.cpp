@@ -400,14 +400,57 @@ static bool ProcessBlockFound(const CBlock* pblock, const CChainParams& chainpar
     return true;
 }
 
+static CCriticalSection cs_minerStats;
+static std::vector<CMinerThreadStats> vMinerStats;
+
+std::vector<CMinerThreadStats> GetMinerThreadStats()
+{
+    LOCK(cs_minerStats);
+    return vMinerStats;
+}
+
+/** Accounts the hashes of one miner thread and publishes a rolling rate every MINER_HASHRATE_INTERVAL */
+class CMinerHashMeter
+{
+private:
+    const size_t nThread;
+    int64_t nIntervalStart;
+    uint64_t nIntervalHashes;
+
+public:
+    explicit CMinerHashMeter(size_t nThreadIn) : nThread(nThreadIn), nIntervalStart(GetTimeMillis()), nIntervalHashes(0) {}
+
+    void Add(uint64_t nHashes)
+    {
+        nIntervalHashes += nHashes;
+        int64_t const nNow = GetTimeMillis();
+        int64_t const nElapsed = nNow - nIntervalStart;
+
+        LOCK(cs_minerStats);
+        if (nThread >= vMinerStats.size())
+            return;
+        CMinerThreadStats& stats = vMinerStats[nThread];
+        stats.nHashes += nHashes;
+        if (nElapsed >= MINER_HASHRATE_INTERVAL) {
+            stats.dHashesPerSec = 1000.0 * nIntervalHashes / nElapsed;
+            nIntervalStart = nNow;
+            nIntervalHashes = 0;
+        }
+    }
+};
+
 // ***TODO*** that part changed in bitcoin, we are using a mix with old one here for now
-void static BitcoinMiner(const CChainParams& chainparams, CConnman& connman)
+void static BitcoinMiner(const CChainParams& chainparams, CConnman& connman, size_t nThread)
 {
     LogPrintf("EnergiMiner -- started\n");
     SetThreadPriority(THREAD_PRIORITY_LOWEST);
     RenameThread("energi-miner");
 
     unsigned int nExtraNonce = 0;
+    // every thread searches its own part of the 64 bit nonce space, so threads working on the
+    // same block template never repeat each other's work
+    uint64_t const nNonceStart = static_cast<uint64_t>(nThread) << 32;
+    CMinerHashMeter meter(nThread);
 
     boost::shared_ptr<CReserveScript> coinbaseScript;
     GetMainSignals().ScriptForMining(coinbaseScript);
@@ -447,6 +490,7 @@ void static BitcoinMiner(const CChainParams& chainparams, CConnman& connman)
             }
             CBlock *pblock = &pblocktemplate->block;
             IncrementExtraNonce(pblock, pindexPrev, nExtraNonce);
+            pblock->nNonce = nNonceStart;
 
             LogPrintf("EnergiMiner -- Running miner with %u transactions in block (%u bytes)\n", pblock->vtx.size(),
                 ::GetSerializeSize(*pblock, SER_NETWORK, PROTOCOL_VERSION));
@@ -458,32 +502,27 @@ void static BitcoinMiner(const CChainParams& chainparams, CConnman& connman)
             arith_uint256 hashTarget = arith_uint256().SetCompact(pblock->nBits);
             while (true)
             {
-                unsigned int nHashesDone = 0;
-
+                // scan up to the next multiple of 256 nonces, then check whether to stop or rebuild the block
+                uint64_t const nCount = 0x100 - (pblock->nNonce & 0xFF);
+                uint64_t const nNonceBefore = pblock->nNonce;
                 uint256 hash;
-                while (true)
+                bool const fFound = pblock->SearchPOW(nCount, ArithToUint256(hashTarget), hash);
+                meter.Add(fFound ? pblock->nNonce - nNonceBefore + 1 : nCount);
+                if (fFound)
                 {
-                    hash = pblock->GetPOWHash();
-                    if (UintToArith256(hash) <= hashTarget)
-                    {
-                        // Found a solution
-                        SetThreadPriority(THREAD_PRIORITY_NORMAL);
-                        LogPrintf("EnergiMiner:\n  proof-of-work found\n  hash: %s\n  mixhash: %s\n  target: %s\n", hash.GetHex(), pblock->hashMix.GetHex(), hashTarget.GetHex());
-                        ProcessBlockFound(pblock, chainparams);
-                        SetThreadPriority(THREAD_PRIORITY_LOWEST);
-                        coinbaseScript->KeepScript();
-
-                        // In regression test mode, stop mining after a block is found. This
-                        // allows developers to controllably generate a block on demand.
-                        if (chainparams.MineBlocksOnDemand())
-                            throw boost::thread_interrupted();
+                    // Found a solution
+                    SetThreadPriority(THREAD_PRIORITY_NORMAL);
+                    LogPrintf("EnergiMiner:\n  proof-of-work found\n  hash: %s\n  mixhash: %s\n  target: %s\n", hash.GetHex(), pblock->hashMix.GetHex(), hashTarget.GetHex());
+                    ProcessBlockFound(pblock, chainparams);
+                    SetThreadPriority(THREAD_PRIORITY_LOWEST);
+                    coinbaseScript->KeepScript();
+
+                    // In regression test mode, stop mining after a block is found. This
+                    // allows developers to controllably generate a block on demand.
+                    if (chainparams.MineBlocksOnDemand())
+                        throw boost::thread_interrupted();
 
-                        break;
-                    }
-                    pblock->nNonce += 1;
-                    nHashesDone += 1;
-                    if ((pblock->nNonce & 0xFF) == 0)
-                        break;
+                    break;
                 }
 
                 // Check for stop or if block needs to be rebuilt
@@ -491,7 +530,7 @@ void static BitcoinMiner(const CChainParams& chainparams, CConnman& connman)
                 // Regtest mode doesn't require peers
                 if (connman.GetNodeCount(CConnman::CONNECTIONS_ALL) == 0 && chainparams.MiningRequiresPeers())
                     break;
-                if (pblock->nNonce >= 0xffff0000)
+                if (pblock->nNonce - nNonceStart >= 0xffff0000)
                     break;
                 if (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - nStart > 60)
                     break;
@@ -536,10 +575,20 @@ void GenerateBitcoins(bool fGenerate, int nThreads, const CChainParams& chainpar
         minerThreads = NULL;
     }
 
+    {
+        LOCK(cs_minerStats);
+        vMinerStats.clear();
+    }
+
     if (nThreads == 0 || !fGenerate)
         return;
 
+    {
+        LOCK(cs_minerStats);
+        vMinerStats.assign(nThreads, CMinerThreadStats{0, 0.0});
+    }
+
     minerThreads = new boost::thread_group();
     for (int i = 0; i < nThreads; i++)
-        minerThreads->create_thread(boost::bind(&BitcoinMiner, boost::cref(chainparams), boost::ref(connman)));
+        minerThreads->create_thread(boost::bind(&BitcoinMiner, boost::cref(chainparams), boost::ref(connman), i));
 }
@@ -9,6 +9,7 @@
 #include "primitives/block.h"
 
 #include <stdint.h>
+#include <vector>
 
 class CBlockIndex;
 class CChainParams;
@@ -23,6 +24,18 @@ static const int DEFAULT_GENERATE_THREADS = 1;
 
 static const bool DEFAULT_PRINTPRIORITY = false;
 
+/** Interval in milliseconds over which the hash rate of a miner thread is measured */
+static const int64_t MINER_HASHRATE_INTERVAL = 5000;
+
+/** Hashing progress of one miner thread */
+struct CMinerThreadStats
+{
+    //! hashes computed since the thread was started
+    uint64_t nHashes;
+    //! hash rate over the last completed measurement interval
+    double dHashesPerSec;
+};
+
 struct CBlockTemplate
 {
     CBlock block;
@@ -32,6 +45,8 @@ struct CBlockTemplate
 
 /** Run the miner threads */
 void GenerateBitcoins(bool fGenerate, int nThreads, const CChainParams& chainparams, CConnman& connman);
+/** Get the hashing progress of the running miner threads, indexed by thread */
+std::vector<CMinerThreadStats> GetMinerThreadStats();
 /** Generate a new block, without valid proof-of-work */
 CBlockTemplate* CreateNewBlock(const CChainParams& chainparams, const CScript& scriptPubKeyIn);
 /** Modify the extranonce in a block */
@@ -11,9 +11,15 @@
 #include "crypto/common.h"
 #include "compat/endian.h"
 #include "dag_singleton.h"
+#include "crypto/sha256.h"
+#include "random.h"
 #include "util.h"
 
 #include <algorithm>
+#include <atomic>
+
+#include <boost/thread.hpp>
+#include <boost/unordered_map.hpp>
 
 namespace
 {
@@ -68,45 +74,218 @@ namespace
     #pragma pack(pop)
 }
 
-uint256 CBlockHeader::GetPOWHash()
+namespace
 {
-    CBlockHeaderTruncatedLE truncatedBlockHeader(*this);
-    egihash::h256_t headerHash(&truncatedBlockHeader, sizeof(truncatedBlockHeader));
-    egihash::result_t ret;
-    // if we have a DAG loaded, use it
-    auto const & dag = ActiveDAG();
-    if (dag && ((nHeight / egihash::constants::EPOCH_LENGTH) == dag->epoch()))
+    egihash::h256_t ComputeHeaderHash(CBlockHeader const & header)
     {
-        ret = egihash::full::hash(*dag, headerHash, nNonce);
+        CBlockHeaderTruncatedLE truncatedBlockHeader(header);
+        return egihash::h256_t(&truncatedBlockHeader, sizeof(truncatedBlockHeader));
     }
-    else // otherwise all we can do is generate a light hash
+
+    egihash::result_t ComputeEgihash(CBlockHeader const & header, CDAGRef const & dag)
     {
-        // TODO: pre-load caches and seed hashes
-        ret = egihash::light::hash(egihash::cache_t(nHeight), headerHash, nNonce);
+        egihash::h256_t const headerHash(ComputeHeaderHash(header));
+        // if we have a DAG loaded, use it. The handle keeps it loaded while it is used
+        if (dag && (egihash::get_epoch(header.nHeight) == dag->epoch()))
+        {
+            return egihash::full::hash(*dag, headerHash, header.nNonce);
+        }
+
+        // otherwise all we can do is generate a light hash
+        // TODO: pre-load caches
+        return egihash::light::hash(egihash::cache_t(header.nHeight), headerHash, header.nNonce);
     }
+}
+
+namespace
+{
+    /**
+     * Entries are SHA256(nonce || block hash || egihash sizing), so the hash table needs no
+     * extra blinding against headers crafted to collide.
+     */
+    class CPOWCacheHasher
+    {
+    public:
+        size_t operator()(const uint256& key) const {
+            return key.GetCheapHash();
+        }
+    };
+
+    /**
+     * Proof-of-work results of recently checked headers, to avoid running egihash again
+     * when the same header is checked as part of its HEADERS message, its block and
+     * the block's connection. The block hash commits to nNonce and hashMix, so a cached
+     * result always belongs to exactly one header. The egihash sizing of the selected
+     * network is part of the key, results hashed for another network are never returned.
+     */
+    class CPOWCache
+    {
+    public:
+        struct CEntry
+        {
+            uint256 hashPOW;
+            uint256 hashMix;
+        };
+
+    private:
+        uint256 nonce;
+        typedef boost::unordered_map<uint256, CEntry, CPOWCacheHasher> map_type;
+        map_type mapResults;
+        boost::shared_mutex cs_powcache;
+        std::atomic<uint64_t> nHits;
+        std::atomic<uint64_t> nMisses;
+
+    public:
+        CPOWCache() : nHits(0), nMisses(0)
+        {
+            GetRandBytes(nonce.begin(), 32);
+        }
+
+        uint256 ComputeKey(const CBlockHeader& header) const
+        {
+            egihash::sizing_t const & sizing = egihash::get_sizing();
+            unsigned char vchSizing[5 * 8];
+            WriteLE64(vchSizing, sizing.epoch_length);
+            WriteLE64(vchSizing + 8, sizing.cache_bytes_init);
+            WriteLE64(vchSizing + 16, sizing.cache_bytes_growth);
+            WriteLE64(vchSizing + 24, sizing.dataset_bytes_init);
+            WriteLE64(vchSizing + 32, sizing.dataset_bytes_growth);
+
+            uint256 key;
+            uint256 const hash = header.GetHash();
+            CSHA256().Write(nonce.begin(), 32).Write(hash.begin(), 32).Write(vchSizing, sizeof(vchSizing)).Finalize(key.begin());
+            return key;
+        }
 
+        bool Get(const uint256& key, CEntry& entry)
+        {
+            boost::shared_lock<boost::shared_mutex> lock(cs_powcache);
+            map_type::const_iterator it = mapResults.find(key);
+            if (it == mapResults.end()) {
+                nMisses++;
+                return false;
+            }
+            nHits++;
+            entry = it->second;
+            return true;
+        }
+
+        void Set(const uint256& key, const CEntry& entry)
+        {
+            boost::unique_lock<boost::shared_mutex> lock(cs_powcache);
+            while (mapResults.size() >= MAX_POW_CACHE_ENTRIES)
+            {
+                map_type::size_type s = GetRand(mapResults.bucket_count());
+                map_type::local_iterator it = mapResults.begin(s);
+                if (it != mapResults.end(s)) {
+                    mapResults.erase(it->first);
+                }
+            }
+            mapResults.insert(std::make_pair(key, entry));
+        }
+
+        CPOWCacheStats GetStats()
+        {
+            boost::shared_lock<boost::shared_mutex> lock(cs_powcache);
+            CPOWCacheStats stats;
+            stats.nHits = nHits;
+            stats.nMisses = nMisses;
+            stats.nEntries = mapResults.size();
+            return stats;
+        }
+    };
+
+    CPOWCache& GetPOWCache()
+    {
+        static CPOWCache powCache;
+        return powCache;
+    }
+}
+
+uint256 CBlockHeader::GetPOWHash()
+{
+    // miners call this for every nonce with a stale hashMix, so only look up here
+    // rather than filling the cache with results that will never be asked for again
+    CPOWCache::CEntry entry;
+    if (GetPOWCache().Get(GetPOWCache().ComputeKey(*this), entry)) {
+        hashMix = entry.hashMix;
+        return entry.hashPOW;
+    }
+
+    egihash::result_t const ret = ComputeEgihash(*this, ResidentDAG(egihash::get_epoch(nHeight)));
+    hashMix = uint256(ret.mixhash);
+    return uint256(ret.value);
+}
+
+uint256 CBlockHeader::ComputePOWHash(const CDAGRef& dag)
+{
+    egihash::result_t const ret = ComputeEgihash(*this, dag);
     hashMix = uint256(ret.mixhash);
     return uint256(ret.value);
 }
 
 uint256 CBlockHeader::GetPOWHash() const
 {
-    CBlockHeaderTruncatedLE truncatedBlockHeader(*this);
-    egihash::h256_t headerHash(&truncatedBlockHeader, sizeof(truncatedBlockHeader));
+    return GetPOWHash(ResidentDAG(egihash::get_epoch(nHeight)));
+}
+
+uint256 CBlockHeader::GetPOWHash(const CDAGRef& dag) const
+{
+    CPOWCache& powCache = GetPOWCache();
+    uint256 const key = powCache.ComputeKey(*this);
+    CPOWCache::CEntry entry;
+    if (powCache.Get(key, entry))
+        return entry.hashPOW;
+
+    egihash::result_t const ret = ComputeEgihash(*this, dag);
+    entry.hashPOW = uint256(ret.value);
+    entry.hashMix = uint256(ret.mixhash);
+    powCache.Set(key, entry);
+    return entry.hashPOW;
+}
+
+uint256 CBlockHeader::GetPOWHeaderHash() const
+{
+    return uint256(ComputeHeaderHash(*this));
+}
+
+bool CBlockHeader::SearchPOW(uint64_t nCount, const uint256& hashTarget, uint256& hashPOW)
+{
+    egihash::h256_t const headerHash(ComputeHeaderHash(*this));
+    // egihash hashes are big endian, uint256 stores them reversed
+    egihash::h256_t target;
+    for (size_t i = 0; i < sizeof(target.b); i++)
+    {
+        target.b[i] = hashTarget.begin()[31 - i];
+    }
+
+    uint64_t nSolution = 0;
     egihash::result_t ret;
-    // if we have a DAG loaded, use it
-    auto const & dag = ActiveDAG();
-    if (dag && ((nHeight / egihash::constants::EPOCH_LENGTH) == dag->epoch()))
+    bool fFound = false;
+    auto const dag = ResidentDAG(egihash::get_epoch(nHeight));
+    if (dag)
     {
-        ret = egihash::full::hash(*dag, headerHash, nNonce);
+        fFound = egihash::full::search(*dag, headerHash, nNonce, nCount, target, nSolution, ret);
     }
-    else // otherwise all we can do is generate a light hash
+    else
     {
-        // TODO: pre-load caches and seed hashes
-        ret = egihash::light::hash(egihash::cache_t(nHeight), headerHash, nNonce);
+        fFound = egihash::light::search(egihash::cache_t(nHeight), headerHash, nNonce, nCount, target, nSolution, ret);
     }
 
-    return uint256(ret.value);
+    if (!fFound)
+    {
+        nNonce += nCount;
+        return false;
+    }
+    nNonce = nSolution;
+    hashMix = uint256(ret.mixhash);
+    hashPOW = uint256(ret.value);
+    return true;
+}
+
+CPOWCacheStats GetPOWCacheStats()
+{
+    return GetPOWCache().GetStats();
 }
 
 uint256 CBlockHeader::GetHash() const
@@ -10,6 +10,24 @@
 #include "serialize.h"
 #include "uint256.h"
 
+#include <memory>
+
+namespace egihash { struct dag_t; }
+
+/** Maximum number of proof-of-work results kept by the cache behind CBlockHeader::GetPOWHash() */
+static const unsigned int MAX_POW_CACHE_ENTRIES = 20000;
+
+/** Counters of the proof-of-work result cache */
+struct CPOWCacheStats
+{
+    uint64_t nHits;
+    uint64_t nMisses;
+    uint64_t nEntries;
+};
+
+/** Get the counters of the proof-of-work result cache */
+CPOWCacheStats GetPOWCacheStats();
+
 /** Nodes collect new transactions into a block, hash them into a hash tree,
  * and scan through nonce values to make the block's hash satisfy proof-of-work
  * requirements.  When they solve the proof-of-work, they broadcast the block
@@ -69,15 +87,41 @@ public:
 
     /** GetPOWHash() returns the egihash used to satisfy the proof of work condition.
     *       The first time this is computed, the hashMix is stored.
+    *       Results cached by the const overload are reused.
     */
     uint256 GetPOWHash();
 
     /** GetPOWHash() returns the egihash used to satisfy the proof of work condition.
+    *       Results are cached by block hash, so each header is hashed once.
     */
     uint256 GetPOWHash() const;
 
+    /** GetPOWHash() with a DAG held by the caller, see ResidentDAG(), for hashing without cs_main.
+    *       A light hash is computed if dag is null or of another epoch. Results are cached like
+    *       those of GetPOWHash() const.
+    */
+    uint256 GetPOWHash(const std::shared_ptr<const egihash::dag_t>& dag) const;
+
+    /** ComputePOWHash() computes the egihash with a DAG held by the caller and stores the hashMix,
+    *       like GetPOWHash(dag), without looking up or storing results in the cache. For work
+    *       submitted by miners, which has never been hashed before.
+    */
+    uint256 ComputePOWHash(const std::shared_ptr<const egihash::dag_t>& dag);
+
+    /** SearchPOW() tries the nonces nNonce to nNonce + nCount - 1 for a proof of work hash not above hashTarget.
+    *       The header is hashed once for the whole range. If a solution is found, nNonce and hashMix
+    *       are set to it and its proof of work hash is returned in hashPOW, otherwise nNonce is
+    *       advanced past the range.
+    */
+    bool SearchPOW(uint64_t nCount, const uint256& hashTarget, uint256& hashPOW);
+
     uint256 GetHash() const;
 
+    /** GetPOWHeaderHash() returns the hash of the header without nNonce and hashMix, which egihash
+    *       mixes with the nonce. Like proof of work hashes, GetHex() prints it in egihash byte order.
+    */
+    uint256 GetPOWHeaderHash() const;
+
     uint256 GetHashMix() const
     {
         return hashMix;
@@ -30,6 +30,8 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "setgenerate", 0 },
     { "setgenerate", 1 },
     { "generate", 0 },
+    { "generate", 1 },
+    { "generate", 2 },
     { "getnetworkhashps", 0 },
     { "getnetworkhashps", 1 },
     { "sendtoaddress", 1 },
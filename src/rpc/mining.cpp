@@ -12,6 +12,8 @@
 #include "consensus/params.h"
 #include "consensus/validation.h"
 #include "core_io.h"
+#include "crypto/egihash.h"
+#include "dag_singleton.h"
 #include "init.h"
 #include "validation.h"
 #include "miner.h"
@@ -29,8 +31,15 @@
 
 #include <stdint.h>
 
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+
 #include <boost/assign/list_of.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
 
 #include <univalue.h>
 
@@ -119,20 +128,122 @@ UniValue getgenerate(const UniValue& params, bool fHelp)
     return GetBoolArg("-gen", DEFAULT_GENERATE);
 }
 
+UniValue gethashespersec(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "gethashespersec\n"
+            "\nReturns the hash rate of the internal miner, in total and per thread.\n"
+            "Rates are measured over intervals of " + strprintf("%d", MINER_HASHRATE_INTERVAL / 1000) + " seconds.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"hashespersec\": x.xxx,     (numeric) The total hash rate of all miner threads\n"
+            "  \"hashes\": n,               (numeric) The total number of hashes computed\n"
+            "  \"threads\": [              (array) One entry per miner thread\n"
+            "    {\n"
+            "      \"hashespersec\": x.xxx, (numeric) The hash rate of the thread\n"
+            "      \"hashes\": n            (numeric) The number of hashes computed by the thread\n"
+            "    }\n"
+            "    ,...\n"
+            "  ]\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("gethashespersec", "")
+            + HelpExampleRpc("gethashespersec", "")
+        );
+
+    double dTotalRate = 0;
+    uint64_t nTotalHashes = 0;
+    UniValue threads(UniValue::VARR);
+    for (const CMinerThreadStats& stats : GetMinerThreadStats()) {
+        UniValue thread(UniValue::VOBJ);
+        thread.push_back(Pair("hashespersec", stats.dHashesPerSec));
+        thread.push_back(Pair("hashes", stats.nHashes));
+        threads.push_back(thread);
+        dTotalRate += stats.dHashesPerSec;
+        nTotalHashes += stats.nHashes;
+    }
+
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("hashespersec", dTotalRate));
+    obj.push_back(Pair("hashes", nTotalHashes));
+    obj.push_back(Pair("threads", threads));
+    return obj;
+}
+
+/** Nonces searched at a time by each thread of generate */
+static const uint64_t GENERATE_NONCE_BATCH = 0x100;
+
+/**
+ * Search at most nMaxTries nonces of pblock for a proof of work not above hashTarget, using nThreads
+ * threads that take turns on batches of GENERATE_NONCE_BATCH nonces. The searched nonces are deducted
+ * from nMaxTries. If a solution is found, nNonce and hashMix of pblock are set to it.
+ */
+static bool GenerateSearchPOW(CBlock* pblock, const uint256& hashTarget, uint64_t& nMaxTries, int nThreads)
+{
+    uint64_t const nNonceStart = pblock->nNonce;
+    uint64_t const nBatches = (nMaxTries + GENERATE_NONCE_BATCH - 1) / GENERATE_NONCE_BATCH;
+    std::atomic<uint64_t> nNextBatch(0);
+    std::atomic<bool> fFound(false);
+    std::mutex csFound;
+    CBlockHeader solution;
+
+    auto search = [&]()
+    {
+        CBlockHeader header(*pblock);
+        uint64_t nBatch;
+        while (!fFound && (nBatch = nNextBatch++) < nBatches) {
+            uint64_t const nOffset = nBatch * GENERATE_NONCE_BATCH;
+            header.nNonce = nNonceStart + nOffset;
+            uint256 hashPOW;
+            if (header.SearchPOW((std::min)(GENERATE_NONCE_BATCH, nMaxTries - nOffset), hashTarget, hashPOW)) {
+                std::lock_guard<std::mutex> lock(csFound);
+                // keep the lowest solution, so the result does not depend on the number of threads
+                if (!fFound || header.nNonce < solution.nNonce)
+                    solution = header;
+                fFound = true;
+            }
+        }
+    };
+
+    if (nThreads <= 1 || nBatches <= 1) {
+        search();
+    } else {
+        boost::thread_group threadGroup;
+        for (int i = 0; i < nThreads; i++)
+            threadGroup.create_thread(search);
+        threadGroup.join_all();
+    }
+
+    if (!fFound) {
+        pblock->nNonce = nNonceStart + nMaxTries;
+        nMaxTries = 0;
+        return false;
+    }
+    nMaxTries -= solution.nNonce - nNonceStart + 1;
+    pblock->nNonce = solution.nNonce;
+    pblock->hashMix = solution.hashMix;
+    return true;
+}
+
 UniValue generate(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() < 1 || params.size() > 1)
+    if (fHelp || params.size() < 1 || params.size() > 3)
         throw runtime_error(
-            "generate numblocks\n"
+            "generate numblocks ( maxtries threads )\n"
             "\nMine blocks immediately (before the RPC call returns)\n"
             "\nNote: this function can only be used on the regtest network\n"
             "\nArguments:\n"
             "1. numblocks    (numeric, required) How many blocks are generated immediately.\n"
+            "2. maxtries     (numeric, optional) How many nonces to try for each block before giving up (default = 1000000).\n"
+            "3. threads      (numeric, optional) How many threads search nonces, 0 for one per core (default = 1).\n"
             "\nResult\n"
             "[ blockhashes ]     (array) hashes of blocks generated\n"
             "\nExamples:\n"
             "\nGenerate 11 blocks\n"
             + HelpExampleCli("generate", "11")
+            + "\nGenerate 11 blocks using all cores\n"
+            + HelpExampleCli("generate", "11 1000000 0")
         );
 
     if (!Params().MineBlocksOnDemand())
@@ -142,6 +253,20 @@ UniValue generate(const UniValue& params, bool fHelp)
     int nHeightEnd = 0;
     int nHeight = 0;
     int nGenerate = params[0].get_int();
+    int64_t nMaxTries = 1000000;
+    if (params.size() > 1) {
+        nMaxTries = params[1].get_int64();
+        if (nMaxTries < 0)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "maxtries must not be negative");
+    }
+    int nThreads = 1;
+    if (params.size() > 2) {
+        nThreads = params[2].get_int();
+        if (nThreads < 0)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "threads must not be negative");
+        if (nThreads == 0)
+            nThreads = GetNumCores();
+    }
 
     boost::shared_ptr<CReserveScript> coinbaseScript;
     GetMainSignals().ScriptForMining(coinbaseScript);
@@ -172,11 +297,10 @@ UniValue generate(const UniValue& params, bool fHelp)
             LOCK(cs_main);
             IncrementExtraNonce(pblock, chainActive.Tip(), nExtraNonce);
         }
-        while (!CheckProofOfWork(pblock->GetPOWHash(), pblock->nBits, Params().GetConsensus())) {
-            // Yes, there is a chance every nonce could fail to satisfy the -regtest
-            // target -- 1 in 2^(2^32). That ain't gonna happen.
-            ++pblock->nNonce;
-        }
+        uint256 const hashTarget = ArithToUint256(arith_uint256().SetCompact(pblock->nBits));
+        uint64_t nTries = nMaxTries;
+        if (!GenerateSearchPOW(pblock, hashTarget, nTries, nThreads))
+            break;
         if (!ProcessNewBlock(Params(), pblock, true, NULL, NULL))
             throw JSONRPCError(RPC_INTERNAL_ERROR, "ProcessNewBlock, block not accepted");
         ++nHeight;
@@ -247,9 +371,15 @@ UniValue getmininginfo(const UniValue& params, bool fHelp)
             "  \"errors\": \"...\"          (string) Current errors\n"
             "  \"generate\": true|false     (boolean) If the generation is on or off (see getgenerate or setgenerate calls)\n"
             "  \"genproclimit\": n          (numeric) The processor limit for generation. -1 if no generation. (see getgenerate or setgenerate calls)\n"
+            "  \"hashespersec\": x.xxx      (numeric) The hash rate of the internal miner (see gethashespersec for the rate per thread)\n"
             "  \"pooledtx\": n              (numeric) The size of the mem pool\n"
             "  \"testnet\": true|false      (boolean) If using testnet or not\n"
             "  \"chain\": \"xxxx\",         (string) current network name as defined in BIP70 (main, test, regtest)\n"
+            "  \"powcache\": {            (json object) proof-of-work result cache\n"
+            "     \"hits\": n,             (numeric) lookups answered from the cache\n"
+            "     \"misses\": n,           (numeric) lookups which had to run egihash\n"
+            "     \"entries\": n           (numeric) number of cached results\n"
+            "  }\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getmininginfo", "")
@@ -266,11 +396,19 @@ UniValue getmininginfo(const UniValue& params, bool fHelp)
     obj.push_back(Pair("difficulty",       (double)GetDifficulty()));
     obj.push_back(Pair("errors",           GetWarnings("statusbar")));
     obj.push_back(Pair("genproclimit",     (int)GetArg("-genproclimit", DEFAULT_GENERATE_THREADS)));
+    obj.push_back(Pair("hashespersec",     gethashespersec(params, false)["hashespersec"]));
     obj.push_back(Pair("networkhashps",    getnetworkhashps(params, false)));
     obj.push_back(Pair("pooledtx",         (uint64_t)mempool.size()));
     obj.push_back(Pair("testnet",          Params().TestnetToBeDeprecatedFieldRPC()));
     obj.push_back(Pair("chain",            Params().NetworkIDString()));
     obj.push_back(Pair("generate",         getgenerate(params, false)));
+
+    CPOWCacheStats const powCacheStats = GetPOWCacheStats();
+    UniValue powCache(UniValue::VOBJ);
+    powCache.push_back(Pair("hits",        powCacheStats.nHits));
+    powCache.push_back(Pair("misses",      powCacheStats.nMisses));
+    powCache.push_back(Pair("entries",     powCacheStats.nEntries));
+    obj.push_back(Pair("powcache",         powCache));
     return obj;
 }
 
@@ -827,6 +965,200 @@ UniValue submitblock(const UniValue& params, bool fHelp)
     return BIP22ValidationResult(sc.state);
 }
 
+/** Work handed out by getwork, kept until the tip changes so submitwork can rebuild the block */
+struct CGetWork
+{
+    std::shared_ptr<CBlock> pblock;
+    CDAGRef dag; //!< the DAG submitted work is checked against, taken under cs_main with the block
+};
+static const unsigned int MAX_GETWORK_JOBS = 16;
+static CCriticalSection cs_getwork;
+static std::map<uint256, CGetWork> mapGetWork;
+static std::deque<uint256> vGetWork;
+static boost::shared_ptr<CReserveScript> getworkCoinbaseScript;
+
+UniValue getwork(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() > 1)
+        throw runtime_error(
+            "getwork ( \"address\" )\n"
+            "\nReturns pre-hashed egihash work, so miners do not need to build or hash the block header themselves.\n"
+            "The block is kept by the node and completed with submitwork. A new block is created when the tip changes,\n"
+            "or when transactions were added to the mempool and the current work is older than 5 seconds.\n"
+            "\nArguments:\n"
+            "1. \"address\"    (string, optional) The address paid by the coinbase, the default is a wallet address\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"headerhash\" : \"hash\",  (string) The hash of the header without nonce and mix hash\n"
+            "  \"seedhash\" : \"hash\",    (string) The seedhash of the epoch, which identifies the DAG\n"
+            "  \"target\" : \"hash\",      (string) The boundary the proof of work hash must not exceed\n"
+            "  \"height\" : n,           (numeric) The height of the block\n"
+            "  \"epoch\" : n,            (numeric) The egihash epoch of the block\n"
+            "  \"datasetsize\" : n,      (numeric) The size of the DAG in bytes\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getwork", "")
+            + HelpExampleRpc("getwork", "")
+        );
+
+    LOCK2(cs_main, cs_getwork);
+
+    if (Params().NetworkIDString() != CBaseChainParams::REGTEST)
+    {
+        if(!g_connman)
+            throw JSONRPCError(RPC_CLIENT_P2P_DISABLED, "Error: Peer-to-peer functionality missing or disabled");
+
+        if (g_connman->GetNodeCount(CConnman::CONNECTIONS_ALL) == 0)
+            throw JSONRPCError(RPC_CLIENT_NOT_CONNECTED, "Energi Core is not connected!");
+
+        if (IsInitialBlockDownload())
+            throw JSONRPCError(RPC_CLIENT_IN_INITIAL_DOWNLOAD, "Energi Core is downloading blocks...");
+
+        if (!masternodeSync.IsSynced())
+            throw JSONRPCError(RPC_CLIENT_IN_INITIAL_DOWNLOAD, "Energi Core is syncing with network...");
+    }
+
+    CScript scriptPubKey;
+    if (params.size() > 0) {
+        CBitcoinAddress address(params[0].get_str());
+        if (!address.IsValid())
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid Energi address");
+        scriptPubKey = GetScriptForDestination(address.Get());
+    } else {
+        if (!getworkCoinbaseScript)
+            GetMainSignals().ScriptForMining(getworkCoinbaseScript);
+
+        // If the keypool is exhausted, no script is returned at all.  Catch this.
+        if (!getworkCoinbaseScript)
+            throw JSONRPCError(RPC_WALLET_KEYPOOL_RAN_OUT, "Error: Keypool ran out, please call keypoolrefill first");
+        if (getworkCoinbaseScript->reserveScript.empty())
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "No coinbase script available (mining requires a wallet or an address)");
+        scriptPubKey = getworkCoinbaseScript->reserveScript;
+    }
+
+    // Update block
+    static CBlockIndex* pindexPrev;
+    static int64_t nStart;
+    static unsigned int nTransactionsUpdatedLast;
+    static CScript scriptPubKeyLast;
+    static unsigned int nExtraNonce;
+    if (pindexPrev != chainActive.Tip() || scriptPubKey != scriptPubKeyLast ||
+        (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - nStart > 5))
+    {
+        // Work for an old tip can never become a block
+        if (pindexPrev != chainActive.Tip()) {
+            mapGetWork.clear();
+            vGetWork.clear();
+        }
+
+        // Clear pindexPrev so future calls make a new block, despite any failures from here on
+        pindexPrev = NULL;
+
+        nTransactionsUpdatedLast = mempool.GetTransactionsUpdated();
+        CBlockIndex* pindexPrevNew = chainActive.Tip();
+        nStart = GetTime();
+
+        std::unique_ptr<CBlockTemplate> pblocktemplate(CreateNewBlock(Params(), scriptPubKey));
+        if (!pblocktemplate)
+            throw JSONRPCError(RPC_OUT_OF_MEMORY, "Out of memory");
+        CGetWork work;
+        work.pblock = std::make_shared<CBlock>(pblocktemplate->block);
+        IncrementExtraNonce(work.pblock.get(), pindexPrevNew, nExtraNonce);
+        work.dag = ResidentDAG(egihash::get_epoch(work.pblock->nHeight));
+
+        uint256 const hashHeader = work.pblock->GetPOWHeaderHash();
+        mapGetWork[hashHeader] = work;
+        vGetWork.push_back(hashHeader);
+        while (vGetWork.size() > MAX_GETWORK_JOBS) {
+            mapGetWork.erase(vGetWork.front());
+            vGetWork.pop_front();
+        }
+
+        // Need to update only after we know CreateNewBlock succeeded
+        pindexPrev = pindexPrevNew;
+        scriptPubKeyLast = scriptPubKey;
+    }
+    const CBlock& block = *mapGetWork[vGetWork.back()].pblock;
+    arith_uint256 const hashTarget = arith_uint256().SetCompact(block.nBits);
+
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("headerhash", vGetWork.back().GetHex()));
+    result.push_back(Pair("seedhash", egihash::cache_t::get_seedhash(block.nHeight).to_hex()));
+    result.push_back(Pair("target", hashTarget.GetHex()));
+    result.push_back(Pair("height", (int64_t)block.nHeight));
+    result.push_back(Pair("epoch", (int64_t)egihash::get_epoch(block.nHeight)));
+    result.push_back(Pair("datasetsize", (uint64_t)egihash::dag_t::get_full_size(block.nHeight)));
+    return result;
+}
+
+UniValue submitwork(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 3)
+        throw runtime_error(
+            "submitwork \"nonce\" \"headerhash\" \"mixhash\"\n"
+            "\nCompletes the block of work returned by getwork and submits it to the network.\n"
+            "\nArguments\n"
+            "1. \"nonce\"        (string, required) The hex encoded 64 bit nonce\n"
+            "2. \"headerhash\"   (string, required) The headerhash of the work, as returned by getwork\n"
+            "3. \"mixhash\"      (string, required) The mix hash computed by the miner\n"
+            "\nResult:\n"
+            "null if the block was accepted, otherwise the reason for the rejection as in submitblock\n"
+            "\nExamples:\n"
+            + HelpExampleCli("submitwork", "\"0x0000000000000a2f\" \"headerhash\" \"mixhash\"")
+            + HelpExampleRpc("submitwork", "\"0x0000000000000a2f\", \"headerhash\", \"mixhash\"")
+        );
+
+    std::string strNonce = params[0].get_str();
+    if (strNonce.compare(0, 2, "0x") == 0)
+        strNonce = strNonce.substr(2);
+    if (strNonce.empty() || strNonce.size() > 16 || !IsHex(std::string(strNonce.size() % 2, '0') + strNonce))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid nonce");
+    uint256 const hashHeader = ParseHashV(params[1], "headerhash");
+    uint256 const hashMix = ParseHashV(params[2], "mixhash");
+
+    CBlock block;
+    CDAGRef dag;
+    {
+        LOCK(cs_getwork);
+        auto const it = mapGetWork.find(hashHeader);
+        if (it == mapGetWork.end())
+            return "unknown-work";
+        block = *it->second.pblock;
+        dag = it->second.dag;
+    }
+
+    // the hash is computed with the full DAG pinned by the work when there is one, a light hash otherwise,
+    // submitted work is new so the proof-of-work result cache is not consulted
+    block.nNonce = strtoull(strNonce.c_str(), NULL, 16);
+    uint256 const hashPOW = block.ComputePOWHash(dag);
+    if (block.hashMix != hashMix)
+        return "bad-mixhash";
+    if (!CheckProofOfWork(hashPOW, block.nBits, Params().GetConsensus()))
+        return "high-hash";
+    {
+        LOCK(cs_main);
+        if (block.hashPrevBlock != chainActive.Tip()->GetBlockHash())
+            return "stale-prevblk";
+    }
+
+    GetMainSignals().BlockFound(block.GetHash());
+
+    submitblock_StateCatcher sc(block.GetHash());
+    RegisterValidationInterface(&sc);
+    ProcessNewBlock(Params(), &block, true, NULL, NULL);
+    UnregisterValidationInterface(&sc);
+    if (!sc.found)
+        return "inconclusive";
+    UniValue result = BIP22ValidationResult(sc.state);
+    if (result.isNull()) {
+        LOCK(cs_getwork);
+        // mark script as important because it was used at least for one coinbase output
+        if (getworkCoinbaseScript)
+            getworkCoinbaseScript->KeepScript();
+    }
+    return result;
+}
+
 UniValue estimatefee(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 1)
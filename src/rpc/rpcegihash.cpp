@@ -11,7 +11,7 @@ UniValue getepoch(const UniValue& params, bool fHelp)
         throw std::runtime_error("getepoch\n"
                                  "\nReturns current epoch number");
     }
-    return static_cast<int>(chainActive.Height() / constants::EPOCH_LENGTH);
+    return static_cast<int>(get_epoch(chainActive.Height()));
 }
 
 UniValue getseedhash(const UniValue& params, bool fHelp)
@@ -24,7 +24,7 @@ UniValue getseedhash(const UniValue& params, bool fHelp)
     }
     int epoch = 0;
     if (params[0].isNull()) {
-        epoch = static_cast<int>(chainActive.Height() / constants::EPOCH_LENGTH);
+        epoch = static_cast<int>(get_epoch(chainActive.Height()));
     } else {
         try {
             epoch = std::stoi(params[0].get_str());
@@ -32,7 +32,7 @@ UniValue getseedhash(const UniValue& params, bool fHelp)
             throw std::runtime_error("provided argument \'" + params[0].get_str() + "\' is not an integer");
         }
     }
-    return cache_t::get_seedhash(epoch * constants::EPOCH_LENGTH).to_hex();
+    return cache_t::get_seedhash(epoch * get_sizing().epoch_length).to_hex();
 }
 
 UniValue getdagsize(const UniValue& params, bool fHelp)
@@ -45,7 +45,7 @@ UniValue getdagsize(const UniValue& params, bool fHelp)
     }
     int epoch = 0;
     if (params[0].isNull()) {
-        epoch = static_cast<int>(chainActive.Height() / constants::EPOCH_LENGTH);
+        epoch = static_cast<int>(get_epoch(chainActive.Height()));
     } else {
         try {
             epoch = std::stoi(params[0].get_str());
@@ -53,7 +53,7 @@ UniValue getdagsize(const UniValue& params, bool fHelp)
             throw std::runtime_error("provided argument \'" + params[0].get_str() + "\' is not an integer");
         }
     }
-    return static_cast<uint64_t>(dag_t::get_full_size(epoch * constants::EPOCH_LENGTH));
+    return static_cast<uint64_t>(dag_t::get_full_size(epoch * get_sizing().epoch_length));
 }
 
 UniValue getdagcachesize(const UniValue& params, bool fHelp)
@@ -66,7 +66,7 @@ UniValue getdagcachesize(const UniValue& params, bool fHelp)
     }
     int epoch = 0;
     if (params[0].isNull()) {
-        epoch = static_cast<int>(chainActive.Height() / constants::EPOCH_LENGTH);
+        epoch = static_cast<int>(get_epoch(chainActive.Height()));
     } else {
         try {
             epoch = std::stoi(params[0].get_str());
@@ -74,7 +74,7 @@ UniValue getdagcachesize(const UniValue& params, bool fHelp)
             throw std::runtime_error("provided argument \'" + params[0].get_str() + "\' is not an integer");
         }
     }
-    return cache_t::get_cache_size(epoch * constants::EPOCH_LENGTH);
+    return cache_t::get_cache_size(epoch * get_sizing().epoch_length);
 }
 
 UniValue getdag(const UniValue& params, bool fHelp)
@@ -88,7 +88,7 @@ UniValue getdag(const UniValue& params, bool fHelp)
     UniValue result(UniValue::VOBJ);
     int epoch = 0;
     if (params[0].isNull()) {
-        epoch = static_cast<int>(chainActive.Height() / constants::EPOCH_LENGTH);
+        epoch = static_cast<int>(get_epoch(chainActive.Height()));
     } else {
         try {
             epoch = std::stoi(params[0].get_str());
@@ -96,7 +96,7 @@ UniValue getdag(const UniValue& params, bool fHelp)
             throw std::runtime_error("provided argument \'" + params[0].get_str() + "\' is not an integer");
         }
     }
-    auto block_num = epoch * constants::EPOCH_LENGTH;
+    auto block_num = epoch * get_sizing().epoch_length;
     result.push_back(Pair("epoch", epoch));
     result.push_back(Pair("seedhash", cache_t::get_seedhash(block_num).to_hex()));
     result.push_back(Pair("size", static_cast<uint64_t>(dag_t::get_full_size(block_num))));
@@ -110,12 +110,15 @@ UniValue getcache(const UniValue& params, bool fHelp)
         throw std::runtime_error("getcache\n \"epoch\" "
                                  "\nReturns a JSON object specifying DAG cache information for the specified epoch n or the current epoch if n is not specified"
                                  "\nArguments"
-                                 "\n\"epoch\" the epoch number");
+                                 "\n\"epoch\" the epoch number"
+                                 "\nResult"
+                                 "\n\"loaded\" whether the cache of the epoch is loaded"
+                                 "\n\"stats\" counters of the loaded caches: hits, misses, evictions, loaded, loaded_bytes, budget_bytes (0 = unlimited)");
     }
     UniValue result(UniValue::VOBJ);
     int epoch = 0;
     if (params[0].isNull()) {
-        epoch = static_cast<int>(chainActive.Height() / constants::EPOCH_LENGTH);
+        epoch = static_cast<int>(get_epoch(chainActive.Height()));
     } else {
         try {
             epoch = std::stoi(params[0].get_str());
@@ -123,10 +126,21 @@ UniValue getcache(const UniValue& params, bool fHelp)
             throw std::runtime_error("provided argument \'" + params[0].get_str() + "\' is not an integer");
         }
     }
-    auto block_num = epoch * constants::EPOCH_LENGTH;
+    auto block_num = epoch * get_sizing().epoch_length;
     result.push_back(Pair("epoch", epoch));
     result.push_back(Pair("seedhash", cache_t::get_seedhash(block_num).to_hex()));
     result.push_back(Pair("size", cache_t::get_cache_size(block_num)));
+    result.push_back(Pair("loaded", cache_t::is_loaded(epoch)));
+
+    auto const stats = cache_t::get_stats();
+    UniValue statsObj(UniValue::VOBJ);
+    statsObj.push_back(Pair("hits", stats.hits));
+    statsObj.push_back(Pair("misses", stats.misses));
+    statsObj.push_back(Pair("evictions", stats.evictions));
+    statsObj.push_back(Pair("loaded", stats.loaded_count));
+    statsObj.push_back(Pair("loaded_bytes", stats.loaded_bytes));
+    statsObj.push_back(Pair("budget_bytes", stats.budget_bytes));
+    result.push_back(Pair("stats", statsObj));
     return result;
 }
 
@@ -136,14 +150,14 @@ UniValue getactivedag(const UniValue& params, bool fHelp)
         throw std::runtime_error("getactivedag\n"
                                  "\nReturns a JSON list specifying loaded DAG");
     }
-    const auto& dag = ActiveDAG();
-    if (dag == nullptr) {
+    auto const dag = ActiveDAG();
+    if (!dag) {
         throw std::runtime_error("there is no active dag");
     }
     using namespace egihash;
     UniValue result(UniValue::VOBJ);
     result.push_back(Pair("epoch", dag->epoch()));
-    result.push_back(Pair("seedhash", cache_t::get_seedhash(dag->epoch() * constants::EPOCH_LENGTH).to_hex()));
+    result.push_back(Pair("seedhash", cache_t::get_seedhash(dag->epoch() * get_sizing().epoch_length).to_hex()));
     result.push_back(Pair("size", static_cast<uint64_t>(dag->size())));
     return result;
 }
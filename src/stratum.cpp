@@ -0,0 +1,505 @@
+// Copyright (c) 2017 Energi Development Team
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "stratum.h"
+
+#include "arith_uint256.h"
+#include "base58.h"
+#include "chainparams.h"
+#include "crypto/egihash.h"
+#include "dag_singleton.h"
+#include "miner.h"
+#include "netbase.h"
+#include "primitives/block.h"
+#include "rpc/protocol.h"
+#include "script/standard.h"
+#include "txmempool.h"
+#include "util.h"
+#include "utilstrencodings.h"
+#include "validation.h"
+#include "validationinterface.h"
+
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include <event2/buffer.h>
+#include <event2/bufferevent.h>
+#include <event2/event.h>
+#include <event2/listener.h>
+#include <event2/thread.h>
+#include <event2/util.h>
+
+#include <univalue.h>
+
+/** Maximum length of a line received from a Stratum client */
+static const size_t MAX_STRATUM_LINE_LENGTH = 4096;
+/** Number of most recent jobs of the current tip for which work is accepted */
+static const size_t MAX_STRATUM_JOBS = 16;
+/** Minimum number of seconds between jobs that only add mempool transactions */
+static const int64_t STRATUM_MEMPOOL_JOB_INTERVAL = 1;
+
+/**
+ * Stratum server in the style of the eth-proxy protocol: newline delimited JSON-RPC over TCP.
+ *
+ *  eth_submitLogin        log in, the payout address of the node is used regardless of the login
+ *  eth_getWork            returns the current job [header hash, seedhash, target, epoch]
+ *  eth_submitWork         submits [nonce, header hash, mix hash], returns whether a block was found
+ *  eth_submitHashrate     accepted and ignored
+ *
+ * New jobs are pushed to logged in clients as unsolicited replies with id 0.
+ * All client and job state is owned by the event loop thread. Validation signals only
+ * set flags and wake the event loop, so they never wait for block template creation.
+ */
+class CStratumServer : public CValidationInterface
+{
+public:
+    CStratumServer(const CChainParams& chainparams, const CScript& scriptPubKey, boost::shared_ptr<CReserveScript> coinbaseScript);
+    virtual ~CStratumServer();
+
+    bool Listen(const CService& addrBind);
+    void Run();
+    void Interrupt();
+
+protected:
+    // CValidationInterface
+    void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload);
+    void SyncTransaction(const CTransaction &tx, const CBlock *pblock);
+
+private:
+    struct CClient
+    {
+        struct bufferevent* bev;
+        std::string strAddr;
+        bool fLoggedIn;
+    };
+
+    const CChainParams& chainparams;
+    CScript scriptPubKey;
+    boost::shared_ptr<CReserveScript> coinbaseScript;
+
+    struct event_base* base;
+    struct evconnlistener* listener;
+    struct event* evUpdate;
+
+    std::atomic<bool> fTipChanged;
+    std::atomic<bool> fMempoolChanged;
+
+    /** A block template handed out as work, with the DAG its shares are checked against */
+    struct CJob
+    {
+        std::shared_ptr<CBlock> pblock;
+        CDAGRef dag;
+    };
+
+    std::map<struct bufferevent*, CClient> mapClients;
+    std::map<uint256, CJob> mapJobs;
+    std::deque<uint256> vJobs;
+    unsigned int nExtraNonce;
+    int64_t nLastJobTime;
+
+    bool UpdateJob(bool fNewTip);
+    UniValue GetJob() const;
+    UniValue SubmitWork(const UniValue& params);
+    UniValue HandleRequest(CClient& client, const std::string& strMethod, const UniValue& params);
+    void HandleLine(CClient& client, const std::string& strLine);
+    void Send(struct bufferevent* bev, const std::string& strReply);
+    void Disconnect(struct bufferevent* bev);
+
+    /** Libevent handlers: internal */
+    static void acceptcb(struct evconnlistener* listener, evutil_socket_t fd, struct sockaddr* addr, int socklen, void* ctx);
+    static void readcb(struct bufferevent* bev, void* ctx);
+    static void eventcb(struct bufferevent* bev, short what, void* ctx);
+    static void updatecb(evutil_socket_t fd, short what, void* ctx);
+};
+
+CStratumServer::CStratumServer(const CChainParams& chainparams, const CScript& scriptPubKey, boost::shared_ptr<CReserveScript> coinbaseScript):
+    chainparams(chainparams), scriptPubKey(scriptPubKey), coinbaseScript(coinbaseScript),
+    base(NULL), listener(NULL), evUpdate(NULL), fTipChanged(true), fMempoolChanged(false),
+    nExtraNonce(0), nLastJobTime(0)
+{
+    base = event_base_new();
+    if (base)
+        evUpdate = event_new(base, -1, 0, updatecb, this);
+}
+
+CStratumServer::~CStratumServer()
+{
+    for (auto& client : mapClients)
+        bufferevent_free(client.first);
+    mapClients.clear();
+    if (listener)
+        evconnlistener_free(listener);
+    if (evUpdate)
+        event_free(evUpdate);
+    if (base)
+        event_base_free(base);
+}
+
+bool CStratumServer::Listen(const CService& addrBind)
+{
+    if (!evUpdate)
+        return false;
+
+    struct sockaddr_storage sockaddr;
+    socklen_t len = sizeof(sockaddr);
+    if (!addrBind.GetSockAddr((struct sockaddr*)&sockaddr, &len))
+        return false;
+
+    listener = evconnlistener_new_bind(base, acceptcb, this, LEV_OPT_CLOSE_ON_FREE | LEV_OPT_REUSEABLE, -1, (struct sockaddr*)&sockaddr, len);
+    if (!listener)
+        return false;
+
+    // create the first job as soon as the event loop runs
+    event_active(evUpdate, 0, 0);
+    return true;
+}
+
+void CStratumServer::Run()
+{
+    event_base_dispatch(base);
+}
+
+void CStratumServer::Interrupt()
+{
+    event_base_loopbreak(base);
+}
+
+void CStratumServer::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+{
+    if (fInitialDownload)
+        return;
+    fTipChanged = true;
+    event_active(evUpdate, 0, 0);
+}
+
+void CStratumServer::SyncTransaction(const CTransaction &tx, const CBlock *pblock)
+{
+    // transactions of connected blocks are followed by a tip update
+    if (pblock)
+        return;
+    fMempoolChanged = true;
+    event_active(evUpdate, 0, 0);
+}
+
+bool CStratumServer::UpdateJob(bool fNewTip)
+{
+    std::unique_ptr<CBlockTemplate> pblocktemplate;
+    try {
+        pblocktemplate.reset(CreateNewBlock(chainparams, scriptPubKey));
+    } catch (const std::exception& e) {
+        LogPrint("stratum", "Stratum: could not create a block template: %s\n", e.what());
+    }
+    if (!pblocktemplate)
+        return false;
+
+    CJob job;
+    job.pblock = std::make_shared<CBlock>(pblocktemplate->block);
+    {
+        LOCK(cs_main);
+        IncrementExtraNonce(job.pblock.get(), chainActive.Tip(), nExtraNonce);
+        // pin the DAG of the job's epoch, so shares are not hashed through a DAG swapped out meanwhile
+        job.dag = ResidentDAG(egihash::get_epoch(job.pblock->nHeight));
+    }
+
+    // work for an old tip can never become a block
+    if (fNewTip) {
+        mapJobs.clear();
+        vJobs.clear();
+    }
+    uint256 const hashHeader = job.pblock->GetPOWHeaderHash();
+    mapJobs[hashHeader] = job;
+    vJobs.push_back(hashHeader);
+    while (vJobs.size() > MAX_STRATUM_JOBS) {
+        mapJobs.erase(vJobs.front());
+        vJobs.pop_front();
+    }
+    nLastJobTime = GetTime();
+
+    LogPrint("stratum", "Stratum: new job %s for height %d, %u clients\n", hashHeader.GetHex(), job.pblock->nHeight, mapClients.size());
+    std::string const strJob = JSONRPCReply(GetJob(), NullUniValue, UniValue(0));
+    for (auto const& client : mapClients) {
+        if (client.second.fLoggedIn)
+            Send(client.first, strJob);
+    }
+    return true;
+}
+
+UniValue CStratumServer::GetJob() const
+{
+    if (vJobs.empty())
+        throw JSONRPCError(RPC_MISC_ERROR, "No work available yet");
+
+    const CBlock& block = *mapJobs.find(vJobs.back())->second.pblock;
+    arith_uint256 hashTarget;
+    hashTarget.SetCompact(block.nBits);
+
+    UniValue job(UniValue::VARR);
+    job.push_back("0x" + vJobs.back().GetHex());
+    job.push_back("0x" + egihash::cache_t::get_seedhash(block.nHeight).to_hex());
+    job.push_back("0x" + ArithToUint256(hashTarget).GetHex());
+    job.push_back(strprintf("0x%x", egihash::get_epoch(block.nHeight)));
+    return job;
+}
+
+UniValue CStratumServer::SubmitWork(const UniValue& params)
+{
+    if (params.size() < 3)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Expected nonce, header hash and mix hash");
+
+    std::string strNonce = params[0].get_str();
+    if (strNonce.compare(0, 2, "0x") == 0)
+        strNonce = strNonce.substr(2);
+    if (strNonce.empty() || strNonce.size() > 16 || !IsHex(std::string(strNonce.size() % 2, '0') + strNonce))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid nonce");
+    uint64_t const nNonce = strtoull(strNonce.c_str(), NULL, 16);
+    uint256 const hashHeader = uint256S(params[1].get_str());
+    uint256 const hashMix = uint256S(params[2].get_str());
+
+    auto const it = mapJobs.find(hashHeader);
+    if (it == mapJobs.end()) {
+        LogPrint("stratum", "Stratum: work for unknown or stale job %s\n", hashHeader.GetHex());
+        return false;
+    }
+
+    // the hash is computed with the full DAG pinned by the job when there is one, a light hash otherwise,
+    // submitted work is new so the proof-of-work result cache is not consulted
+    CBlock block(*it->second.pblock);
+    block.nNonce = nNonce;
+    uint256 const hashPOW = block.ComputePOWHash(it->second.dag);
+    if (block.hashMix != hashMix) {
+        LogPrint("stratum", "Stratum: work for job %s has an invalid mix hash\n", hashHeader.GetHex());
+        return false;
+    }
+    if (!CheckProofOfWork(hashPOW, block.nBits, chainparams.GetConsensus())) {
+        LogPrint("stratum", "Stratum: work for job %s does not meet the target\n", hashHeader.GetHex());
+        return false;
+    }
+
+    LogPrintf("Stratum: proof-of-work found for job %s\n  hash: %s\n  mixhash: %s\n", hashHeader.GetHex(), hashPOW.GetHex(), hashMix.GetHex());
+    {
+        LOCK(cs_main);
+        if (block.hashPrevBlock != chainActive.Tip()->GetBlockHash()) {
+            LogPrintf("Stratum: found block is stale\n");
+            return false;
+        }
+    }
+    GetMainSignals().BlockFound(block.GetHash());
+    if (!ProcessNewBlock(chainparams, &block, true, NULL, NULL)) {
+        LogPrintf("Stratum: ProcessNewBlock() failed, block not accepted\n");
+        return false;
+    }
+    if (coinbaseScript)
+        coinbaseScript->KeepScript();
+    return true;
+}
+
+UniValue CStratumServer::HandleRequest(CClient& client, const std::string& strMethod, const UniValue& params)
+{
+    if (strMethod == "eth_submitLogin") {
+        client.fLoggedIn = true;
+        return true;
+    }
+    if (strMethod == "eth_getWork") {
+        client.fLoggedIn = true;
+        return GetJob();
+    }
+    if (strMethod == "eth_submitWork")
+        return SubmitWork(params);
+    if (strMethod == "eth_submitHashrate")
+        return true;
+    throw JSONRPCError(RPC_METHOD_NOT_FOUND, "Method not found");
+}
+
+void CStratumServer::HandleLine(CClient& client, const std::string& strLine)
+{
+    UniValue id;
+    try {
+        UniValue request;
+        if (!request.read(strLine) || !request.isObject())
+            throw JSONRPCError(RPC_PARSE_ERROR, "Parse error");
+        id = find_value(request, "id");
+        const UniValue& method = find_value(request, "method");
+        if (!method.isStr())
+            throw JSONRPCError(RPC_INVALID_REQUEST, "Method must be a string");
+        const UniValue& params = find_value(request, "params");
+        UniValue result = HandleRequest(client, method.get_str(), params.isArray() ? params : UniValue(UniValue::VARR));
+        Send(client.bev, JSONRPCReply(result, NullUniValue, id));
+    } catch (const UniValue& objError) {
+        Send(client.bev, JSONRPCReply(NullUniValue, objError, id));
+    } catch (const std::exception& e) {
+        Send(client.bev, JSONRPCReply(NullUniValue, JSONRPCError(RPC_PARSE_ERROR, e.what()), id));
+    }
+}
+
+void CStratumServer::Send(struct bufferevent* bev, const std::string& strReply)
+{
+    struct evbuffer* output = bufferevent_get_output(bev);
+    evbuffer_add(output, strReply.data(), strReply.size());
+}
+
+void CStratumServer::Disconnect(struct bufferevent* bev)
+{
+    auto const it = mapClients.find(bev);
+    if (it != mapClients.end()) {
+        LogPrint("stratum", "Stratum: client %s disconnected\n", it->second.strAddr);
+        mapClients.erase(it);
+    }
+    bufferevent_free(bev);
+}
+
+void CStratumServer::acceptcb(struct evconnlistener* listener, evutil_socket_t fd, struct sockaddr* addr, int socklen, void* ctx)
+{
+    CStratumServer* self = (CStratumServer*)ctx;
+    struct bufferevent* bev = bufferevent_socket_new(self->base, fd, BEV_OPT_CLOSE_ON_FREE);
+    if (!bev) {
+        evutil_closesocket(fd);
+        return;
+    }
+
+    CService addrClient;
+    addrClient.SetSockAddr(addr);
+    CClient client;
+    client.bev = bev;
+    client.strAddr = addrClient.ToString();
+    client.fLoggedIn = false;
+    self->mapClients[bev] = client;
+    LogPrint("stratum", "Stratum: client %s connected\n", client.strAddr);
+
+    bufferevent_setcb(bev, readcb, NULL, eventcb, self);
+    bufferevent_enable(bev, EV_READ | EV_WRITE);
+}
+
+void CStratumServer::readcb(struct bufferevent* bev, void* ctx)
+{
+    CStratumServer* self = (CStratumServer*)ctx;
+    auto const it = self->mapClients.find(bev);
+    if (it == self->mapClients.end())
+        return;
+
+    struct evbuffer* input = bufferevent_get_input(bev);
+    size_t n_read_out = 0;
+    char* line;
+    while ((line = evbuffer_readln(input, &n_read_out, EVBUFFER_EOL_CRLF)) != NULL) {
+        std::string s(line, n_read_out);
+        free(line);
+        if (!s.empty())
+            self->HandleLine(it->second, s);
+    }
+    //  Do this after evbuffer_readln to make sure all full lines have been
+    //  removed from the buffer. Everything left is an incomplete line.
+    if (evbuffer_get_length(input) > MAX_STRATUM_LINE_LENGTH) {
+        LogPrintf("Stratum: client %s sent too long a line, disconnecting\n", it->second.strAddr);
+        self->Disconnect(bev);
+    }
+}
+
+void CStratumServer::eventcb(struct bufferevent* bev, short what, void* ctx)
+{
+    CStratumServer* self = (CStratumServer*)ctx;
+    if (what & (BEV_EVENT_EOF | BEV_EVENT_ERROR))
+        self->Disconnect(bev);
+}
+
+void CStratumServer::updatecb(evutil_socket_t fd, short what, void* ctx)
+{
+    CStratumServer* self = (CStratumServer*)ctx;
+    if (IsInitialBlockDownload())
+        return;
+
+    if (self->fTipChanged.exchange(false)) {
+        self->fMempoolChanged = false;
+        if (!self->UpdateJob(true))
+            self->fTipChanged = true;
+        return;
+    }
+
+    if (self->fMempoolChanged) {
+        // bound the rate of block template creation while transactions stream in
+        int64_t const nWait = self->nLastJobTime + STRATUM_MEMPOOL_JOB_INTERVAL - GetTime();
+        if (nWait > 0) {
+            struct timeval tv = {nWait, 0};
+            event_add(self->evUpdate, &tv);
+            return;
+        }
+        self->fMempoolChanged = false;
+        self->UpdateJob(false);
+    }
+}
+
+static CStratumServer* pStratumServer = NULL;
+static boost::thread threadStratum;
+
+bool StartStratumServer(const CChainParams& chainparams)
+{
+    int const nPort = GetArg("-stratumport", DEFAULT_STRATUM_PORT);
+    if (nPort <= 0)
+        return true;
+
+    // the payout script is either given, or taken from the wallet like for the internal miner
+    CScript scriptPubKey;
+    boost::shared_ptr<CReserveScript> coinbaseScript;
+    if (mapArgs.count("-stratumaddress")) {
+        CBitcoinAddress address(GetArg("-stratumaddress", ""));
+        if (!address.IsValid()) {
+            LogPrintf("Stratum: invalid -stratumaddress\n");
+            return false;
+        }
+        scriptPubKey = GetScriptForDestination(address.Get());
+    } else {
+        GetMainSignals().ScriptForMining(coinbaseScript);
+        if (!coinbaseScript || coinbaseScript->reserveScript.empty()) {
+            LogPrintf("Stratum: no payout address, set -stratumaddress or enable the wallet\n");
+            return false;
+        }
+        scriptPubKey = coinbaseScript->reserveScript;
+    }
+
+    CService addrBind = LookupNumeric(GetArg("-stratumbind", DEFAULT_STRATUM_BIND).c_str(), nPort);
+    if (!addrBind.IsValid()) {
+        LogPrintf("Stratum: invalid -stratumbind\n");
+        return false;
+    }
+
+#ifdef WIN32
+    evthread_use_windows_threads();
+#else
+    evthread_use_pthreads();
+#endif
+
+    std::unique_ptr<CStratumServer> server(new CStratumServer(chainparams, scriptPubKey, coinbaseScript));
+    if (!server->Listen(addrBind)) {
+        LogPrintf("Stratum: unable to listen on %s\n", addrBind.ToString());
+        return false;
+    }
+    LogPrintf("Stratum: listening on %s\n", addrBind.ToString());
+
+    pStratumServer = server.release();
+    RegisterValidationInterface(pStratumServer);
+    threadStratum = boost::thread(boost::bind(&TraceThread<boost::function<void()> >, "stratum", boost::function<void()>(boost::bind(&CStratumServer::Run, pStratumServer))));
+    return true;
+}
+
+void InterruptStratumServer()
+{
+    if (pStratumServer)
+        pStratumServer->Interrupt();
+}
+
+void StopStratumServer()
+{
+    if (!pStratumServer)
+        return;
+
+    UnregisterValidationInterface(pStratumServer);
+    pStratumServer->Interrupt();
+    threadStratum.join();
+    delete pStratumServer;
+    pStratumServer = NULL;
+}
@@ -0,0 +1,25 @@
+// Copyright (c) 2017 Energi Development Team
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * Stratum server for external egihash miners.
+ */
+#ifndef ENERGI_STRATUM_H
+#define ENERGI_STRATUM_H
+
+#include <string>
+
+class CChainParams;
+
+/** Default for -stratumport, 0 disables the Stratum server */
+static const int DEFAULT_STRATUM_PORT = 0;
+/** Default for -stratumbind, Stratum has no authentication so only local miners are served by default */
+static const std::string DEFAULT_STRATUM_BIND = "127.0.0.1";
+
+/** Start the Stratum server if -stratumport is set. Returns false if it could not be started */
+bool StartStratumServer(const CChainParams& chainparams);
+void InterruptStratumServer();
+void StopStratumServer();
+
+#endif // ENERGI_STRATUM_H
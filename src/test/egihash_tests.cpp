@@ -0,0 +1,539 @@
+// Copyright (c) 2017 Energi Development Team
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "crypto/egihash.h"
+#include "crypto/egihash_fnv.h"
+extern "C"
+{
+#include "crypto/keccak-tiny.h"
+}
+#include "chainparams.h"
+#include "dag_singleton.h"
+#include "primitives/block.h"
+#include "random.h"
+#include "test/test_energi.h"
+
+#include <csignal>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#ifndef WIN32
+#include <sys/resource.h>
+#endif
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+using namespace egihash;
+
+BOOST_FIXTURE_TEST_SUITE(egihash_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(egihash_seedhash)
+{
+	BOOST_CHECK_EQUAL(cache_t::get_seedhash(0).to_hex(), "e8bcb1cf8a601625117e59b5f2dc8c366e1404830ae9d25f652be67ac9bb815b");
+	BOOST_CHECK_EQUAL(cache_t::get_seedhash(constants::EPOCH_LENGTH - 1).to_hex(), "e8bcb1cf8a601625117e59b5f2dc8c366e1404830ae9d25f652be67ac9bb815b");
+	BOOST_CHECK_EQUAL(cache_t::get_seedhash(5 * constants::EPOCH_LENGTH).to_hex(), "0db632cf4442ca9f5006c5dd47fb90ece32b2bf40a3e57603a356418de0b8855");
+}
+
+BOOST_AUTO_TEST_CASE(egihash_sizing)
+{
+	// mainnet uses the default sizing, regtest a tiny DAG
+	sizing_t const & main_sizing = get_sizing();
+	BOOST_CHECK(main_sizing == sizing_t());
+	BOOST_CHECK_EQUAL(cache_t::get_cache_size(0), 40631744u);
+	BOOST_CHECK_EQUAL(dag_t::get_full_size(0), 2600467328u);
+	SelectParams(CBaseChainParams::REGTEST);
+	BOOST_CHECK(get_sizing() != sizing_t());
+	// sizings are immutable, a sizing read before stays valid
+	BOOST_CHECK(main_sizing == sizing_t());
+	BOOST_CHECK_EQUAL(cache_t::get_cache_size(0), 65344u);
+	BOOST_CHECK_EQUAL(dag_t::get_full_size(0), 4191872u);
+	BOOST_CHECK_EQUAL(get_epoch(2 * get_sizing().epoch_length), 2u);
+	{
+		dag_t const dag(0);
+		BOOST_CHECK_EQUAL(dag.size(), 4191872u);
+		BOOST_CHECK_EQUAL(dag.get_cache().size(), 65344u);
+		h256_t const header_hash("egihash_sizing", 14);
+		for (uint64_t nonce = 0; nonce < 4; nonce++)
+		{
+			BOOST_CHECK(full::hash(dag, header_hash, nonce) == light::hash(dag.get_cache(), header_hash, nonce));
+		}
+		dag.unload();
+	}
+	BOOST_CHECK(!cache_t::is_loaded(0));
+
+	// caches are registered per sizing
+	SelectParams(CBaseChainParams::MAIN);
+	BOOST_CHECK(get_sizing() == sizing_t());
+	BOOST_CHECK_EQUAL(cache_t::get_cache_size(0), 40631744u);
+
+	BOOST_CHECK_THROW(sizing_t(0, 1 << 16, 1 << 10, 1 << 22, 1 << 16), hash_exception);
+	BOOST_CHECK_THROW(sizing_t(100, 64, 0, 1 << 22, 0), hash_exception);
+	BOOST_CHECK_THROW(sizing_t(100, 1 << 16, 100, 1 << 22, 0), hash_exception);
+}
+
+BOOST_AUTO_TEST_CASE(egihash_active_dag)
+{
+	// regtest DAGs are tiny, so several epochs are generated quickly
+	SelectParams(CBaseChainParams::REGTEST);
+	uint64_t const epoch_length = get_sizing().epoch_length;
+	h256_t const header_hash("egihash_active_dag", 18);
+	BOOST_CHECK(!ActiveDAG());
+
+	ActiveDAG(std::unique_ptr<dag_t>(new dag_t(0)));
+	CDAGRef const dag0 = ActiveDAG();
+	BOOST_REQUIRE(dag0);
+	BOOST_CHECK(ResidentDAG(0) == dag0);
+	BOOST_CHECK(!ResidentDAG(1));
+
+	// the swapped out DAG stays resident as the previous DAG
+	ActiveDAG(std::unique_ptr<dag_t>(new dag_t(epoch_length)));
+	BOOST_CHECK_EQUAL(ActiveDAG()->epoch(), 1u);
+	BOOST_CHECK(ResidentDAG(0) == dag0);
+	BOOST_CHECK(ResidentDAG(1) == ActiveDAG());
+
+	// a handle keeps its DAG usable after it has been unloaded
+	ReleasePreviousDAG();
+	BOOST_CHECK(!ResidentDAG(0));
+	BOOST_CHECK(!dag_t::is_loaded(0));
+	BOOST_CHECK(full::hash(*dag0, header_hash, 0) == light::hash(cache_t(0), header_hash, 0));
+
+	// only the active and the previous epoch are kept
+	ActiveDAG(std::unique_ptr<dag_t>(new dag_t(2 * epoch_length)));
+	ActiveDAG(std::unique_ptr<dag_t>(new dag_t(3 * epoch_length)));
+	BOOST_CHECK(!ResidentDAG(1));
+	BOOST_CHECK(!dag_t::is_loaded(1));
+	BOOST_CHECK_EQUAL(ResidentDAG(2)->epoch(), 2u);
+
+	ReleaseDAGs();
+	BOOST_CHECK(!ActiveDAG());
+	BOOST_CHECK(dag_t::get_loaded().empty());
+	SelectParams(CBaseChainParams::MAIN);
+}
+
+BOOST_AUTO_TEST_CASE(egihash_fnv_kernels)
+{
+	using namespace fnv_kernels;
+	kernels_t const & reference = get_kernels(scalar);
+	BOOST_CHECK(is_supported(scalar));
+	BOOST_CHECK(is_supported(active_kernels().level));
+
+	// small random cache, every kernel level must agree with the scalar reference
+	std::vector<node> cache_items(constants::HASH_WORDS * 97);
+	for (auto & i : cache_items)
+	{
+		i.hword = insecure_rand();
+	}
+	data_view_t const cache(cache_items.data(), cache_items.size() / constants::HASH_WORDS);
+
+	for (kernel_level level : {scalar, sse41, avx2})
+	{
+		if (!is_supported(level))
+		{
+			BOOST_TEST_MESSAGE("skipping unsupported FNV kernels: " << get_kernels(level).name);
+			continue;
+		}
+		kernels_t const & kernels = get_kernels(level);
+		BOOST_CHECK_EQUAL(kernels.level, level);
+
+		for (int round = 0; round < 64; round++)
+		{
+			node mix[constants::HASH_WORDS], expected[constants::HASH_WORDS], item[constants::HASH_WORDS];
+			for (uint32_t k = 0; k < constants::HASH_WORDS; k++)
+			{
+				mix[k].hword = expected[k].hword = insecure_rand();
+				item[k].hword = insecure_rand();
+			}
+
+			reference.mix_item(expected, item);
+			kernels.mix_item(mix, item);
+			BOOST_CHECK(std::memcmp(mix, expected, sizeof(mix)) == 0);
+
+			uint32_t const index = insecure_rand();
+			reference.dataset_parents(expected, cache, index);
+			kernels.dataset_parents(mix, cache, index);
+			BOOST_CHECK(std::memcmp(mix, expected, sizeof(mix)) == 0);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(egihash_keccak_x4)
+{
+	BOOST_TEST_MESSAGE("multi-buffer Keccak native: " << keccak_x4_native());
+
+	// cover empty input, partial blocks and inputs spanning several blocks
+	uint8_t input[4][300];
+	for (auto & message : input)
+	{
+		for (auto & b : message)
+		{
+			b = static_cast<uint8_t>(insecure_rand());
+		}
+	}
+
+	for (size_t size : {0, 1, 32, 64, 71, 72, 73, 135, 136, 137, 300})
+	{
+		uint8_t out512[4][64], out256[4][32], expected[64];
+		uint8_t * const outs512[4] = { out512[0], out512[1], out512[2], out512[3] };
+		uint8_t * const outs256[4] = { out256[0], out256[1], out256[2], out256[3] };
+		uint8_t const * const ins[4] = { input[0], input[1], input[2], input[3] };
+		BOOST_CHECK_EQUAL(sha3_512_x4(outs512, sizeof(out512[0]), ins, size), 0);
+		BOOST_CHECK_EQUAL(sha3_256_x4(outs256, sizeof(out256[0]), ins, size), 0);
+		for (int m = 0; m < 4; m++)
+		{
+			BOOST_CHECK_EQUAL(sha3_512(expected, sizeof(out512[m]), input[m], size), 0);
+			BOOST_CHECK(std::memcmp(expected, out512[m], sizeof(out512[m])) == 0);
+			BOOST_CHECK_EQUAL(sha3_256(expected, sizeof(out256[m]), input[m], size), 0);
+			BOOST_CHECK(std::memcmp(expected, out256[m], sizeof(out256[m])) == 0);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(egihash_light_hash)
+{
+	cache_t const cache(0);
+	BOOST_CHECK_EQUAL(cache.epoch(), 0u);
+	BOOST_CHECK_EQUAL(cache.size(), 40631744u);
+
+	result_t const r = light::hash(cache, h256_t("abc", 3), 0);
+	BOOST_CHECK_EQUAL(r.value.to_hex(), "05c79cab4dfd403ee4ba3fd64fef539761f934a1ac06be7c933a080d9971453b");
+	BOOST_CHECK_EQUAL(r.mixhash.to_hex(), "768d69c6f4f31ed9180d732b21886d35de29c521bba32c96c4eb9b8f8ec77bb4");
+}
+
+BOOST_AUTO_TEST_CASE(egihash_search)
+{
+	cache_t const cache(0);
+	h256_t const header_hash("search", 6);
+
+	// about one in 16 nonces satisfies this target
+	h256_t target;
+	std::memset(&target.b[0], 0xff, sizeof(target.b));
+	target.b[0] = 0x0f;
+
+	uint64_t const start_nonce = insecure_rand();
+	uint64_t nonce = 0;
+	result_t result;
+	BOOST_REQUIRE(light::search(cache, header_hash, start_nonce, 1000, target, nonce, result));
+	BOOST_CHECK(result == light::hash(cache, header_hash, nonce));
+	BOOST_CHECK(result.value.b[0] <= 0x0f);
+
+	// it is the first solution, the range before it has none
+	for (uint64_t n = start_nonce; n < nonce; n++)
+	{
+		BOOST_CHECK(light::hash(cache, header_hash, n).value.b[0] > 0x0f);
+	}
+	uint64_t unused_nonce = 0;
+	BOOST_CHECK(!light::search(cache, header_hash, start_nonce, nonce - start_nonce, target, unused_nonce, result));
+
+	// ranges not divisible by four are searched to their last nonce
+	BOOST_CHECK(light::search(cache, header_hash, nonce - 2, 3, target, unused_nonce, result));
+	BOOST_CHECK_EQUAL(unused_nonce, nonce);
+
+	CBlockHeader header;
+	header.nHeight = 1;
+	header.nNonce = start_nonce;
+	uint256 const hashTarget = uint256S("ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff");
+	uint256 hashPOW;
+	BOOST_CHECK(header.SearchPOW(1, hashTarget, hashPOW));
+	BOOST_CHECK_EQUAL(header.nNonce, start_nonce);
+	BOOST_CHECK(hashPOW == static_cast<CBlockHeader const &>(header).GetPOWHash());
+	BOOST_CHECK(!header.SearchPOW(5, uint256(), hashPOW));
+	BOOST_CHECK_EQUAL(header.nNonce, start_nonce + 5);
+}
+
+BOOST_AUTO_TEST_CASE(egihash_dag_memory)
+{
+	// every policy must give usable, aligned memory, falling back where the system lacks support
+	size_t const bytes = 3 * 1024 * 1024 + constants::HASH_BYTES;
+	for (dag_page_mode pages : {dag_pages_default, dag_pages_transparent, dag_pages_huge})
+	{
+		for (dag_numa_mode numa : {dag_numa_default, dag_numa_interleave, dag_numa_bind})
+		{
+			dag_t::set_memory_policy(pages, numa, 0);
+			std::shared_ptr<void> const memory = allocate_dag_memory(bytes);
+			BOOST_REQUIRE(memory);
+			BOOST_CHECK_EQUAL(reinterpret_cast<uintptr_t>(memory.get()) % constants::DATA_ALIGNMENT, 0u);
+			uint8_t * const data = static_cast<uint8_t *>(memory.get());
+			std::memset(data, 0xa5, bytes);
+			BOOST_CHECK_EQUAL(data[0], 0xa5);
+			BOOST_CHECK_EQUAL(data[bytes - 1], 0xa5);
+		}
+	}
+	dag_t::set_memory_policy(dag_pages_default);
+}
+
+BOOST_AUTO_TEST_CASE(egihash_cache_lru)
+{
+	uint64_t const epoch_length = constants::EPOCH_LENGTH;
+	cache_t::stats_t const before = cache_t::get_stats();
+
+	// room for epochs 0 and 2 only, epoch 0 is pinned so epoch 1 must be evicted
+	cache_t::set_pinned_epochs({0});
+	cache_t::set_memory_budget(cache_t::get_cache_size(0) + cache_t::get_cache_size(2 * epoch_length));
+	{
+		cache_t const epoch0(0);
+		cache_t const epoch1(epoch_length);
+		BOOST_CHECK(cache_t::is_loaded(0));
+		BOOST_CHECK(cache_t::is_loaded(1));
+		cache_t const epoch0_again(epoch_length - 1);
+		BOOST_CHECK_EQUAL(epoch0.data().data(), epoch0_again.data().data());
+		cache_t const epoch2(2 * epoch_length);
+		BOOST_CHECK(cache_t::is_loaded(0));
+		BOOST_CHECK(!cache_t::is_loaded(1));
+		BOOST_CHECK(cache_t::is_loaded(2));
+
+		// an evicted cache stays usable by its holders
+		BOOST_CHECK_EQUAL(epoch1.epoch(), 1u);
+		BOOST_CHECK_EQUAL(epoch1.data().size(), cache_t::get_cache_size(epoch_length) / constants::HASH_BYTES);
+	}
+
+	cache_t::stats_t const after = cache_t::get_stats();
+	BOOST_CHECK_GE(after.hits, before.hits + 1);
+	BOOST_CHECK_GE(after.misses, before.misses + 2);
+	BOOST_CHECK_EQUAL(after.evictions, before.evictions + 1);
+	BOOST_CHECK_EQUAL(after.loaded_count, 2u);
+	BOOST_CHECK_EQUAL(after.loaded_bytes, cache_t::get_cache_size(0) + cache_t::get_cache_size(2 * epoch_length));
+
+	// lowering the budget evicts unpinned caches right away
+	cache_t::set_memory_budget(1);
+	BOOST_CHECK(cache_t::is_loaded(0));
+	BOOST_CHECK(!cache_t::is_loaded(2));
+
+	cache_t::set_memory_budget(0);
+	cache_t::set_pinned_epochs({});
+}
+
+BOOST_AUTO_TEST_CASE(egihash_cache_file)
+{
+	boost::filesystem::path const path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+	cache_t const cache(0);
+	cache.save(path.string());
+	BOOST_CHECK_EQUAL(boost::filesystem::file_size(path), constants::CACHE_FILE_HEADER_SIZE + cache.size());
+
+	for (dag_load_mode mode : {dag_load_copy, dag_load_mmap})
+	{
+		cache.unload();
+		BOOST_CHECK(!cache_t::is_loaded(0));
+		cache_t const loaded(path.string(), [](::std::size_t, ::std::size_t, int){ return true; }, mode);
+		BOOST_CHECK(cache_t::is_loaded(0));
+		BOOST_CHECK_EQUAL(loaded.epoch(), 0u);
+		BOOST_CHECK(loaded.seedhash() == cache.seedhash());
+		BOOST_CHECK_EQUAL(loaded.data().size(), cache.data().size());
+		BOOST_CHECK(std::memcmp(loaded.data().data(), cache.data().data(), cache.size()) == 0);
+
+		// an already loaded cache is shared rather than loaded again
+		cache_t const again(path.string(), [](::std::size_t, ::std::size_t, int){ return true; }, mode);
+		BOOST_CHECK_EQUAL(again.data().data(), loaded.data().data());
+	}
+
+	// flipping a bit of a cache item must be detected
+	{
+		std::fstream fs(path.string(), std::ios::in | std::ios::out | std::ios::binary);
+		fs.seekg(constants::CACHE_FILE_HEADER_SIZE + 1000);
+		char c = 0;
+		fs.read(&c, 1);
+		c ^= 1;
+		fs.seekp(constants::CACHE_FILE_HEADER_SIZE + 1000);
+		fs.write(&c, 1);
+	}
+	cache.unload();
+	BOOST_CHECK_THROW(cache_t(path.string()), hash_exception);
+	BOOST_CHECK_THROW(cache_t(path.string(), [](::std::size_t, ::std::size_t, int){ return true; }, dag_load_mmap), hash_exception);
+	BOOST_CHECK(!cache_t::is_loaded(0));
+
+	boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(egihash_seedhash_file)
+{
+	boost::filesystem::path const path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+	h256_t const seedhash = cache_t::get_seedhash(5 * constants::EPOCH_LENGTH);
+	cache_t::save_seedhashes(path.string());
+	// no temporary file is left behind
+	for (boost::filesystem::directory_iterator it(path.parent_path()), end; it != end; ++it)
+	{
+		BOOST_CHECK(it->path().filename().string().find(path.filename().string() + ".") != 0);
+	}
+	cache_t::load_seedhashes(path.string());
+	BOOST_CHECK(cache_t::get_seedhash(5 * constants::EPOCH_LENGTH) == seedhash);
+
+	// saving again replaces the file
+	cache_t::save_seedhashes(path.string());
+	cache_t::load_seedhashes(path.string());
+
+	// a seedhash which does not follow from its predecessor is rejected, even with a matching checksum
+	{
+		std::vector<h256_t> seeds(3);
+		seeds[0] = cache_t::get_seedhash(0);
+		seeds[1] = h256_t("egihash_seedhash_file", 21);
+		seeds[2] = h256_t(&seeds[1].b[0], h256_t::hash_size);
+		uint64_t const count = seeds.size();
+		h256_t const checksum(&seeds[0], count * sizeof(h256_t));
+		std::ofstream fs(path.string(), std::ios::out | std::ios::binary | std::ios::trunc);
+		fs.write(constants::SEEDHASH_MAGIC_BYTES, sizeof(constants::SEEDHASH_MAGIC_BYTES));
+		fs.write(reinterpret_cast<char const *>(&count), sizeof(count));
+		fs.write(reinterpret_cast<char const *>(&seeds[0]), count * sizeof(h256_t));
+		fs.write(reinterpret_cast<char const *>(&checksum.b[0]), sizeof(checksum.b));
+	}
+	BOOST_CHECK_THROW(cache_t::load_seedhashes(path.string()), hash_exception);
+	BOOST_CHECK(cache_t::get_seedhash(5 * constants::EPOCH_LENGTH) == seedhash);
+
+	boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(egihash_dag_file)
+{
+	// a regtest DAG is a single chunk
+	SelectParams(CBaseChainParams::REGTEST);
+	boost::filesystem::path const path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+	h256_t const header_hash("egihash_dag_file", 16);
+	std::vector<uint8_t> items;
+	result_t expected;
+	uint64_t dag_offset = 0;
+	{
+		dag_t const dag(0);
+		dag.save(path.string());
+		items.assign(reinterpret_cast<uint8_t const *>(dag.data().data()), reinterpret_cast<uint8_t const *>(dag.data().data()) + dag.size());
+		expected = full::hash(dag, header_hash, 0);
+		dag_offset = constants::DAG_FILE_HEADER_SIZE + dag.get_cache().size();
+		dag.unload();
+	}
+
+	auto const read_byte = [&path](uint64_t offset)
+	{
+		std::ifstream fs(path.string(), std::ios::in | std::ios::binary);
+		fs.seekg(offset);
+		char c = 0;
+		fs.read(&c, 1);
+		return c;
+	};
+	char const original = read_byte(dag_offset + 1000);
+
+	// a flipped byte is regenerated in memory and in the file, whether the DAG is copied or mapped
+	for (dag_load_mode mode : {dag_load_copy, dag_load_mmap})
+	{
+		{
+			std::fstream fs(path.string(), std::ios::in | std::ios::out | std::ios::binary);
+			fs.seekp(dag_offset + 1000);
+			char const c = original ^ 1;
+			fs.write(&c, 1);
+		}
+		BOOST_CHECK_EQUAL(read_byte(dag_offset + 1000), original ^ 1);
+
+		dag_t const loaded(path.string(), [](::std::size_t, ::std::size_t, int){ return true; }, mode);
+		BOOST_CHECK(full::hash(loaded, header_hash, 0) == expected);
+		BOOST_CHECK_EQUAL(loaded.verify(), 1u);
+		BOOST_CHECK_EQUAL(loaded.size(), items.size());
+		BOOST_CHECK(std::memcmp(loaded.data().data(), items.data(), items.size()) == 0);
+		BOOST_CHECK(full::hash(loaded, header_hash, 0) == expected);
+		BOOST_CHECK_EQUAL(read_byte(dag_offset + 1000), original);
+		loaded.unload();
+	}
+
+	// the repaired file verifies without regenerating anything
+	{
+		dag_t const loaded(path.string(), [](::std::size_t, ::std::size_t, int){ return true; }, dag_load_mmap);
+		BOOST_CHECK_EQUAL(loaded.verify(), 0u);
+		loaded.unload();
+	}
+
+	// so does a flipped byte of the cache
+	uint64_t const cache_offset = constants::DAG_FILE_HEADER_SIZE + 100;
+	char const original_cache = read_byte(cache_offset);
+	for (dag_load_mode mode : {dag_load_copy, dag_load_mmap})
+	{
+		{
+			std::fstream fs(path.string(), std::ios::in | std::ios::out | std::ios::binary);
+			fs.seekp(cache_offset);
+			char const c = original_cache ^ 1;
+			fs.write(&c, 1);
+		}
+		BOOST_CHECK_EQUAL(read_byte(cache_offset), original_cache ^ 1);
+
+		dag_t const loaded(path.string(), [](::std::size_t, ::std::size_t, int){ return true; }, mode);
+		BOOST_CHECK_EQUAL(loaded.verify(), 0u);
+		BOOST_CHECK(full::hash(loaded, header_hash, 0) == expected);
+		BOOST_CHECK(light::hash(loaded.get_cache(), header_hash, 0) == expected);
+		BOOST_CHECK_EQUAL(read_byte(cache_offset), original_cache);
+		loaded.unload();
+	}
+
+	boost::filesystem::remove(path);
+	SelectParams(CBaseChainParams::MAIN);
+}
+
+BOOST_AUTO_TEST_CASE(egihash_dag_generate_file)
+{
+	// a DAG larger than the blocks of the file writer, so writes fail on the writing thread as well
+	set_sizing(sizing_t(constants::EPOCH_LENGTH, 1 << 16, 1 << 10, 1 << 24, 1 << 16));
+	boost::filesystem::path const path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+
+	// a cancelled generation leaves no partial file behind
+	BOOST_CHECK_THROW(dag_t(0, path.string(), [](::std::size_t step, ::std::size_t, int phase){ return (phase != dag_generation) || (step < 4096); }), hash_exception);
+	BOOST_CHECK(!boost::filesystem::exists(path));
+	BOOST_CHECK(!dag_t::is_loaded(0));
+
+#ifndef WIN32
+	// neither does a generation which fails to write the file, here because the file size limit is reached
+	struct rlimit limit;
+	BOOST_REQUIRE_EQUAL(getrlimit(RLIMIT_FSIZE, &limit), 0);
+	struct rlimit small_limit = limit;
+	small_limit.rlim_cur = 1024 * 1024;
+	void (*previous_handler)(int) = std::signal(SIGXFSZ, SIG_IGN);
+	BOOST_REQUIRE_EQUAL(setrlimit(RLIMIT_FSIZE, &small_limit), 0);
+	BOOST_CHECK_THROW(dag_t(0, path.string()), hash_exception);
+	BOOST_CHECK_EQUAL(setrlimit(RLIMIT_FSIZE, &limit), 0);
+	std::signal(SIGXFSZ, previous_handler);
+	BOOST_CHECK(!boost::filesystem::exists(path));
+	BOOST_CHECK(!dag_t::is_loaded(0));
+#endif
+
+	boost::filesystem::remove(path);
+	SelectParams(CBaseChainParams::MAIN);
+}
+
+BOOST_AUTO_TEST_CASE(egihash_pow_cache)
+{
+	CBlockHeader header;
+	header.nHeight = 1;
+	header.nBits = 0x207fffff;
+	header.nNonce = insecure_rand();
+
+	CPOWCacheStats const before = GetPOWCacheStats();
+	CBlockHeader const & cheader = header;
+	uint256 const powHash = cheader.GetPOWHash();
+	BOOST_CHECK(cheader.GetPOWHash() == powHash);
+	CPOWCacheStats const after = GetPOWCacheStats();
+	BOOST_CHECK_EQUAL(after.nMisses, before.nMisses + 1);
+	BOOST_CHECK_EQUAL(after.nHits, before.nHits + 1);
+
+	// the mutable overload reuses the result and fills in the mix hash
+	BOOST_CHECK(header.GetPOWHash() == powHash);
+	BOOST_CHECK(!header.hashMix.IsNull());
+	BOOST_CHECK_EQUAL(GetPOWCacheStats().nHits, after.nHits + 1);
+
+	// with its mix hash set the header has a new block hash, and so a new cache entry
+	BOOST_CHECK(cheader.GetPOWHash() == powHash);
+	BOOST_CHECK_EQUAL(GetPOWCacheStats().nMisses, after.nMisses + 1);
+
+	// work submitted by miners is hashed without the cache
+	CPOWCacheStats const submitted = GetPOWCacheStats();
+	CBlockHeader work(header);
+	work.hashMix.SetNull();
+	BOOST_CHECK(work.ComputePOWHash(CDAGRef()) == powHash);
+	BOOST_CHECK(work.hashMix == header.hashMix);
+	BOOST_CHECK_EQUAL(GetPOWCacheStats().nHits, submitted.nHits);
+	BOOST_CHECK_EQUAL(GetPOWCacheStats().nMisses, submitted.nMisses);
+
+	// results are cached per egihash sizing
+	SelectParams(CBaseChainParams::REGTEST);
+	BOOST_CHECK(cheader.GetPOWHash() != powHash);
+	BOOST_CHECK_EQUAL(GetPOWCacheStats().nMisses, submitted.nMisses + 1);
+	SelectParams(CBaseChainParams::MAIN);
+	BOOST_CHECK(cheader.GetPOWHash() == powHash);
+	BOOST_CHECK_EQUAL(GetPOWCacheStats().nHits, submitted.nHits + 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
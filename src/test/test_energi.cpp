@@ -134,7 +134,9 @@ TestChain100Setup::CreateAndProcessBlock(const std::vector<CMutableTransaction>&
     unsigned int extraNonce = 0;
     IncrementExtraNonce(&block, chainActive.Tip(), extraNonce);
 
-    while (!CheckProofOfWork(block.GetPOWHash(), block.nBits, chainparams.GetConsensus())) ++block.nNonce;
+    uint256 const hashTarget = ArithToUint256(arith_uint256().SetCompact(block.nBits));
+    uint256 hashPOW;
+    while (!block.SearchPOW(0x100, hashTarget, hashPOW)) {}
 
     ProcessNewBlock(chainparams, &block, true, NULL, NULL);
 
@@ -20,6 +20,7 @@
 #include "pow.h"
 #include "primitives/block.h"
 #include "primitives/transaction.h"
+#include "random.h"
 #include "script/script.h"
 #include "script/sigcache.h"
 #include "script/standard.h"
@@ -46,6 +47,8 @@
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
+#include <boost/interprocess/sync/file_lock.hpp>
+#include <boost/interprocess/sync/scoped_lock.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/math/distributions/poisson.hpp>
 #include <boost/thread.hpp>
@@ -2442,48 +2445,471 @@ static int64_t nTimeFlush = 0;
 static int64_t nTimeChainState = 0;
 static int64_t nTimePostConnect = 0;
 
-void CreateDAG(int height, egihash::progress_callback_type callback)
+/**
+ * The directory of DAG and light cache files, -dagdir. It may be shared by several processes on one host,
+ * new files in it are written to a temporary name and renamed into place, and mapped DAGs share their pages
+ * through the page cache. The only writes in place repair corrupt cache and DAG sections with the bytes a
+ * correct file holds there, so they never change the contents of an intact file.
+ */
+static boost::filesystem::path GetDAGDir()
 {
-    using namespace egihash;
+    if (mapArgs.count("-dagdir"))
+        return boost::filesystem::system_complete(GetArg("-dagdir", ""));
+    return GetDataDir(false) / "dag";
+}
 
-    if (!GetBoolArg("-usedag", DEFAULT_USEDAG)) {
-        LogPrint("nrghash", "Operating in light mode, not loading a DAG\n");
-        return;
+/** The egihash::dag_write_flags to write DAG files with, from -dagdirectio and -dagsync */
+static unsigned int GetDAGWriteFlags()
+{
+    unsigned int flags = egihash::dag_write_buffered;
+    if (GetBoolArg("-dagdirectio", DEFAULT_DAGDIRECTIO))
+        flags |= egihash::dag_write_direct;
+    if (GetBoolArg("-dagsync", DEFAULT_DAGSYNC))
+        flags |= egihash::dag_write_sync;
+    return flags;
+}
+
+/** The egihash seedhash table, kept with the DAG and cache files so processes sharing -dagdir share it too */
+static boost::filesystem::path GetSeedhashFile()
+{
+    return GetDAGDir() / "seedhashes.dat";
+}
+
+/** Persist the memoized egihash seedhashes alongside the DAG files */
+static void SaveSeedhashes()
+{
+    try
+    {
+        boost::filesystem::create_directories(GetSeedhashFile().parent_path());
+        egihash::cache_t::save_seedhashes(GetSeedhashFile().string());
+    }
+    catch (std::exception const & e)
+    {
+        LogPrint("nrghash", "Seedhashes not saved to \"%s\": %s\n", GetSeedhashFile().string(), e.what());
     }
+}
+
+/** Keep the egihash light caches of the epoch of height and the following, prefetched, epochs exempt from eviction */
+static void PinEgihashCaches(int height)
+{
+    uint64_t const epoch = egihash::get_epoch(height);
+    int64_t const nPrefetchEpochs = (max)(GetArg("-egihashcacheprefetch", DEFAULT_EGIHASH_CACHE_PREFETCH), int64_t(1));
+    std::vector<uint64_t> vEpochs;
+    for (int64_t i = 0; i <= nPrefetchEpochs; i++)
+        vEpochs.push_back(epoch + i);
+    egihash::cache_t::set_pinned_epochs(vEpochs);
+}
+
+/**
+ * Path of the DAG or light cache file of the epoch of height, named after the epoch and its seedhash.
+ * Epochs have the same seedhash on all networks, so networks with their own egihash sizing add their name.
+ */
+static boost::filesystem::path GetEgihashFile(int height, std::string const & extension)
+{
+    using namespace egihash;
 
-    auto const epoch = height / constants::EPOCH_LENGTH;
+    auto const epoch = get_epoch(height);
     auto const & seedhash = cache_t::get_seedhash(height).to_hex();
     stringstream ss;
-    ss << hex << setw(4) << setfill('0') << epoch << "-" << seedhash.substr(0, 12) << ".dag";
-    auto const epoch_file = GetDataDir(false) / "dag" / ss.str();
+    ss << hex << setw(4) << setfill('0') << epoch << "-" << seedhash.substr(0, 12);
+    if (get_sizing() != sizing_t())
+        ss << "-" << Params().NetworkIDString();
+    ss << extension;
+    return GetDAGDir() / ss.str();
+}
+
+/**
+ * A unique temporary file next to path. Files are written there and renamed into place, so processes
+ * sharing the DAG directory never see, or map, a partially written file.
+ */
+static boost::filesystem::path GetEgihashTempFile(boost::filesystem::path const & path)
+{
+    return path.parent_path() / boost::filesystem::unique_path(path.filename().string() + ".%%%%-%%%%-%%%%.tmp");
+}
+
+/**
+ * Make the light cache of the epoch of height resident. It is loaded from its cache file if possible,
+ * otherwise it is generated and the cache file is written for the next start.
+ */
+static void LoadOrGenerateCache(int height, egihash::progress_callback_type callback)
+{
+    using namespace egihash;
+
+    auto const epoch = get_epoch(height);
+    auto const cache_file = GetEgihashFile(height, ".cache");
+    bool fSave = !boost::filesystem::exists(cache_file);
+    if (!cache_t::is_loaded(epoch) && !fSave)
+    {
+        try
+        {
+            auto const load_mode = GetBoolArg("-dagmmap", DEFAULT_DAGMMAP) ? dag_load_mmap : dag_load_copy;
+            cache_t const cache(cache_file.string(), callback, load_mode);
+            LogPrint("nrghash", "Cache file \"%s\" loaded successfully.\n", cache_file.string());
+            return;
+        }
+        catch (hash_exception const & e)
+        {
+            LogPrint("nrghash", "Cache file \"%s\" not loaded, will be generated instead. Message: %s\n", cache_file.string(), e.what());
+            fSave = true;
+        }
+    }
 
-    LogPrint("nrghash", "DAG file for epoch %u is \"%s\"\n", epoch, epoch_file.string());
-    // try to load the DAG from disk
     try
     {
-        unique_ptr<dag_t> new_dag(new dag_t(epoch_file.string(), callback));
-        ActiveDAG(move(new_dag));
+        cache_t const cache(height, callback);
+        if (fSave)
+        {
+            // write to a temporary file first, a mapped cache file must never be truncated underneath its readers
+            auto const tmp_file = GetEgihashTempFile(cache_file);
+            boost::filesystem::create_directories(cache_file.parent_path());
+            cache.save(tmp_file.string(), callback);
+            boost::filesystem::rename(tmp_file, cache_file);
+            LogPrint("nrghash", "Cache for epoch %u saved to \"%s\".\n", epoch, cache_file.string());
+        }
+    }
+    catch (std::exception const & e)
+    {
+        error("Cache for epoch %u could not be generated or saved: %s\n", epoch, e.what());
+    }
+}
+
+/**
+ * Load the DAG of an epoch from its file. Returns nullptr if there is no usable file.
+ */
+static std::unique_ptr<egihash::dag_t> LoadDAGFile(boost::filesystem::path const & epoch_file, egihash::progress_callback_type callback)
+{
+    using namespace egihash;
+
+    if (!boost::filesystem::exists(epoch_file))
+        return unique_ptr<dag_t>();
+
+    try
+    {
+        auto const load_mode = GetBoolArg("-dagmmap", DEFAULT_DAGMMAP) ? dag_load_mmap : dag_load_copy;
+        unique_ptr<dag_t> new_dag(new dag_t(epoch_file.string(), callback, load_mode));
         LogPrint("nrghash", "DAG file \"%s\" loaded successfully.\n", epoch_file.string());
-        return;
+
+        // a copied DAG has been verified completely, a mapped DAG is verified in the background.
+        // Corrupt chunks are regenerated and written back to the file by egihash itself
+        if (load_mode == dag_load_copy) {
+            auto const repaired = new_dag->verify();
+            if (repaired > 0)
+                LogPrintf("DAG file \"%s\" had %u corrupt chunks, they were regenerated\n", epoch_file.string(), repaired);
+        }
+        return new_dag;
     }
     catch (hash_exception const & e)
     {
-        LogPrint("nrghash", "DAG file \"%s\" not loaded, will be generated instead. Message: %s\n", epoch_file.string(), e.what());
+        LogPrint("nrghash", "DAG file \"%s\" not loaded. Message: %s\n", epoch_file.string(), e.what());
     }
+    return unique_ptr<dag_t>();
+}
+
+static std::unique_ptr<egihash::dag_t> LoadOrGenerateDAG(int height, egihash::progress_callback_type callback)
+{
+    using namespace egihash;
+
+    auto const epoch = get_epoch(height);
+    auto const epoch_file = GetEgihashFile(height, ".dag");
+
+    LogPrint("nrghash", "DAG file for epoch %u is \"%s\"\n", epoch, epoch_file.string());
+    // try to load the DAG from disk, another process sharing the DAG directory may have generated it
+    unique_ptr<dag_t> new_dag(LoadDAGFile(epoch_file, callback));
+    if (new_dag)
+        return new_dag;
 
     // try to generate the DAG
     try
     {
-        unique_ptr<dag_t> new_dag(new dag_t(height, callback));
+        // only one process generates the DAG of an epoch, the others wait for its file
         boost::filesystem::create_directories(epoch_file.parent_path());
-        new_dag->save(epoch_file.string());
-        ActiveDAG(move(new_dag));
+        auto const lock_file = epoch_file.string() + ".lock";
+        FILE* file = fopen(lock_file.c_str(), "a"); // empty lock file; created if it doesn't exist.
+        if (file) fclose(file);
+        boost::interprocess::file_lock lock(lock_file.c_str());
+        boost::interprocess::scoped_lock<boost::interprocess::file_lock> guard(lock, boost::interprocess::try_to_lock);
+        if (!guard.owns()) {
+            LogPrint("nrghash", "Waiting for another process to generate the DAG for epoch %u\n", epoch);
+            while (!guard.timed_lock(boost::get_system_time() + boost::posix_time::seconds(1))) {
+                if (ShutdownRequested() || !callback(0, 1, dag_generation))
+                    return unique_ptr<dag_t>();
+            }
+            new_dag = LoadDAGFile(epoch_file, callback);
+            if (new_dag)
+                return new_dag;
+        }
+
+        // -dagthreads=0 means autodetect, <0 means leave that many cores free
+        int nDAGThreads = GetArg("-dagthreads", DEFAULT_DAGTHREADS);
+        if (nDAGThreads <= 0)
+            nDAGThreads += GetNumCores();
+        nDAGThreads = (max)(nDAGThreads, 1);
+        LogPrint("nrghash", "Generating DAG for epoch %u using %d threads\n", epoch, nDAGThreads);
+        // the file is written while the DAG is generated
+        auto const tmp_file = GetEgihashTempFile(epoch_file);
+        new_dag.reset(new dag_t(height, tmp_file.string(), callback, nDAGThreads, GetDAGWriteFlags()));
+        boost::filesystem::rename(tmp_file, epoch_file);
+        SaveSeedhashes();
         LogPrint("nrghash", "DAG generated successfully. Saved to \"%s\".\n", epoch_file.string());
+
+        // replace the generated copy by a mapping of its file, so its pages are shared with the other processes
+        if (GetBoolArg("-dagmmap", DEFAULT_DAGMMAP)) {
+            new_dag->unload();
+            unique_ptr<dag_t> mapped_dag(LoadDAGFile(epoch_file, callback));
+            if (mapped_dag)
+                new_dag = move(mapped_dag);
+        }
+        return new_dag;
     }
-    catch (hash_exception const & e)
+    catch (std::exception const & e)
     {
         error("DAG for epoch %u could not be generated: %s\n", epoch, e.what());
     }
+    return unique_ptr<dag_t>();
+}
+
+void CreateDAG(int height, egihash::progress_callback_type callback)
+{
+    if (!GetBoolArg("-usedag", DEFAULT_USEDAG)) {
+        LogPrint("nrghash", "Operating in light mode, not loading a DAG\n");
+        LoadOrGenerateCache(height, callback);
+        return;
+    }
+
+    unique_ptr<egihash::dag_t> new_dag(LoadOrGenerateDAG(height, callback));
+    if (new_dag)
+        ActiveDAG(move(new_dag));
+}
+
+static bool LogDAGProgress(::std::size_t step, ::std::size_t max, int phase)
+{
+    double progress = static_cast<double>(step) / static_cast<double>(max) * 100.0;
+    switch(phase)
+    {
+        case egihash::cache_seeding:
+            LogPrint("nrghash", "Seeding cache... %3.2lf\n", progress);
+            break;
+        case egihash::cache_generation:
+            LogPrint("nrghash", "Generating cache... %3.2lf\n", progress);
+            break;
+        case egihash::cache_saving:
+            LogPrint("nrghash", "Saving cache... %3.2lf\n", progress);
+            break;
+        case egihash::cache_loading:
+            LogPrint("nrghash", "Loading cache... %3.2lf\n", progress);
+            break;
+        case egihash::dag_generation:
+            LogPrint("nrghash", "Generating DAG... %3.2lf\n", progress);
+            break;
+        case egihash::dag_saving:
+            LogPrint("nrghash", "Saving DAG... %3.2lf\n", progress);
+            break;
+        case egihash::dag_loading:
+            LogPrint("nrghash", "Loading DAG... %3.2lf\n", progress);
+            break;
+        case egihash::dag_verification:
+            LogPrint("nrghash", "Verifying DAG... %3.2lf\n", progress);
+            break;
+        default:
+            break;
+    }
+    return true;
+}
+
+/**
+ * State of the DAG being built ahead of time by ThreadPrepareDAG.
+ * A finished DAG is only swapped into ActiveDAG() by the validation thread.
+ */
+namespace {
+    boost::mutex csPreparedDAG;
+    boost::thread threadPrepareDAG;
+    bool fPreparingDAG = false;
+    std::unique_ptr<egihash::dag_t> preparedDAG;
+    std::atomic<bool> fInterruptPrepareDAG(false);
+
+    // a failed preparation is not retried for the same epoch before nPrepareRetryTime,
+    // the wait doubles with every further failure
+    const int64_t DAG_PREPARE_RETRY_SECONDS = 60;
+    const int64_t DAG_PREPARE_RETRY_MAX_SECONDS = 60 * 60;
+    uint64_t nFailedPrepareEpoch = 0;
+    int nPrepareFailures = 0;
+    int64_t nPrepareRetryTime = 0;
+}
+
+static void ThreadPrepareDAG(int height)
+{
+    RenameThread("energi-dagprep");
+    unique_ptr<egihash::dag_t> dag(LoadOrGenerateDAG(height, [](::std::size_t step, ::std::size_t max, int phase) -> bool
+    {
+        if (fInterruptPrepareDAG || ShutdownRequested())
+            return false;
+        return LogDAGProgress(step, max, phase);
+    }));
+
+    boost::lock_guard<boost::mutex> lock(csPreparedDAG);
+    auto const epoch = egihash::get_epoch(height);
+    if (dag) {
+        preparedDAG = move(dag);
+        nPrepareFailures = 0;
+    } else if (!fInterruptPrepareDAG && !ShutdownRequested()) {
+        nPrepareFailures = (nPrepareFailures > 0 && nFailedPrepareEpoch == epoch) ? nPrepareFailures + 1 : 1;
+        nFailedPrepareEpoch = epoch;
+        int64_t const nRetrySeconds = std::min(DAG_PREPARE_RETRY_SECONDS << std::min(nPrepareFailures - 1, 6), DAG_PREPARE_RETRY_MAX_SECONDS);
+        nPrepareRetryTime = GetTime() + nRetrySeconds;
+        LogPrintf("DAG for epoch %u could not be prepared, blocks are hashed in light mode. Retrying in %d seconds\n", epoch, nRetrySeconds);
+    }
+    fPreparingDAG = false;
+}
+
+void PrepareDAG(int height)
+{
+    if (!GetBoolArg("-usedag", DEFAULT_USEDAG))
+        return;
+
+    auto const epoch = egihash::get_epoch(height);
+    boost::lock_guard<boost::mutex> lock(csPreparedDAG);
+    // no new preparation is started once StopPrepareDAG() has been called
+    if (fInterruptPrepareDAG || fPreparingDAG || (preparedDAG && preparedDAG->epoch() == epoch))
+        return;
+    if (nPrepareFailures > 0 && nFailedPrepareEpoch == epoch && GetTime() < nPrepareRetryTime)
+        return;
+
+    // the previous preparation has finished, collect its thread before starting another
+    if (threadPrepareDAG.joinable())
+        threadPrepareDAG.join();
+
+    // a DAG prepared for another epoch is no longer useful, e.g. after a reorg, so release its memory
+    if (preparedDAG) {
+        try {
+            preparedDAG->unload();
+        } catch (egihash::hash_exception const & e) {
+            LogPrint("nrghash", "Could not unload prepared DAG for epoch %u: %s\n", preparedDAG->epoch(), e.what());
+        }
+        preparedDAG.reset();
+    }
+
+    LogPrint("nrghash", "Preparing DAG for epoch %u in the background\n", epoch);
+    fPreparingDAG = true;
+    threadPrepareDAG = boost::thread(&ThreadPrepareDAG, height);
+}
+
+static bool ActivatePreparedDAG(uint64_t epoch)
+{
+    unique_ptr<egihash::dag_t> dag;
+    {
+        boost::lock_guard<boost::mutex> lock(csPreparedDAG);
+        if (!preparedDAG || preparedDAG->epoch() != epoch)
+            return false;
+        dag = move(preparedDAG);
+    }
+    ActiveDAG(move(dag));
+    return true;
+}
+
+void StopPrepareDAG()
+{
+    // the flag is set under the lock, so PrepareDAG() can not start a thread which is not joined here.
+    // The thread takes the lock when it finishes, so it is joined without holding it
+    boost::thread thread;
+    {
+        boost::lock_guard<boost::mutex> lock(csPreparedDAG);
+        fInterruptPrepareDAG = true;
+        thread.swap(threadPrepareDAG);
+    }
+    if (thread.joinable())
+        thread.join();
+    boost::lock_guard<boost::mutex> lock(csPreparedDAG);
+    preparedDAG.reset();
+}
+
+/**
+ * State of the light caches built ahead of time by ThreadPrefetchEgihashCaches.
+ * The thread loads or generates the caches of the epochs nPrefetchFirstEpoch to nPrefetchLastEpoch,
+ * the range is empty until the first request.
+ */
+namespace {
+    boost::mutex csPrefetchCaches;
+    boost::condition_variable condPrefetchCaches;
+    boost::thread threadPrefetchCaches;
+    uint64_t nPrefetchFirstEpoch = 1;
+    uint64_t nPrefetchLastEpoch = 0;
+    bool fPrefetchRequested = false;
+    std::atomic<bool> fInterruptPrefetchCaches(false);
+}
+
+static void ThreadPrefetchEgihashCaches()
+{
+    RenameThread("energi-cacheprep");
+    auto const callback = [](::std::size_t step, ::std::size_t max, int phase) -> bool
+    {
+        if (fInterruptPrefetchCaches || ShutdownRequested())
+            return false;
+        return LogDAGProgress(step, max, phase);
+    };
+
+    while (true)
+    {
+        uint64_t nFirstEpoch, nLastEpoch;
+        {
+            boost::unique_lock<boost::mutex> lock(csPrefetchCaches);
+            while (!fPrefetchRequested && !fInterruptPrefetchCaches)
+                condPrefetchCaches.wait(lock);
+            if (fInterruptPrefetchCaches)
+                return;
+            fPrefetchRequested = false;
+            nFirstEpoch = nPrefetchFirstEpoch;
+            nLastEpoch = nPrefetchLastEpoch;
+        }
+
+        // caches already loaded are only looked up, so a repeated request costs little
+        for (uint64_t epoch = nFirstEpoch; epoch <= nLastEpoch && !fInterruptPrefetchCaches && !ShutdownRequested(); epoch++)
+            LoadOrGenerateCache(epoch * egihash::get_sizing().epoch_length, callback);
+    }
+}
+
+void StartPrefetchEgihashCaches()
+{
+    if (GetArg("-egihashcacheprefetch", DEFAULT_EGIHASH_CACHE_PREFETCH) <= 0)
+        return;
+
+    boost::lock_guard<boost::mutex> lock(csPrefetchCaches);
+    if (!threadPrefetchCaches.joinable() && !fInterruptPrefetchCaches)
+        threadPrefetchCaches = boost::thread(&ThreadPrefetchEgihashCaches);
+}
+
+bool PrefetchEgihashCaches(int nTipHeight, int nBestHeaderHeight)
+{
+    int64_t const nPrefetchEpochs = GetArg("-egihashcacheprefetch", DEFAULT_EGIHASH_CACHE_PREFETCH);
+
+    // the tip's epoch is included so its cache file is written off the validation thread. Epochs past
+    // the best header are not needed yet, except for the next one of a node which has caught up.
+    uint64_t const nFirstEpoch = egihash::get_epoch((max)(nTipHeight, 0));
+    uint64_t const nHeaderEpoch = egihash::get_epoch((max)(nBestHeaderHeight, (max)(nTipHeight, 0)));
+    uint64_t const nLastEpoch = (min)(nFirstEpoch + static_cast<uint64_t>(nPrefetchEpochs), nHeaderEpoch + 1);
+
+    boost::lock_guard<boost::mutex> lock(csPrefetchCaches);
+    if (!threadPrefetchCaches.joinable() || fInterruptPrefetchCaches)
+        return false;
+    if (nFirstEpoch == nPrefetchFirstEpoch && nLastEpoch == nPrefetchLastEpoch)
+        return true;
+
+    LogPrint("nrghash", "Prefetching caches for epochs %u to %u in the background\n", nFirstEpoch, nLastEpoch);
+    nPrefetchFirstEpoch = nFirstEpoch;
+    nPrefetchLastEpoch = nLastEpoch;
+    fPrefetchRequested = true;
+    condPrefetchCaches.notify_one();
+    return true;
+}
+
+void StopPrefetchEgihashCaches()
+{
+    {
+        boost::lock_guard<boost::mutex> lock(csPrefetchCaches);
+        fInterruptPrefetchCaches = true;
+    }
+    condPrefetchCaches.notify_all();
+    if (threadPrefetchCaches.joinable())
+        threadPrefetchCaches.join();
 }
 
 int GetHeight()
@@ -2494,12 +2920,50 @@ int GetHeight()
 
 void InitDAG(egihash::progress_callback_type callback)
 {
-    auto const & dag = ActiveDAG();
-    if (!dag)
+    // seedhashes are needed in both full and light mode
+    try
+    {
+        egihash::cache_t::load_seedhashes(GetSeedhashFile().string());
+        LogPrint("nrghash", "Seedhashes loaded from \"%s\"\n", GetSeedhashFile().string());
+    }
+    catch (egihash::hash_exception const & e)
+    {
+        LogPrint("nrghash", "Seedhashes not loaded from \"%s\": %s\n", GetSeedhashFile().string(), e.what());
+    }
+    // extend the table through the next epoch before saving it
+    egihash::cache_t::get_seedhash((max)(GetHeight(), 0) + egihash::get_sizing().epoch_length);
+    SaveSeedhashes();
+
+    // allocation of DAG memory, best effort
+    egihash::dag_page_mode ePages = egihash::dag_pages_default;
+    switch (GetArg("-daghugepages", DEFAULT_DAGHUGEPAGES)) {
+    case 0: break;
+    case 1: ePages = egihash::dag_pages_transparent; break;
+    case 2: ePages = egihash::dag_pages_huge; break;
+    default: LogPrintf("%s: ignoring invalid -daghugepages\n", __func__); break;
+    }
+    egihash::dag_numa_mode eNuma = egihash::dag_numa_default;
+    int nNumaNode = 0;
+    std::string const strNuma = GetArg("-dagnuma", "");
+    if (strNuma == "interleave") {
+        eNuma = egihash::dag_numa_interleave;
+    } else if (ParseInt32(strNuma, &nNumaNode) && nNumaNode >= 0) {
+        eNuma = egihash::dag_numa_bind;
+    } else if (!strNuma.empty()) {
+        LogPrintf("%s: ignoring invalid -dagnuma=%s\n", __func__, strNuma);
+    }
+    egihash::dag_t::set_memory_policy(ePages, eNuma, static_cast<unsigned int>(nNumaNode));
+
+    // bound the memory used by light caches
+    int64_t const nCacheMB = (max)(GetArg("-egihashcachemb", DEFAULT_EGIHASH_CACHE_MB), int64_t(0));
+    egihash::cache_t::set_memory_budget(static_cast<uint64_t>(nCacheMB) << 20);
+    PinEgihashCaches((max)(GetHeight(), 0));
+
+    if (!ActiveDAG())
     {
         auto const height = (max)(GetHeight(), 0);
         CreateDAG(height, callback);
-        LogPrint("nrghash", "Loaded or created DAG for epoch %d\n", height / egihash::constants::EPOCH_LENGTH);
+        LogPrint("nrghash", "Loaded or created DAG for epoch %d\n", egihash::get_epoch(height));
     }
     LogPrint("nrghash", "DAG has been initialized already. Use ActiveDAG() to swap.\n");
 }
@@ -2514,43 +2978,40 @@ bool static ConnectTip(CValidationState& state, const CChainParams& chainparams,
 
     assert(pindexNew->pprev == chainActive.Tip());
     auto const height = pindexNew->nHeight;
-    auto const epoch = height / constants::EPOCH_LENGTH;
-
-    // if there have been EPOCH_LENGTH number of blocks since the last DAG was generated,
-    // generate a new one
-    auto const & active_dag = ActiveDAG();
-    if (active_dag && (epoch > active_dag->epoch())) {
-        CreateDAG(height, [](::std::size_t step, ::std::size_t max, int phase) -> bool
-        {
-            double progress = static_cast<double>(step) / static_cast<double>(max) * 100.0;
-            switch(phase)
-            {
-                case egihash::cache_seeding:
-                    LogPrint("nrghash", "Seeding cache... %3.2lf\n", progress);
-                    break;
-                case egihash::cache_generation:
-                    LogPrint("nrghash", "Generating cache... %3.2lf\n", progress);
-                    break;
-                case egihash::cache_saving:
-                    LogPrint("nrghash", "Saving cache... %3.2lf\n", progress);
-                    break;
-                case egihash::cache_loading:
-                    LogPrint("nrghash", "Loading cache... %3.2lf\n", progress);
-                    break;
-                case egihash::dag_generation:
-                    LogPrint("nrghash", "Generating DAG... %3.2lf\n", progress);
-                    break;
-                case egihash::dag_saving:
-                    LogPrint("nrghash", "Saving DAG... %3.2lf\n", progress);
-                    break;
-                case egihash::dag_loading:
-                    LogPrint("nrghash", "Loading DAG... %3.2lf\n", progress);
-                    break;
-                default:
-                    break;
-            }
-            return true;
-        });
+    auto const epoch = get_epoch(height);
+
+    if ((height % get_sizing().epoch_length) == 0) {
+        PinEgihashCaches(height);
+        // persist the new epoch's cache so it is not regenerated on restart. The prefetch thread does it
+        // in the background, without it a light mode node has to do it here.
+        int const nBestHeaderHeight = pindexBestHeader ? pindexBestHeader->nHeight : height;
+        if (!PrefetchEgihashCaches(height, nBestHeaderHeight) && !GetBoolArg("-usedag", DEFAULT_USEDAG))
+            LoadOrGenerateCache(height, LogDAGProgress);
+    }
+
+    // if there have been epoch_length number of blocks since the last DAG was activated,
+    // swap in the DAG prepared in the background. If it is not ready yet, blocks are
+    // hashed in light mode until it is.
+    auto const active_dag = ActiveDAG();
+    if (active_dag) {
+        if (epoch > active_dag->epoch()) {
+            if (ActivatePreparedDAG(epoch))
+                LogPrint("nrghash", "Activated prepared DAG for epoch %u at height %d\n", epoch, height);
+            else
+                PrepareDAG(height);
+        } else {
+            // start preparing the next epoch's DAG a configurable number of blocks ahead of the boundary.
+            // After a reorg back across the boundary the next epoch's DAG is the active one, it is not prepared again
+            int64_t const nPrepareBlocks = GetArg("-dagprepareblocks", DEFAULT_DAG_PREPARE_BLOCKS);
+            int64_t const nNextEpochHeight = (epoch + 1) * static_cast<int64_t>(get_sizing().epoch_length);
+            if (epoch == active_dag->epoch() && nPrepareBlocks > 0 && height + nPrepareBlocks >= nNextEpochHeight)
+                PrepareDAG(nNextEpochHeight);
+
+            // the previous epoch's DAG stays resident for reorgs across the boundary until the tip is far enough past it
+            int64_t const nKeepBlocks = GetArg("-dagkeepblocks", DEFAULT_DAG_KEEP_BLOCKS);
+            if (epoch == active_dag->epoch() && height - static_cast<int64_t>(epoch * get_sizing().epoch_length) >= nKeepBlocks)
+                ReleasePreviousDAG();
+        }
     }
 
     // Read block from disk.
@@ -2978,7 +3439,11 @@ CBlockIndex* AddToBlockIndex(const CBlockHeader& block)
     pindexNew->nChainWork = (pindexNew->pprev ? pindexNew->pprev->nChainWork : 0) + GetBlockProof(*pindexNew);
     pindexNew->RaiseValidity(BLOCK_VALID_TREE);
     if (pindexBestHeader == NULL || pindexBestHeader->nChainWork < pindexNew->nChainWork)
+    {
         pindexBestHeader = pindexNew;
+        // build the caches of epochs the new headers lead into before their blocks get connected
+        PrefetchEgihashCaches(chainActive.Height(), pindexBestHeader->nHeight);
+    }
 
     setDirtyBlockIndex.insert(pindexNew);
 
@@ -3340,7 +3805,7 @@ bool ContextualCheckBlock(const CBlock& block, CValidationState& state, CBlockIn
     return true;
 }
 
-static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex)
+static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fCheckPOW = true)
 {
     AssertLockHeld(cs_main);
 
@@ -3348,6 +3813,7 @@ static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state
     uint256 hash = block.GetHash();
     BlockMap::iterator miSelf = mapBlockIndex.find(hash);
     CBlockIndex *pindex = NULL;
+    bool fCheckedPOW = false;
 
     // TODO : ENABLE BLOCK CACHE IN SPECIFIC CASES
     if (hash != chainparams.GetConsensus().hashGenesisBlock) {
@@ -3377,14 +3843,20 @@ static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state
         if (fCheckpointsEnabled && !CheckIndexAgainstCheckpoint(pindexPrev, state, chainparams, hash))
             return error("%s: CheckIndexAgainstCheckpoint(): %s", __func__, state.GetRejectReason().c_str());
 
-        if (!CheckBlockHeader(block, state))
+        // fCheckPOW is false if the caller already verified the proof-of-work
+        if (!CheckBlockHeader(block, state, fCheckPOW))
             return false;
+        fCheckedPOW = true;
 
         if (!ContextualCheckBlockHeader(block, state, pindexPrev))
             return false;
     }
-    if (pindex == NULL)
+    if (pindex == NULL) {
         pindex = AddToBlockIndex(block);
+        // remember the proof-of-work check, so it need not be repeated when the block index is loaded
+        if (fCheckedPOW)
+            pindex->nStatus |= BLOCK_POW_VERIFIED;
+    }
 
     if (ppindex)
         *ppindex = pindex;
@@ -3397,13 +3869,101 @@ static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state
     return true;
 }
 
+/**
+ * Verify the proof-of-work of new headers in parallel without holding cs_main.
+ * Only headers which are unknown and connect to a known header or to their predecessor
+ * in the batch are checked, so a batch failing the cheap checks costs no hashing.
+ * Checking stops at the first failure, which AcceptBlockHeader then reports.
+ * @return for each header whether its proof-of-work was verified
+ */
+static std::vector<bool> CheckHeadersProofOfWork(const std::vector<CBlockHeader>& headers, const CChainParams& chainparams)
+{
+    using namespace egihash;
+
+    std::vector<bool> vVerified(headers.size(), false);
+    std::map<uint64_t, std::vector<size_t> > mapEpochHeaders;
+    // the DAG can be swapped by ConnectTip as soon as cs_main is released, so the workers
+    // hash through handles taken here, a null handle means light hashing for the epoch
+    std::map<uint64_t, CDAGRef> mapEpochDAG;
+    size_t nTotal = 0;
+    {
+        LOCK(cs_main);
+        for (size_t i = 0; i < headers.size(); i++) {
+            const CBlockHeader& header = headers[i];
+            if (mapBlockIndex.count(header.GetHash()))
+                continue;
+            BlockMap::const_iterator mi = mapBlockIndex.find(header.hashPrevBlock);
+            bool fConnects = (mi != mapBlockIndex.end() && header.nHeight == static_cast<uint32_t>(mi->second->nHeight + 1));
+            if (!fConnects && i > 0)
+                fConnects = (header.hashPrevBlock == headers[i - 1].GetHash() && header.nHeight == headers[i - 1].nHeight + 1);
+            if (!fConnects)
+                break;
+            mapEpochHeaders[get_epoch(header.nHeight)].push_back(i);
+            nTotal++;
+        }
+        for (const auto& epochHeaders : mapEpochHeaders)
+            mapEpochDAG[epochHeaders.first] = ResidentDAG(epochHeaders.first);
+    }
+    if (nTotal == 0)
+        return vVerified;
+
+    // -par sizes the pool like for the startup checks, the calling thread takes part
+    int const nThreads = std::max(nScriptCheckThreads, 1);
+    std::atomic<bool> fFailed(false);
+    for (const auto& epochHeaders : mapEpochHeaders)
+    {
+        uint64_t const nEpoch = epochHeaders.first;
+        const std::vector<size_t>& vIndex = epochHeaders.second;
+
+        // hold the epoch's light cache while the workers use it
+        CDAGRef const dag = mapEpochDAG[nEpoch];
+        std::unique_ptr<cache_t> cache;
+        if (!dag)
+            cache.reset(new cache_t(nEpoch * get_sizing().epoch_length));
+
+        // vector<bool> packs bits and can not be written concurrently, so collect into chars first
+        std::vector<char> vValid(vIndex.size(), 0);
+        std::atomic<size_t> nNext(0);
+        auto worker = [&]()
+        {
+            for (size_t i = nNext++; i < vIndex.size() && !fFailed; i = nNext++) {
+                const CBlockHeader& header = headers[vIndex[i]];
+                bool fValid = false;
+                try {
+                    fValid = CheckProofOfWork(header.GetPOWHash(dag), header.nBits, chainparams.GetConsensus());
+                } catch (const std::exception& e) {
+                    LogPrintf("%s: %s\n", __func__, e.what());
+                }
+                if (fValid)
+                    vValid[i] = 1;
+                else
+                    fFailed = true;
+            }
+        };
+
+        boost::thread_group workers;
+        for (int i = 1; i < std::min<int>(nThreads, vIndex.size()); i++)
+            workers.create_thread(worker);
+        worker();
+        workers.join_all();
+
+        for (size_t i = 0; i < vIndex.size(); i++)
+            vVerified[vIndex[i]] = vValid[i];
+        if (fFailed)
+            break;
+    }
+    return vVerified;
+}
+
 // Exposed wrapper for AcceptBlockHeader
 bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex)
 {
+    // the expensive proof-of-work checks run first, in parallel and outside cs_main
+    std::vector<bool> const vPOWVerified = CheckHeadersProofOfWork(headers, chainparams);
     {
         LOCK(cs_main);
-        for (const CBlockHeader& header : headers) {
-            if (!AcceptBlockHeader(header, state, chainparams, ppindex)) {
+        for (size_t i = 0; i < headers.size(); i++) {
+            if (!AcceptBlockHeader(headers[i], state, chainparams, ppindex, !vPOWVerified[i])) {
                 return false;
             }
         }
@@ -3724,17 +4284,113 @@ CBlockIndex * InsertBlockIndex(uint256 hash)
 
 bool static ValidateLoadedBlocks()
 {
+    using namespace egihash;
+
     // if we have dag in memory then validation is much faster, no need to skip any
     // or if number of blocks is smaller than validation count then validate all blocks
-    bool validateAllBlocks = ActiveDAG() || mapBlockIndex.size() <= validationBlocksCount;
-
+    int const nCheckLevel = GetArg("-checkpowonload", DEFAULT_CHECKPOWONLOAD);
+    bool validateAllBlocks = nCheckLevel >= 3 || ActiveDAG() || mapBlockIndex.size() <= validationBlocksCount;
+    int64_t const nMinHeight = validateAllBlocks ? 0 : static_cast<int64_t>(mapBlockIndex.size()) - validationBlocksCount;
+
+    // group the headers by epoch, so each epoch's light cache is set up once and shared by all workers
+    std::map<uint64_t, std::vector<CBlockIndex*> > mapEpochHeaders;
+    size_t nTotal = 0;
+    size_t nSkipped = 0;
     BOOST_FOREACH(const PAIRTYPE(uint256, CBlockIndex*)& item, mapBlockIndex)
     {
         CBlockIndex* pindex = item.second;
-        if (validateAllBlocks || pindex->nHeight >= mapBlockIndex.size() - validationBlocksCount) {
-            if(!CheckProofOfWork(pindex->GetBlockHeader().GetPOWHash(), pindex->nBits, Params().GetConsensus())) {
-                error("%s: CheckProofOfWork failed: %s", __func__, pindex->ToString());
-                return false;
+        if (pindex->nHeight < nMinHeight)
+            continue;
+
+        // headers whose proof-of-work was verified before only need to still match their block hash,
+        // which commits to hashMix and nNonce; below level 2 a sample of them is verified again
+        if ((pindex->nStatus & BLOCK_POW_VERIFIED) && nCheckLevel < 2 &&
+            (nCheckLevel < 1 || insecure_rand() % CHECKPOWONLOAD_SAMPLE_RATE != 0)) {
+            if (pindex->GetBlockHeader().GetHash() != pindex->GetBlockHash())
+                return error("%s: block hash mismatch: %s", __func__, pindex->ToString());
+            nSkipped++;
+            continue;
+        }
+
+        mapEpochHeaders[get_epoch(pindex->nHeight)].push_back(pindex);
+        nTotal++;
+    }
+    if (nSkipped > 0)
+        LogPrintf("Skipping proof-of-work of %u block headers verified before (-checkpowonload=%d)\n", nSkipped, nCheckLevel);
+    if (nTotal == 0)
+        return true;
+
+    // -par also sizes the proof-of-work check pool, nScriptCheckThreads == 0 means no concurrency
+    int const nThreads = std::max(nScriptCheckThreads, 1);
+    LogPrintf("Verifying proof-of-work of %u block headers using %d threads\n", nTotal, nThreads);
+    uiInterface.ShowProgress(_("Verifying block proof-of-work..."), 0);
+
+    std::atomic<size_t> nDone(0);
+    int nReportedPercent = 0;
+    std::atomic<CBlockIndex*> pindexFailed(nullptr);
+    for (const auto& epochHeaders : mapEpochHeaders)
+    {
+        uint64_t const nEpoch = epochHeaders.first;
+        const std::vector<CBlockIndex*>& vIndex = epochHeaders.second;
+
+        // generating a light cache is sequential, so do it once up front rather than in every worker
+        CDAGRef const dag = ResidentDAG(nEpoch);
+        std::unique_ptr<cache_t> cache;
+        if (!dag)
+            cache.reset(new cache_t(nEpoch * get_sizing().epoch_length));
+
+        std::atomic<size_t> nNext(0);
+        auto worker = [&](bool fReportProgress)
+        {
+            for (size_t i = nNext++; i < vIndex.size() && !pindexFailed; i = nNext++) {
+                CBlockIndex* pindex = vIndex[i];
+                bool fValid = false;
+                try {
+                    fValid = CheckProofOfWork(pindex->GetBlockHeader().GetPOWHash(dag), pindex->nBits, Params().GetConsensus());
+                } catch (const std::exception& e) {
+                    LogPrintf("%s: %s\n", __func__, e.what());
+                }
+                if (!fValid) {
+                    CBlockIndex* pindexExpected = nullptr;
+                    pindexFailed.compare_exchange_strong(pindexExpected, pindex);
+                }
+
+                size_t const nChecked = ++nDone;
+                if (fReportProgress) {
+                    int const nPercent = static_cast<int>(nChecked * 100 / nTotal);
+                    if (nPercent > nReportedPercent) {
+                        nReportedPercent = nPercent;
+                        uiInterface.ShowProgress(_("Verifying block proof-of-work..."), nPercent);
+                        if (nPercent % 10 == 0)
+                            LogPrintf("Verified proof-of-work of %u of %u block headers\n", nChecked, nTotal);
+                    }
+                }
+            }
+        };
+
+        // the calling thread takes part and is the only one reporting progress
+        boost::thread_group workers;
+        for (int i = 1; i < nThreads; i++)
+            workers.create_thread([&worker]() { worker(false); });
+        worker(true);
+        workers.join_all();
+
+        if (pindexFailed)
+            break;
+    }
+    uiInterface.ShowProgress("", 100);
+
+    if (pindexFailed) {
+        error("%s: CheckProofOfWork failed: %s", __func__, pindexFailed.load()->ToString());
+        return false;
+    }
+
+    // remember the verified headers, so later startups can skip them
+    for (const auto& epochHeaders : mapEpochHeaders) {
+        for (CBlockIndex* pindex : epochHeaders.second) {
+            if (!(pindex->nStatus & BLOCK_POW_VERIFIED)) {
+                pindex->nStatus |= BLOCK_POW_VERIFIED;
+                setDirtyBlockIndex.insert(pindex);
             }
         }
     }
@@ -134,6 +134,24 @@ static const bool DEFAULT_ENABLE_REPLACEMENT = false;
 
 /** Default for -usedag */
 static const bool DEFAULT_USEDAG = false;
+/** Default for -dagmmap */
+static const bool DEFAULT_DAGMMAP = true;
+/** Default for -dagdirectio, write DAG files bypassing the page cache */
+static const bool DEFAULT_DAGDIRECTIO = false;
+/** Default for -dagsync, flush DAG files to disk before using them */
+static const bool DEFAULT_DAGSYNC = false;
+/** Default for -daghugepages, 0 = regular pages, 1 = transparent huge pages, 2 = reserved huge pages */
+static const int DEFAULT_DAGHUGEPAGES = 0;
+/** Default for -dagthreads, 0 = number of cores */
+static const int DEFAULT_DAGTHREADS = 0;
+/** Default for -dagprepareblocks, the number of blocks before an epoch boundary at which to start preparing the next DAG */
+static const int DEFAULT_DAG_PREPARE_BLOCKS = 720;
+/** Default for -dagkeepblocks, the number of blocks after an epoch boundary for which the previous epoch's DAG stays loaded */
+static const int DEFAULT_DAG_KEEP_BLOCKS = 100;
+/** Default for -egihashcachemb, the memory budget of egihash light caches in megabytes */
+static const int64_t DEFAULT_EGIHASH_CACHE_MB = 256;
+/** Default for -egihashcacheprefetch, the number of upcoming epochs whose light caches are built in the background */
+static const int64_t DEFAULT_EGIHASH_CACHE_PREFETCH = 2;
 
 /** Maximum number of headers to announce when relaying blocks with headers message.*/
 static const unsigned int MAX_BLOCKS_TO_ANNOUNCE = 8;
@@ -194,6 +212,10 @@ static const unsigned int MIN_BLOCKS_TO_KEEP = 288;
 
 static const signed int DEFAULT_CHECKBLOCKS = MIN_BLOCKS_TO_KEEP;
 static const unsigned int DEFAULT_CHECKLEVEL = 3;
+/** Default for -checkpowonload, how thoroughly the proof-of-work of loaded block headers is re-verified (0-3) */
+static const unsigned int DEFAULT_CHECKPOWONLOAD = 1;
+/** At -checkpowonload=1, one in this many headers already marked as verified is verified again */
+static const unsigned int CHECKPOWONLOAD_SAMPLE_RATE = 100;
 
 // Require that user allocate at least 945MB for block & undo files (blk???.dat and rev???.dat)
 // At 2MB per block, 288 blocks = 576MB.
@@ -228,6 +250,24 @@ bool ProcessNewBlock(const CChainParams& chainparams, const CBlock* pblock, bool
 /** Create a next DAG */
 void CreateDAG(int height, egihash::progress_callback_type callback);
 
+/** Start loading or generating the DAG for the epoch of height on a background thread */
+void PrepareDAG(int height);
+
+/** Interrupt and join the background DAG preparation */
+void StopPrepareDAG();
+
+/** Start the background thread which prefetches light caches, unless -egihashcacheprefetch is 0 */
+void StartPrefetchEgihashCaches();
+
+/**
+ * Load or generate the light caches of the tip's epoch and of upcoming epochs, up to the one after the
+ * best header's, on the background thread. Returns false if the thread is not running.
+ */
+bool PrefetchEgihashCaches(int nTipHeight, int nBestHeaderHeight);
+
+/** Interrupt and join the background light cache prefetching */
+void StopPrefetchEgihashCaches();
+
 /** Initialize the DAG */
 void InitDAG(egihash::progress_callback_type callback = [](egihash::dag_t::size_type, egihash::dag_t::size_type, int){ return true; });
 